@@ -12,10 +12,13 @@
 #include "diffcore.h"
 #include "gettext.h"
 #include "hex.h"
+#include "lockfile.h"
 #include "path.h"
 #include "read-cache.h"
 #include "revision.h"
 #include "setup.h"
+#include "thread-utils.h"
+#include "strbuf.h"
 #include "tag.h"
 #include "trace2.h"
 #include "blame.h"
@@ -23,6 +26,8 @@
 #include "commit-slab.h"
 #include "bloom.h"
 #include "commit-graph.h"
+#include "file-history.h"
+#include "dir.h"
 
 define_commit_slab(blame_suspects, struct blame_origin *);
 static struct blame_suspects blame_suspects;
@@ -321,6 +326,7 @@ static int diff_hunks(mmfile_t *file_a, mmfile_t *file_b,
 	xdemitcb_t ecb = {NULL};
 
 	xpp.flags = xdl_opts;
+	xpp.arena = xdiff_arena();
 	xecfg.hunk_func = hunk_func;
 	ecb.priv = cb_data;
 	return xdi_diff(file_a, file_b, &xpp, &xecfg, &ecb);
@@ -1023,21 +1029,17 @@ static void drop_origin_fingerprints(struct blame_origin *o)
 	}
 }
 
-/*
- * Given an origin, prepare mmfile_t structure to be used by the
- * diff machinery
- */
-static void fill_origin_blob(struct diff_options *opt,
+static void read_origin_blob(struct repository *r,
 			     struct blame_origin *o, mmfile_t *file,
-			     int *num_read_blob, int fill_fingerprints)
+			     int *num_read_blob, int allow_textconv)
 {
 	if (!o->file.ptr) {
 		enum object_type type;
 		unsigned long file_size;
 
 		(*num_read_blob)++;
-		if (opt->flags.allow_textconv &&
-		    textconv_object(opt->repo, o->path, o->mode,
+		if (allow_textconv &&
+		    textconv_object(r, o->path, o->mode,
 				    &o->blob_oid, 1, &file->ptr, &file_size))
 			;
 		else
@@ -1054,10 +1056,33 @@ static void fill_origin_blob(struct diff_options *opt,
 	}
 	else
 		*file = o->file;
+}
+
+/*
+ * Given an origin, prepare mmfile_t structure to be used by the
+ * diff machinery
+ */
+static void fill_origin_blob(struct diff_options *opt,
+			     struct blame_origin *o, mmfile_t *file,
+			     int *num_read_blob, int fill_fingerprints)
+{
+	read_origin_blob(opt->repo, o, file, num_read_blob,
+			 opt->flags.allow_textconv);
 	if (fill_fingerprints)
 		fill_origin_fingerprints(o);
 }
 
+static int origin_has_textconv(struct repository *r, struct blame_origin *o)
+{
+	struct diff_filespec *df = alloc_filespec(o->path);
+	int ret;
+
+	fill_filespec(df, &o->blob_oid, 1, o->mode);
+	ret = !!get_textconv(r, df);
+	free_filespec(df);
+	return ret;
+}
+
 static void drop_origin_blob(struct blame_origin *o)
 {
 	FREE_AND_NULL(o->file.ptr);
@@ -2224,6 +2249,199 @@ static struct blame_list *setup_blame_list(struct blame_entry *unblamed,
 	return blame_list;
 }
 
+/*
+ * With blame.threads, the candidate blobs of find_copy_in_parent() are
+ * read and diffed against the entries in worker threads, which only
+ * record the hunks.  The main thread then feeds the hunks to the same
+ * handle_split() logic in candidate order, so the result is the same
+ * as when looking at one candidate after another.
+ */
+#define COPY_BATCH_PER_THREAD 16
+
+struct copy_hunk {
+	long start_a, count_a, start_b, count_b;
+};
+
+struct copy_hunks {
+	struct copy_hunk *hunk;
+	size_t nr, alloc;
+};
+
+struct copy_search {
+	struct blame_scoreboard *sb;
+	struct blame_list *blame_list;
+	int num_ents;
+	struct blame_origin **origins;
+	mmfile_t *files;
+	struct copy_hunks *hunks; /* num_ents for each origin */
+	int nr, next;
+	int num_read_blob;
+	pthread_mutex_t mutex;
+};
+
+static int record_copy_hunk(long start_a, long count_a,
+			    long start_b, long count_b, void *data)
+{
+	struct copy_hunks *hunks = data;
+
+	ALLOC_GROW(hunks->hunk, hunks->nr + 1, hunks->alloc);
+	hunks->hunk[hunks->nr].start_a = start_a;
+	hunks->hunk[hunks->nr].count_a = count_a;
+	hunks->hunk[hunks->nr].start_b = start_b;
+	hunks->hunk[hunks->nr].count_b = count_b;
+	hunks->nr++;
+	return 0;
+}
+
+static void *copy_search_thread(void *data)
+{
+	struct copy_search *cs = data;
+	struct blame_scoreboard *sb = cs->sb;
+	xdlarena_t *arena = xdl_arena_new();
+	int num_read_blob = 0;
+
+	for (;;) {
+		int i, j;
+
+		pthread_mutex_lock(&cs->mutex);
+		i = cs->next++;
+		pthread_mutex_unlock(&cs->mutex);
+		if (i >= cs->nr)
+			break;
+
+		obj_read_lock();
+		read_origin_blob(sb->repo, cs->origins[i], &cs->files[i],
+				 &num_read_blob, 0);
+		obj_read_unlock();
+		if (!cs->files[i].ptr)
+			continue;
+
+		for (j = 0; j < cs->num_ents; j++) {
+			struct blame_entry *ent = cs->blame_list[j].ent;
+			xpparam_t xpp = { 0 };
+			xdemitconf_t xecfg = { 0 };
+			xdemitcb_t ecb = { NULL };
+			const char *cp = blame_nth_line(sb, ent->lno);
+			mmfile_t file_o;
+
+			file_o.ptr = (char *) cp;
+			file_o.size = blame_nth_line(sb, ent->lno + ent->num_lines) - cp;
+			xpp.flags = sb->xdl_opts;
+			xpp.arena = arena;
+			xecfg.hunk_func = record_copy_hunk;
+			ecb.priv = &cs->hunks[st_mult(i, cs->num_ents) + j];
+			if (xdi_diff(&cs->files[i], &file_o, &xpp, &xecfg, &ecb))
+				die("unable to generate diff (%s)",
+				    oid_to_hex(&cs->origins[i]->commit->object.oid));
+		}
+	}
+
+	pthread_mutex_lock(&cs->mutex);
+	cs->num_read_blob += num_read_blob;
+	pthread_mutex_unlock(&cs->mutex);
+	xdl_arena_free(arena);
+	return NULL;
+}
+
+/*
+ * Do what find_copy_in_blob() does with the hunks a copy_search_thread()
+ * recorded instead of running the diff.
+ */
+static void replay_copy_hunks(struct blame_scoreboard *sb,
+			      struct blame_entry *ent,
+			      struct blame_origin *parent,
+			      struct blame_entry *split,
+			      const struct copy_hunks *hunks)
+{
+	struct handle_split_cb_data d;
+	size_t i;
+
+	memset(&d, 0, sizeof(d));
+	d.sb = sb; d.ent = ent; d.parent = parent; d.split = split;
+	memset(split, 0, sizeof(struct blame_entry [3]));
+	for (i = 0; i < hunks->nr; i++)
+		handle_split_cb(hunks->hunk[i].start_a, hunks->hunk[i].count_a,
+				hunks->hunk[i].start_b, hunks->hunk[i].count_b,
+				&d);
+	handle_split(sb, ent, d.tlno, d.plno, ent->num_lines, parent, split);
+}
+
+/*
+ * Look for the entries of blame_list in the blobs of 'origins' from
+ * several threads, as the loop in find_copy_in_parent() does one blob
+ * at a time, and drop the references to 'origins'.
+ */
+static void find_copies_in_origins(struct blame_scoreboard *sb,
+				   struct blame_list *blame_list, int num_ents,
+				   struct blame_origin **origins, int nr)
+{
+	struct copy_search cs = {
+		.sb = sb,
+		.blame_list = blame_list,
+		.num_ents = num_ents,
+		.origins = origins,
+		.nr = nr,
+	};
+	int nr_threads = sb->num_threads < nr ? sb->num_threads : nr;
+	int had_obj_read_lock = obj_read_use_lock;
+	pthread_t *threads;
+	int i, j;
+
+	CALLOC_ARRAY(cs.files, nr);
+	CALLOC_ARRAY(cs.hunks, st_mult(nr, num_ents));
+	pthread_mutex_init(&cs.mutex, NULL);
+
+	/*
+	 * Looking up the textconv driver reads attributes and running it
+	 * may go through the notes cache, none of which is thread-safe.
+	 * Convert the blobs that have a driver here, before the threads
+	 * start; the threads only read the others as they are.
+	 */
+	if (sb->revs->diffopt.flags.allow_textconv)
+		for (i = 0; i < nr; i++)
+			if (origin_has_textconv(sb->repo, origins[i]))
+				fill_origin_blob(&sb->revs->diffopt, origins[i],
+						 &cs.files[i], &cs.num_read_blob, 0);
+	enable_obj_read_lock();
+
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 copy_search_thread, &cs);
+		if (err)
+			die(_("unable to create blame thread: %s"),
+			    strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join blame thread");
+	free(threads);
+
+	if (!had_obj_read_lock)
+		disable_obj_read_lock();
+	pthread_mutex_destroy(&cs.mutex);
+	sb->num_read_blob += cs.num_read_blob;
+
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < num_ents; j++) {
+			struct copy_hunks *hunks = &cs.hunks[st_mult(i, num_ents) + j];
+			struct blame_entry potential[3];
+
+			if (cs.files[i].ptr) {
+				replay_copy_hunks(sb, blame_list[j].ent,
+						  origins[i], potential, hunks);
+				copy_split_if_better(sb, blame_list[j].split,
+						     potential);
+				decref_split(potential);
+			}
+			free(hunks->hunk);
+		}
+		blame_origin_decref(origins[i]);
+	}
+	free(cs.hunks);
+	free(cs.files);
+}
+
 /*
  * For lines target is suspected for, see if we can find code movement
  * across file boundary from the parent commit.  porigin is the path
@@ -2277,6 +2495,9 @@ static void find_copy_in_parent(struct blame_scoreboard *sb,
 
 	do {
 		struct blame_entry **unblamedtail = &unblamed;
+		struct blame_origin **batch = NULL;
+		int batch_nr = 0, batch_alloc = 0;
+
 		blame_list = setup_blame_list(unblamed, &num_ents);
 
 		for (i = 0; i < diff_queued_diff.nr; i++) {
@@ -2296,6 +2517,16 @@ static void find_copy_in_parent(struct blame_scoreboard *sb,
 			norigin = get_origin(parent, p->one->path);
 			oidcpy(&norigin->blob_oid, &p->one->oid);
 			norigin->mode = p->one->mode;
+			if (sb->num_threads > 1) {
+				ALLOC_GROW(batch, batch_nr + 1, batch_alloc);
+				batch[batch_nr++] = norigin;
+				if (batch_nr < sb->num_threads * COPY_BATCH_PER_THREAD)
+					continue;
+				find_copies_in_origins(sb, blame_list, num_ents,
+						       batch, batch_nr);
+				batch_nr = 0;
+				continue;
+			}
 			fill_origin_blob(&sb->revs->diffopt, norigin, &file_p,
 					 &sb->num_read_blob, 0);
 			if (!file_p.ptr)
@@ -2310,6 +2541,10 @@ static void find_copy_in_parent(struct blame_scoreboard *sb,
 			}
 			blame_origin_decref(norigin);
 		}
+		if (batch_nr)
+			find_copies_in_origins(sb, blame_list, num_ents,
+					       batch, batch_nr);
+		free(batch);
 
 		for (j = 0; j < num_ents; j++) {
 			struct blame_entry *split = blame_list[j].split;
@@ -2577,6 +2812,359 @@ finish:
 		free(sg_origin);
 }
 
+/*
+ * The blame cache remembers the final blame of a whole file at a
+ * commit, so that a later blame that digs down to the same file at
+ * the same commit can take the answer from there instead of going
+ * through the rest of history again.  Each file in
+ * "$GIT_DIR/blame-cache/" holds the result for one commit, path and
+ * set of options that change the result, as a sequence of records
+ *
+ *   <lno> SP <num_lines> SP <s_lno> SP <commit> SP <previous> NUL
+ *   <path> NUL <previous path> NUL
+ *
+ * where <previous> is the null object name, and <previous path> is
+ * empty, for an origin without one.
+ */
+struct blame_cache_record {
+	int lno, num_lines, s_lno;
+	struct commit *commit;
+	struct commit *previous;
+	const char *path;
+	const char *previous_path;
+};
+
+static char *blame_cache_path(struct blame_scoreboard *sb,
+			      const struct object_id *oid, const char *path)
+{
+	const struct git_hash_algo *algo = sb->repo->hash_algo;
+	struct git_hash_ctx ctx;
+	struct strbuf key = STRBUF_INIT;
+	unsigned char hash[GIT_MAX_RAWSZ];
+	char *hex;
+
+	strbuf_addf(&key, "%s%c%s%c%d %d %d", oid_to_hex(oid), '\0',
+		    path, '\0', sb->xdl_opts,
+		    sb->revs->first_parent_only,
+		    sb->no_whole_file_rename);
+	algo->init_fn(&ctx);
+	git_hash_update(&ctx, key.buf, key.len);
+	git_hash_final(hash, &ctx);
+	strbuf_release(&key);
+
+	hex = hash_to_hex_algop(hash, algo);
+	return repo_git_path(sb->repo, "blame-cache/%.2s/%s", hex, hex + 2);
+}
+
+static struct commit *blame_cache_commit(struct blame_scoreboard *sb,
+					 const struct object_id *oid)
+{
+	struct commit *commit;
+
+	if (is_null_oid(oid))
+		return NULL;
+	commit = lookup_commit(sb->repo, oid);
+	if (!commit || repo_parse_commit(sb->repo, commit))
+		return NULL;
+	return commit;
+}
+
+/*
+ * Parse a blame cache file from 'buf' into 'records'.  The records
+ * must cover the whole file, one after another.
+ */
+static int parse_blame_cache(struct blame_scoreboard *sb,
+			     const struct strbuf *buf,
+			     struct blame_cache_record **records, int *nr)
+{
+	const struct git_hash_algo *algo = sb->repo->hash_algo;
+	const char *p = buf->buf, *end = buf->buf + buf->len;
+	struct object_id oid;
+	int alloc = 0;
+
+	*nr = 0;
+	while (p < end) {
+		struct blame_cache_record *r;
+		const char *field_end;
+		char *num_end;
+
+		ALLOC_GROW(*records, *nr + 1, alloc);
+		r = &(*records)[*nr];
+		memset(r, 0, sizeof(*r));
+
+		r->lno = strtol(p, &num_end, 10);
+		if (*num_end != ' ' ||
+		    r->lno != (*nr ? r[-1].lno + r[-1].num_lines : 0))
+			return -1;
+		r->num_lines = strtol(num_end + 1, &num_end, 10);
+		if (*num_end != ' ' || r->num_lines <= 0)
+			return -1;
+		r->s_lno = strtol(num_end + 1, &num_end, 10);
+		if (*num_end != ' ' || r->s_lno < 0)
+			return -1;
+		if (parse_oid_hex_algop(num_end + 1, &oid, &field_end, algo) ||
+		    *field_end != ' ' ||
+		    !(r->commit = blame_cache_commit(sb, &oid)))
+			return -1;
+		if (parse_oid_hex_algop(field_end + 1, &oid, &field_end, algo) ||
+		    *field_end)
+			return -1;
+		r->previous = blame_cache_commit(sb, &oid);
+
+		p = field_end + 1;
+		if (p >= end)
+			return -1;
+		r->path = p;
+		p += strlen(p) + 1;
+		if (p >= end)
+			return -1;
+		r->previous_path = p;
+		p += strlen(p) + 1;
+		if (p > end || !*r->path || !r->previous != !*r->previous_path)
+			return -1;
+		(*nr)++;
+	}
+	return 0;
+}
+
+static struct blame_origin *blame_cache_origin(struct blame_scoreboard *sb,
+					       struct blame_cache_record *r)
+{
+	struct blame_origin *o = get_origin(r->commit, r->path);
+
+	/* treat root commit as boundary, as assign_blame() would have */
+	if (!r->commit->parents && !sb->show_root)
+		r->commit->object.flags |= UNINTERESTING;
+	o->guilty = 1;
+	if (r->previous && !o->previous)
+		o->previous = get_origin(r->previous, r->previous_path);
+	return o;
+}
+
+/*
+ * If the blame cache knows the final blame of the file of 'origin',
+ * assign the blame of all its suspects from there and return 1.
+ */
+static int take_blame_from_cache(struct blame_scoreboard *sb,
+				 struct blame_origin *origin)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_cache_record *records = NULL;
+	struct blame_entry *e, *next;
+	char *path;
+	int nr = 0, ret = 0;
+
+	if (is_null_oid(&origin->commit->object.oid))
+		return 0;
+	path = blame_cache_path(sb, &origin->commit->object.oid, origin->path);
+	if (strbuf_read_file(&buf, path, 0) < 0 ||
+	    parse_blame_cache(sb, &buf, &records, &nr) || !nr)
+		goto out;
+	for (e = origin->suspects; e; e = e->next)
+		if (e->s_lno < 0 ||
+		    e->s_lno + e->num_lines >
+		    records[nr - 1].lno + records[nr - 1].num_lines)
+			goto out;
+
+	for (e = origin->suspects; e; e = next) {
+		int i = 0;
+
+		next = e->next;
+		while (records[i].lno + records[i].num_lines <= e->s_lno)
+			i++;
+		for (; i < nr && records[i].lno < e->s_lno + e->num_lines; i++) {
+			struct blame_cache_record *r = &records[i];
+			int start = r->lno > e->s_lno ? r->lno : e->s_lno;
+			int stop = r->lno + r->num_lines;
+			struct blame_entry *piece;
+
+			if (stop > e->s_lno + e->num_lines)
+				stop = e->s_lno + e->num_lines;
+			CALLOC_ARRAY(piece, 1);
+			piece->lno = e->lno + start - e->s_lno;
+			piece->num_lines = stop - start;
+			piece->s_lno = r->s_lno + start - r->lno;
+			piece->suspect = blame_cache_origin(sb, r);
+			if (sb->found_guilty_entry)
+				sb->found_guilty_entry(piece,
+						       sb->found_guilty_entry_data);
+			piece->next = sb->ent;
+			sb->ent = piece;
+		}
+		blame_origin_decref(e->suspect);
+		free(e);
+	}
+	origin->suspects = NULL;
+	ret = 1;
+
+	/* keep it from being pruned as unused */
+	utime(path, NULL);
+
+out:
+	free(records);
+	strbuf_release(&buf);
+	free(path);
+	return ret;
+}
+
+void blame_cache_store(struct blame_scoreboard *sb)
+{
+	struct lock_file lk = LOCK_INIT;
+	struct strbuf buf = STRBUF_INIT;
+	struct blame_entry *ent, *next;
+	char *path;
+
+	if (is_null_oid(&sb->final->object.oid))
+		return;
+
+	for (ent = sb->ent; ent; ent = next) {
+		struct blame_origin *suspect = ent->suspect;
+		int num_lines = ent->num_lines;
+
+		/* coalesce what blame_coalesce() would */
+		for (next = ent->next;
+		     next && next->suspect == suspect &&
+		     next->lno == ent->lno + num_lines &&
+		     next->s_lno == ent->s_lno + num_lines;
+		     next = next->next)
+			num_lines += next->num_lines;
+
+		strbuf_addf(&buf, "%d %d %d %s ", ent->lno, num_lines,
+			    ent->s_lno, oid_to_hex(&suspect->commit->object.oid));
+		strbuf_addf(&buf, "%s%c%s%c%s%c",
+			    suspect->previous ?
+			    oid_to_hex(&suspect->previous->commit->object.oid) :
+			    oid_to_hex(null_oid(sb->repo->hash_algo)), '\0',
+			    suspect->path, '\0',
+			    suspect->previous ? suspect->previous->path : "",
+			    '\0');
+	}
+
+	path = blame_cache_path(sb, &sb->final->object.oid, sb->path);
+	if (!safe_create_leading_directories(sb->repo, path) &&
+	    hold_lock_file_for_update(&lk, path, 0) >= 0) {
+		if (write_in_full(get_lock_file_fd(&lk), buf.buf, buf.len) < 0 ||
+		    commit_lock_file(&lk))
+			rollback_lock_file(&lk);
+	}
+	free(path);
+	strbuf_release(&buf);
+}
+
+void blame_cache_prune(struct repository *r, timestamp_t expire)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct dirent *de;
+	size_t baselen;
+	DIR *dir;
+
+	dir = opendir(repo_git_path_replace(r, &path, "blame-cache"));
+	if (!dir) {
+		strbuf_release(&path);
+		return;
+	}
+	strbuf_addch(&path, '/');
+	baselen = path.len;
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		struct dirent *e;
+		size_t dirlen;
+		DIR *sub;
+
+		strbuf_setlen(&path, baselen);
+		strbuf_addstr(&path, de->d_name);
+		sub = opendir(path.buf);
+		if (!sub)
+			continue;
+		strbuf_addch(&path, '/');
+		dirlen = path.len;
+		while ((e = readdir_skip_dot_and_dotdot(sub))) {
+			struct stat st;
+
+			strbuf_setlen(&path, dirlen);
+			strbuf_addstr(&path, e->d_name);
+			if (!stat(path.buf, &st) && st.st_mtime < expire)
+				unlink_or_warn(path.buf);
+		}
+		closedir(sub);
+		/* fails, as it should, unless the directory is empty now */
+		strbuf_setlen(&path, dirlen - 1);
+		rmdir(path.buf);
+	}
+	closedir(dir);
+	strbuf_release(&path);
+}
+
+/*
+ * After 'origin' passed its blame on, note in the origin for the same
+ * path in its first parent how far down the first-parent chain the file
+ * stays the same, if the file history index knows.
+ */
+static void remember_last_change(struct blame_scoreboard *sb,
+				 struct blame_origin *origin)
+{
+	struct commit *commit = origin->commit;
+	struct commit *parent;
+	struct blame_origin *porigin;
+	struct object_id oid;
+
+	if (!commit->parents ||
+	    file_history_lookup(sb->file_history, &commit->object.oid,
+				origin->path, &oid) != 1 ||
+	    is_null_oid(&oid))
+		return;
+	parent = commit->parents->item;
+	if (oideq(&oid, &parent->object.oid))
+		return;
+
+	for (porigin = get_blame_suspects(parent); porigin; porigin = porigin->next)
+		if (!strcmp(porigin->path, origin->path)) {
+			porigin->last_change = lookup_commit(sb->repo, &oid);
+			break;
+		}
+}
+
+/*
+ * When 'origin' is not known to be a change of its file, e.g. because
+ * the blame starts there or just got down into the commits that the
+ * file history index knows, look along the first-parent chain for the
+ * commit that last changed the file, if the index knows.
+ */
+static void find_last_change(struct blame_scoreboard *sb,
+			     struct blame_origin *origin)
+{
+	struct commit *commit = origin->commit;
+	int changed;
+
+	while ((changed = file_history_lookup(sb->file_history,
+					      &commit->object.oid,
+					      origin->path, NULL)) == 0) {
+		if (!commit->parents ||
+		    repo_parse_commit(sb->repo, commit->parents->item))
+			return;
+		commit = commit->parents->item;
+	}
+	if (changed == 1 && commit != origin->commit)
+		origin->last_change = commit;
+}
+
+/*
+ * Every commit between 'origin' and its last change would pass the
+ * whole blame to its first parent; do it in one go.
+ */
+static void pass_blame_to_last_change(struct blame_scoreboard *sb,
+				      struct blame_origin *origin)
+{
+	struct blame_origin *porigin = get_origin(origin->last_change,
+						  origin->path);
+
+	if (is_null_oid(&porigin->blob_oid)) {
+		oidcpy(&porigin->blob_oid, &origin->blob_oid);
+		porigin->mode = origin->mode;
+	}
+	pass_whole_blame(sb, origin, porigin);
+	blame_origin_decref(porigin);
+}
+
 /*
  * The main loop -- while we have blobs with lines whose true origin
  * is still unknown, pick one blob, and allow its lines to pass blames
@@ -2585,6 +3173,7 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 {
 	struct rev_info *revs = sb->revs;
 	struct commit *commit = prio_queue_get(&sb->commits);
+	intmax_t skips = 0, cache_hits = 0;
 
 	while (commit) {
 		struct blame_entry *ent;
@@ -2607,11 +3196,27 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		 */
 		blame_origin_incref(suspect);
 		repo_parse_commit(the_repository, commit);
+		if (sb->use_cache && take_blame_from_cache(sb, suspect)) {
+			blame_origin_decref(suspect);
+			cache_hits++;
+			continue;
+		}
+		if (sb->file_history && !suspect->last_change)
+			find_last_change(sb, suspect);
+		if (suspect->last_change &&
+		    !repo_parse_commit(sb->repo, suspect->last_change)) {
+			pass_blame_to_last_change(sb, suspect);
+			blame_origin_decref(suspect);
+			skips++;
+			continue;
+		}
 		if (sb->reverse ||
 		    (!(commit->object.flags & UNINTERESTING) &&
-		     !(revs->max_age != -1 && commit->date < revs->max_age)))
+		     !(revs->max_age != -1 && commit->date < revs->max_age))) {
 			pass_blame(sb, suspect, opt);
-		else {
+			if (sb->file_history)
+				remember_last_change(sb, suspect);
+		} else {
 			commit->object.flags |= UNINTERESTING;
 			if (commit->object.parsed)
 				mark_parents_uninteresting(sb->revs, commit);
@@ -2643,6 +3248,13 @@ void assign_blame(struct blame_scoreboard *sb, int opt)
 		if (sb->debug) /* sanity */
 			sanity_check_refcnt(sb);
 	}
+
+	if (sb->file_history)
+		trace2_data_intmax("blame", sb->repo, "file_history/skips",
+				   skips);
+	if (sb->use_cache)
+		trace2_data_intmax("blame", sb->repo, "cache/hits",
+				   cache_hits);
 }
 
 /*
@@ -2929,6 +3541,17 @@ void setup_blame_bloom_data(struct blame_scoreboard *sb)
 	sb->bloom_data = bd;
 }
 
+void setup_blame_file_history(struct blame_scoreboard *sb)
+{
+	/*
+	 * The index follows the parents recorded in the commit-graph,
+	 * which is not used when grafts or replacements change them.
+	 */
+	if (!sb->repo->objects->commit_graph)
+		return;
+	sb->file_history = load_file_history(sb->repo);
+}
+
 void cleanup_scoreboard(struct blame_scoreboard *sb)
 {
 	free(sb->lineno);
@@ -2950,4 +3573,7 @@ void cleanup_scoreboard(struct blame_scoreboard *sb)
 		trace2_data_intmax("blame", sb->repo,
 				   "bloom/response-no", bloom_count_no);
 	}
+
+	free_file_history(sb->file_history);
+	sb->file_history = NULL;
 }
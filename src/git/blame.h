@@ -54,6 +54,12 @@ struct blame_origin {
 	struct fingerprint *fingerprints;
 	struct object_id blob_oid;
 	unsigned short mode;
+	/*
+	 * The nearest first-parent ancestor that changed the file at this
+	 * path, when the file history index told us; the blob stays the
+	 * same all the way down to it.
+	 */
+	struct commit *last_change;
 	/* guilty gets set when shipping any suspects to the final
 	 * blame list instead of other commits
 	 */
@@ -98,6 +104,7 @@ struct blame_entry {
 };
 
 struct blame_bloom_data;
+struct file_history;
 
 /*
  * The current state of the blame assignment.
@@ -150,12 +157,22 @@ struct blame_scoreboard {
 	int no_whole_file_rename;
 	int debug;
 
+	/* read and diff the candidates of copy detection in this many threads */
+	int num_threads;
+
+	/*
+	 * take the blame of files already in the blame cache from there;
+	 * see blame_cache_store()
+	 */
+	int use_cache;
+
 	/* callbacks */
 	void(*on_sanity_fail)(struct blame_scoreboard *, int);
 	void(*found_guilty_entry)(struct blame_entry *, void *);
 
 	void *found_guilty_entry_data;
 	struct blame_bloom_data *bloom_data;
+	struct file_history *file_history;
 };
 
 /*
@@ -174,12 +191,36 @@ void blame_coalesce(struct blame_scoreboard *sb);
 void blame_sort_final(struct blame_scoreboard *sb);
 unsigned blame_entry_score(struct blame_scoreboard *sb, struct blame_entry *e);
 void assign_blame(struct blame_scoreboard *sb, int opt);
+
+/*
+ * Remember the final blame in sb->ent, which must be sorted and
+ * cover the whole file, in the blame cache for later runs with
+ * sb->use_cache set.  Only valid when the result depends on nothing
+ * but the final commit, the path, sb->xdl_opts, --first-parent and
+ * --no-follow, i.e. without a range, --since, --reverse, ignored
+ * revisions, move and copy detection or a textconv driver.
+ */
+void blame_cache_store(struct blame_scoreboard *sb);
+
+/*
+ * Remove the files of the blame cache that were last used before
+ * 'expire'.
+ */
+void blame_cache_prune(struct repository *r, timestamp_t expire);
 const char *blame_nth_line(struct blame_scoreboard *sb, long lno);
 
 void init_scoreboard(struct blame_scoreboard *sb);
 void setup_scoreboard(struct blame_scoreboard *sb,
 		      struct blame_origin **orig);
 void setup_blame_bloom_data(struct blame_scoreboard *sb);
+
+/*
+ * Skip the commits that did not touch the file using the file history
+ * index, if there is one.  Only valid when every commit down the
+ * first-parent chain would pass the blame on, i.e. without a range,
+ * --since or --reverse.
+ */
+void setup_blame_file_history(struct blame_scoreboard *sb);
 void cleanup_scoreboard(struct blame_scoreboard *sb);
 
 struct blame_entry *blame_entry_prepend(struct blame_entry *head,
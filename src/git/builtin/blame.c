@@ -34,6 +34,7 @@
 #include "refs.h"
 #include "setup.h"
 #include "tag.h"
+#include "thread-utils.h"
 #include "write-or-die.h"
 
 static const char blame_usage[] = N_("git blame [<options>] [<rev-opts>] [<rev>] [--] <file>");
@@ -71,6 +72,9 @@ static int coloring_mode;
 static struct string_list ignore_revs_file_list = STRING_LIST_INIT_DUP;
 static int mark_unblamable_lines;
 static int mark_ignored_lines;
+static int blame_cache;
+static int blame_threads = 1;
+static int blame_file_history = 1;
 
 static struct date_mode blame_date_mode = { DATE_ISO8601 };
 static size_t blame_date_width;
@@ -758,6 +762,25 @@ static int git_blame_config(const char *var, const char *value,
 		mark_ignored_lines = git_config_bool(var, value);
 		return 0;
 	}
+	if (!strcmp(var, "blame.cache")) {
+		blame_cache = git_config_bool(var, value);
+		return 0;
+	}
+	if (!strcmp(var, "blame.filehistory")) {
+		blame_file_history = git_config_bool(var, value);
+		return 0;
+	}
+	if (!strcmp(var, "blame.threads")) {
+		blame_threads = git_config_int(var, value, ctx->kvi);
+		if (blame_threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    blame_threads, var);
+		if (!HAVE_THREADS && blame_threads > 1) {
+			warning(_("no threads support, ignoring %s"), var);
+			blame_threads = 1;
+		}
+		return 0;
+	}
 	if (!strcmp(var, "color.blame.repeatedlines")) {
 		if (color_parse_mem(value, strlen(value), repeated_meta_color))
 			warning(_("invalid value for '%s': '%s'"),
@@ -862,6 +885,53 @@ static int peel_to_commit_oid(struct object_id *oid_ret, void *cbdata)
 	}
 }
 
+static int has_textconv(struct userdiff_driver *driver,
+			enum userdiff_driver_type type UNUSED,
+			void *data UNUSED)
+{
+	return !!driver->textconv;
+}
+
+/*
+ * The blame cache only holds results that depend on nothing but the
+ * commit, the path and the options the cache is keyed by.  Which
+ * textconv driver applies depends on the attributes and configuration
+ * of the day for every path the blame goes through, so the cache is
+ * not used at all while any driver could convert a file.
+ */
+static int can_use_blame_cache(struct blame_scoreboard *sb, int opt,
+			       const char *revs_file)
+{
+	struct rev_info *revs = sb->revs;
+	unsigned int i;
+
+	if (sb->reverse || revs_file || revs->max_age != (timestamp_t)-1 ||
+	    (opt & (PICKAXE_BLAME_MOVE | PICKAXE_BLAME_COPY)) ||
+	    oidset_size(&sb->ignore_list))
+		return 0;
+	if (revs->diffopt.flags.allow_textconv &&
+	    for_each_userdiff_driver(has_textconv, NULL))
+		return 0;
+	for (i = 0; i < revs->pending.nr; i++)
+		if (revs->pending.objects[i].item->flags & UNINTERESTING)
+			return 0;
+	return 1;
+}
+
+static int can_use_file_history(struct blame_scoreboard *sb,
+				 const char *revs_file)
+{
+	struct rev_info *revs = sb->revs;
+	unsigned int i;
+
+	if (sb->reverse || revs_file || revs->max_age != (timestamp_t)-1)
+		return 0;
+	for (i = 0; i < revs->pending.nr; i++)
+		if (revs->pending.objects[i].item->flags & UNINTERESTING)
+			return 0;
+	return 1;
+}
+
 static void build_ignorelist(struct blame_scoreboard *sb,
 			     struct string_list *ignore_revs_file_list,
 			     struct string_list *ignore_rev_list)
@@ -943,6 +1013,7 @@ int cmd_blame(int argc,
 	unsigned int range_i;
 	long anchor;
 	long num_lines = 0;
+	int whole_file;
 	const char *str_usage = cmd_is_annotate ? annotate_usage : blame_usage;
 	const char *const *opt_usage = cmd_is_annotate ? annotate_opt_usage : blame_opt_usage;
 
@@ -1173,6 +1244,8 @@ parse_done:
 		anchor = top + 1;
 	}
 	sort_and_merge_range_set(&ranges);
+	whole_file = ranges.nr == 1 &&
+		ranges.ranges[0].start == 0 && ranges.ranges[0].end == lno;
 
 	for (range_i = ranges.nr; range_i > 0; --range_i) {
 		const struct range *r = &ranges.ranges[range_i - 1];
@@ -1203,6 +1276,10 @@ parse_done:
 	sb.show_root = show_root;
 	sb.xdl_opts = xdl_opts;
 	sb.no_whole_file_rename = no_whole_file_rename;
+	sb.num_threads = blame_threads ? blame_threads : online_cpus();
+	sb.use_cache = blame_cache && can_use_blame_cache(&sb, opt, revs_file);
+	if (blame_file_history && can_use_file_history(&sb, revs_file))
+		setup_blame_file_history(&sb);
 
 	read_mailmap(&mailmap);
 
@@ -1217,13 +1294,15 @@ parse_done:
 
 	stop_progress(&pi.progress);
 
+	blame_sort_final(&sb);
+	if (sb.use_cache && whole_file)
+		blame_cache_store(&sb);
+
 	if (!incremental)
 		setup_pager(the_repository);
 	else
 		goto cleanup;
 
-	blame_sort_final(&sb);
-
 	blame_coalesce(&sb);
 
 	if (!(output_option & (OUTPUT_COLOR_LINE | OUTPUT_SHOW_AGE_WITH_COLOR)))
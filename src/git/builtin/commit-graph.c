@@ -20,6 +20,7 @@
 	N_("git commit-graph write [--object-dir <dir>] [--append]\n" \
 	   "                       [--split[=<strategy>]] [--reachable | --stdin-packs | --stdin-commits]\n" \
 	   "                       [--changed-paths] [--[no-]max-new-filters <n>] [--[no-]progress]\n" \
+	   "                       [--[no-]file-history]\n" \
 	   "                       <split-options>")
 
 static const char * const builtin_commit_graph_verify_usage[] = {
@@ -48,6 +49,7 @@ static struct opts_commit_graph {
 	int shallow;
 	int progress;
 	int enable_changed_paths;
+	int file_history;
 } opts;
 
 static struct option common_opts[] = {
@@ -237,6 +239,8 @@ static int graph_write(int argc, const char **argv, const char *prefix,
 			N_("include all commits already in the commit-graph file")),
 		OPT_BOOL(0, "changed-paths", &opts.enable_changed_paths,
 			N_("enable computation for changed paths")),
+		OPT_BOOL(0, "file-history", &opts.file_history,
+			N_("also write the file history index")),
 		OPT_CALLBACK_F(0, "split", &write_opts.split_flags, NULL,
 			N_("allow writing an incremental commit-graph file"),
 			PARSE_OPT_OPTARG | PARSE_OPT_NONEG,
@@ -266,6 +270,8 @@ static int graph_write(int argc, const char **argv, const char *prefix,
 	trace2_cmd_mode("write");
 
 	git_config(git_commit_graph_write_config, &opts);
+	prepare_repo_settings(the_repository);
+	opts.file_history = the_repository->settings.commit_graph_file_history;
 
 	argc = parse_options(argc, argv, prefix,
 			     options,
@@ -288,6 +294,8 @@ static int graph_write(int argc, const char **argv, const char *prefix,
 	if (opts.enable_changed_paths == 1 ||
 	    git_env_bool(GIT_TEST_COMMIT_GRAPH_CHANGED_PATHS, 0))
 		flags |= COMMIT_GRAPH_WRITE_BLOOM_FILTERS;
+	if (opts.file_history)
+		flags |= COMMIT_GRAPH_WRITE_FILE_HISTORY;
 
 	odb = find_odb(the_repository, opts.obj_dir);
 
@@ -2651,6 +2651,8 @@ int cmd_fetch(int argc,
 
 		if (progress)
 			commit_graph_flags |= COMMIT_GRAPH_WRITE_PROGRESS;
+		if (the_repository->settings.commit_graph_file_history)
+			commit_graph_flags |= COMMIT_GRAPH_WRITE_FILE_HISTORY;
 
 		trace2_region_enter("fetch", "write-commit-graph", the_repository);
 		write_commit_graph_reachable(the_repository->objects->odb,
@@ -7,6 +7,7 @@
 #include "dir.h"
 #include "gettext.h"
 #include "parse-options.h"
+#include "read-cache-ll.h"
 #include "fsmonitor-ll.h"
 #include "fsmonitor-ipc.h"
 #include "fsmonitor-settings.h"
@@ -276,6 +277,133 @@ static void with_lock__abort_all_cookies(struct fsmonitor_daemon_state *state)
 		pthread_cond_broadcast(&state->cookies_cond);
 }
 
+/*
+ * The stat cache remembers the lstat() data of the worktree files
+ * that clients asked about in a "stat" request, until the listener
+ * reports a change to them.  It lets a client whose index has no
+ * fsmonitor token yet (or lost it) learn which entries still match
+ * the worktree without lstat()ing every file itself.
+ *
+ * Every change to the cache bumps `stat_cache_gen`, so that a client
+ * thread that lstat()ed files without holding the lock can tell
+ * whether its results may still be added to the cache.
+ *
+ * The cache holds at most STAT_CACHE_MAX_ENTRIES entries.  They are
+ * kept on `stat_cache_lru` in the order they were last asked about,
+ * and the least recently used one is dropped to make room.
+ */
+#define STAT_CACHE_MAX_ENTRIES (256 * 1024)
+
+struct stat_cache_entry {
+	struct hashmap_entry entry;
+	struct list_head lru;
+	struct stat st;
+	char path[FLEX_ARRAY];
+};
+
+static int stat_cache_cmp(const void *data UNUSED,
+			  const struct hashmap_entry *he1,
+			  const struct hashmap_entry *he2, const void *keydata)
+{
+	const struct stat_cache_entry *a =
+		container_of(he1, const struct stat_cache_entry, entry);
+	const struct stat_cache_entry *b =
+		container_of(he2, const struct stat_cache_entry, entry);
+
+	return fspathcmp(a->path, keydata ? keydata : b->path);
+}
+
+static struct stat_cache_entry *with_lock__stat_cache_get(
+	struct fsmonitor_daemon_state *state, const char *path)
+{
+	/* assert current thread holding state->main_lock */
+
+	return hashmap_get_entry_from_hash(&state->stat_cache, fspathhash(path),
+					   path, struct stat_cache_entry,
+					   entry);
+}
+
+static void with_lock__stat_cache_add(struct fsmonitor_daemon_state *state,
+				      const char *path, struct stat *st)
+{
+	/* assert current thread holding state->main_lock */
+
+	struct stat_cache_entry *e;
+
+	if (with_lock__stat_cache_get(state, path))
+		return;
+	if (hashmap_get_size(&state->stat_cache) >= STAT_CACHE_MAX_ENTRIES) {
+		e = list_first_entry(&state->stat_cache_lru,
+				     struct stat_cache_entry, lru);
+		hashmap_remove(&state->stat_cache, &e->entry, NULL);
+		list_del(&e->lru);
+		free(e);
+	}
+	FLEX_ALLOC_STR(e, path, path);
+	hashmap_entry_init(&e->entry, fspathhash(path));
+	e->st = *st;
+	hashmap_add(&state->stat_cache, &e->entry);
+	list_add_tail(&e->lru, &state->stat_cache_lru);
+	state->stat_cache_gen++;
+}
+
+/*
+ * Forget what we know about 'path', or about everything below it if
+ * it names a directory (with a trailing slash).
+ */
+static void with_lock__stat_cache_invalidate(
+	struct fsmonitor_daemon_state *state, const char *path)
+{
+	/* assert current thread holding state->main_lock */
+
+	size_t len = strlen(path);
+
+	if (!hashmap_get_size(&state->stat_cache))
+		return;
+
+	if (!len || path[len - 1] == '/') {
+		struct hashmap_iter iter;
+		struct stat_cache_entry *e, **doomed = NULL;
+		size_t nr = 0, alloc = 0;
+
+		/* removing entries may rehash the map, so do not iterate */
+		hashmap_for_each_entry(&state->stat_cache, &iter, e, entry) {
+			if (fspathncmp(e->path, path, len))
+				continue;
+			ALLOC_GROW(doomed, nr + 1, alloc);
+			doomed[nr++] = e;
+		}
+		while (nr--) {
+			hashmap_remove(&state->stat_cache, &doomed[nr]->entry,
+				       NULL);
+			list_del(&doomed[nr]->lru);
+			free(doomed[nr]);
+		}
+		free(doomed);
+	} else {
+		struct stat_cache_entry *e;
+
+		e = with_lock__stat_cache_get(state, path);
+		if (!e)
+			return;
+		hashmap_remove(&state->stat_cache, &e->entry, NULL);
+		list_del(&e->lru);
+		free(e);
+	}
+	state->stat_cache_gen++;
+}
+
+static void with_lock__stat_cache_clear(struct fsmonitor_daemon_state *state)
+{
+	/* assert current thread holding state->main_lock */
+
+	hashmap_clear_and_free(&state->stat_cache, struct stat_cache_entry,
+			       entry);
+	hashmap_init(&state->stat_cache, stat_cache_cmp, NULL, 0);
+	INIT_LIST_HEAD(&state->stat_cache_lru);
+	state->stat_cache_gen++;
+}
+
 /*
  * Requests to and from a FSMonitor Protocol V2 provider use an opaque
  * "token" as a virtual timestamp.  Clients can request a summary of all
@@ -599,6 +727,7 @@ static void with_lock__do_force_resync(struct fsmonitor_daemon_state *state)
 	fsmonitor_free_token_data(free_me);
 
 	with_lock__abort_all_cookies(state);
+	with_lock__stat_cache_clear(state);
 }
 
 void fsmonitor_force_resync(struct fsmonitor_daemon_state *state)
@@ -652,6 +781,186 @@ static int fsmonitor_parse_client_token(const char *buf_token,
 	return 0;
 }
 
+struct stat_request_item {
+	const char *path;
+	unsigned int mode;
+	struct stat_data sd;
+	struct stat st;
+	unsigned cached:1,
+		 missing:1;
+};
+
+/*
+ * Parse one line of a "stat" request
+ *
+ *   <mode> SP <ctime> SP <ctime-nsec> SP <mtime> SP <mtime-nsec> SP
+ *   <dev> SP <ino> SP <uid> SP <gid> SP <size> SP <path>
+ *
+ * which carries the mode (in octal) and stat data (in decimal) of the
+ * client's cache entry for the workdir-relative <path>.
+ */
+static int parse_stat_request_line(char *line, struct stat_request_item *item)
+{
+	unsigned long v[9];
+	char *end;
+	size_t k;
+
+	item->mode = strtoul(line, &end, 8);
+	if (end == line || *end != ' ')
+		return -1;
+	for (k = 0; k < ARRAY_SIZE(v); k++) {
+		line = end + 1;
+		v[k] = strtoul(line, &end, 10);
+		if (end == line || *end != ' ')
+			return -1;
+	}
+	item->path = end + 1;
+	if (!*item->path)
+		return -1;
+
+	item->sd.sd_ctime.sec = v[0];
+	item->sd.sd_ctime.nsec = v[1];
+	item->sd.sd_mtime.sec = v[2];
+	item->sd.sd_mtime.nsec = v[3];
+	item->sd.sd_dev = v[4];
+	item->sd.sd_ino = v[5];
+	item->sd.sd_uid = v[6];
+	item->sd.sd_gid = v[7];
+	item->sd.sd_size = v[8];
+	return 0;
+}
+
+/*
+ * Answer a "stat" request with "stat" LF and one byte per requested
+ * path: '=' if the worktree file still matches the mode and stat data
+ * the client sent, so that the client can mark its cache entry up to
+ * date, and '!' if it does not or we cannot tell.
+ *
+ * Like for a token request, we first wait for a cookie, so that the
+ * stat cache has seen every change made before the request.  The
+ * paths that are not in the cache are lstat()ed without holding the
+ * lock, and only added to the cache if nothing changed it meanwhile.
+ */
+static int do_handle_stat_request(struct fsmonitor_daemon_state *state,
+				  const char *request,
+				  ipc_server_reply_cb *reply,
+				  struct ipc_server_reply_data *reply_data)
+{
+	struct strbuf buf = STRBUF_INIT;
+	struct strbuf path = STRBUF_INIT;
+	struct strbuf answer = STRBUF_INIT;
+	struct stat_request_item *items = NULL;
+	size_t nr = 0, alloc = 0, k, base_len;
+	intmax_t nr_cached = 0;
+	struct index_state istate = INDEX_STATE_INIT(the_repository);
+	struct cache_entry *ce = make_empty_transient_cache_entry(0, NULL);
+	enum fsmonitor_cookie_item_result cookie_result;
+	uint64_t gen;
+	char *line, *eol;
+
+	strbuf_addstr(&answer, "stat\n");
+
+	strbuf_addstr(&buf, request);
+	for (line = buf.buf; *line; line = eol + 1) {
+		eol = strchrnul(line, '\n');
+		if (!*eol)
+			goto malformed;
+		*eol = '\0';
+		ALLOC_GROW(items, nr + 1, alloc);
+		memset(&items[nr], 0, sizeof(items[nr]));
+		if (parse_stat_request_line(line, &items[nr]))
+			goto malformed;
+		nr++;
+	}
+
+	pthread_mutex_lock(&state->main_lock);
+	cookie_result = with_lock__wait_for_cookie(state);
+	if (cookie_result != FCIR_SEEN) {
+		pthread_mutex_unlock(&state->main_lock);
+		error(_("fsmonitor: cookie_result '%d' != SEEN"),
+		      cookie_result);
+		for (k = 0; k < nr; k++)
+			strbuf_addch(&answer, '!');
+		goto send;
+	}
+	for (k = 0; k < nr; k++) {
+		struct stat_cache_entry *e;
+
+		e = with_lock__stat_cache_get(state, items[k].path);
+		if (e) {
+			list_del(&e->lru);
+			list_add_tail(&e->lru, &state->stat_cache_lru);
+			items[k].st = e->st;
+			items[k].cached = 1;
+			nr_cached++;
+		}
+	}
+	gen = state->stat_cache_gen;
+	pthread_mutex_unlock(&state->main_lock);
+
+	strbuf_addbuf(&path, &state->path_worktree_watch);
+	strbuf_addch(&path, '/');
+	base_len = path.len;
+	for (k = 0; k < nr; k++) {
+		if (items[k].cached)
+			continue;
+		strbuf_setlen(&path, base_len);
+		strbuf_addstr(&path, items[k].path);
+		if (lstat(path.buf, &items[k].st))
+			items[k].missing = 1;
+	}
+
+	pthread_mutex_lock(&state->main_lock);
+	if (gen == state->stat_cache_gen)
+		for (k = 0; k < nr; k++)
+			if (!items[k].cached && !items[k].missing)
+				with_lock__stat_cache_add(state, items[k].path,
+							  &items[k].st);
+	pthread_mutex_unlock(&state->main_lock);
+
+	for (k = 0; k < nr; k++) {
+		unsigned int type = items[k].mode & S_IFMT;
+		char c = '!';
+
+		if (!items[k].missing && (type == S_IFREG || type == S_IFLNK)) {
+			ce->ce_mode = items[k].mode;
+			ce->ce_stat_data = items[k].sd;
+			if (!ie_match_stat(&istate, ce, &items[k].st,
+					   CE_MATCH_IGNORE_VALID |
+					   CE_MATCH_IGNORE_SKIP_WORKTREE |
+					   CE_MATCH_IGNORE_FSMONITOR |
+					   CE_MATCH_RACY_IS_DIRTY))
+				c = '=';
+		}
+		strbuf_addch(&answer, c);
+	}
+	goto send;
+
+malformed:
+	trace_printf_key(&trace_fsmonitor,
+			 "fsmonitor: invalid stat request line '%s'", line);
+	nr = 0;
+
+send:
+	for (k = 0; k < answer.len; k += LARGE_PACKET_DATA_MAX) {
+		size_t len = answer.len - k;
+
+		if (len > LARGE_PACKET_DATA_MAX)
+			len = LARGE_PACKET_DATA_MAX;
+		reply(reply_data, answer.buf + k, len);
+	}
+
+	trace2_data_intmax("fsmonitor", the_repository, "stat/count", nr);
+	trace2_data_intmax("fsmonitor", the_repository, "stat/cached", nr_cached);
+
+	discard_cache_entry(ce);
+	free(items);
+	strbuf_release(&buf);
+	strbuf_release(&path);
+	strbuf_release(&answer);
+	return 0;
+}
+
 KHASH_INIT(str, const char *, int, 0, kh_str_hash_func, kh_str_hash_equal)
 
 static int do_handle_client(struct fsmonitor_daemon_state *state,
@@ -682,6 +991,7 @@ static int do_handle_client(struct fsmonitor_daemon_state *state,
 	 *
 	 * <command> := quit NUL
 	 *            | flush NUL
+	 *            | stat LF <stat-request-line> LF ... NUL
 	 *            | <V1-time-since-epoch-ns> NUL
 	 *            | <V2-opaque-fsmonitor-token> NUL
 	 */
@@ -709,6 +1019,13 @@ static int do_handle_client(struct fsmonitor_daemon_state *state,
 		do_flush = 1;
 		do_trivial = 1;
 
+	} else if (skip_prefix(command, "stat\n", &p)) {
+		/*
+		 * Tell which of the given cache entries still match
+		 * the worktree; see do_handle_stat_request().
+		 */
+		return do_handle_stat_request(state, p, reply, reply_data);
+
 	} else if (!skip_prefix(command, "builtin:", &p)) {
 		/* assume V1 timestamp or garbage */
 
@@ -1093,6 +1410,11 @@ void fsmonitor_publish(struct fsmonitor_daemon_state *state,
 
 	if (batch) {
 		struct fsmonitor_batch *head;
+		size_t k;
+
+		for (k = 0; k < batch->nr; k++)
+			with_lock__stat_cache_invalidate(state,
+							 batch->interned_paths[k]);
 
 		head = state->current_token_data->batch_head;
 		if (!head) {
@@ -1285,6 +1607,8 @@ static int fsmonitor_run_daemon(void)
 	memset(&state, 0, sizeof(state));
 
 	hashmap_init(&state.cookies, cookies_cmp, NULL, 0);
+	hashmap_init(&state.stat_cache, stat_cache_cmp, NULL, 0);
+	INIT_LIST_HEAD(&state.stat_cache_lru);
 	pthread_mutex_init(&state.main_lock, NULL);
 	pthread_cond_init(&state.cookies_cond, NULL);
 	state.listen_error_code = 0;
@@ -1402,6 +1726,8 @@ static int fsmonitor_run_daemon(void)
 	err = fsmonitor_run_daemon_1(&state);
 
 done:
+	hashmap_clear_and_free(&state.stat_cache, struct stat_cache_entry,
+			       entry);
 	pthread_cond_destroy(&state.cookies_cond);
 	pthread_mutex_destroy(&state.main_lock);
 	fsm_listen__dtor(&state);
@@ -35,6 +35,9 @@
 #include "path.h"
 #include "reflog.h"
 #include "rerere.h"
+#include "blame.h"
+#include "rename-fingerprints.h"
+#include "grep-trigrams.h"
 #include "blob.h"
 #include "tree.h"
 #include "promisor-remote.h"
@@ -135,6 +138,7 @@ struct gc_config {
 	char *gc_log_expire;
 	char *prune_expire;
 	char *prune_worktrees_expire;
+	char *blame_cache_expire;
 	char *repack_filter;
 	char *repack_filter_to;
 	char *repack_expire_to;
@@ -159,6 +163,7 @@ struct gc_config {
 	.gc_log_expire = xstrdup("1.day.ago"), \
 	.prune_expire = xstrdup("2.weeks.ago"), \
 	.prune_worktrees_expire = xstrdup("3.months.ago"), \
+	.blame_cache_expire = xstrdup("1.month.ago"), \
 	.max_delta_cache_size = DEFAULT_DELTA_CACHE_SIZE, \
 	.delta_base_cache_limit = DEFAULT_DELTA_BASE_CACHE_LIMIT, \
 }
@@ -168,6 +173,7 @@ static void gc_config_release(struct gc_config *cfg)
 	free(cfg->gc_log_expire);
 	free(cfg->prune_expire);
 	free(cfg->prune_worktrees_expire);
+	free(cfg->blame_cache_expire);
 	free(cfg->repack_filter);
 	free(cfg->repack_filter_to);
 }
@@ -207,6 +213,11 @@ static void gc_config(struct gc_config *cfg)
 		cfg->prune_worktrees_expire = owned;
 	}
 
+	if (!repo_config_get_expiry(the_repository, "gc.blamecacheexpire", &owned)) {
+		free(cfg->blame_cache_expire);
+		cfg->blame_cache_expire = owned;
+	}
+
 	if (!repo_config_get_expiry(the_repository, "gc.logexpiry", &owned)) {
 		free(cfg->gc_log_expire);
 		cfg->gc_log_expire = owned;
@@ -424,6 +435,30 @@ out:
 	return should_gc;
 }
 
+static int maintenance_task_rename_fingerprints(struct maintenance_run_opts *opts,
+						struct gc_config *cfg UNUSED)
+{
+	unsigned flags = 0;
+
+	if (!opts->quiet)
+		flags |= RENAME_FINGERPRINTS_PROGRESS;
+	if (write_rename_fingerprints(the_repository, flags))
+		return error(_("failed to write rename fingerprints"));
+	return 0;
+}
+
+static int maintenance_task_grep_trigrams(struct maintenance_run_opts *opts,
+					  struct gc_config *cfg UNUSED)
+{
+	unsigned flags = 0;
+
+	if (!opts->quiet)
+		flags |= GREP_TRIGRAMS_PROGRESS;
+	if (write_grep_trigrams(the_repository, flags))
+		return error(_("failed to write grep trigram index"));
+	return 0;
+}
+
 static int too_many_loose_objects(struct gc_config *cfg)
 {
 	/*
@@ -1012,6 +1047,13 @@ int cmd_gc(int argc,
 	if (maintenance_task_rerere_gc(&opts, &cfg))
 		die(FAILED_RUN, "rerere");
 
+	if (cfg.blame_cache_expire) {
+		timestamp_t expire;
+
+		if (!parse_expiry_date(cfg.blame_cache_expire, &expire))
+			blame_cache_prune(the_repository, expire);
+	}
+
 	report_garbage = report_pack_garbage;
 	reprepare_packed_git(the_repository);
 	if (pack_garbage.nr > 0) {
@@ -1019,10 +1061,16 @@ int cmd_gc(int argc,
 		clean_pack_garbage();
 	}
 
-	if (the_repository->settings.gc_write_commit_graph == 1)
+	if (the_repository->settings.gc_write_commit_graph == 1) {
+		enum commit_graph_write_flags flags = 0;
+
+		if (!quiet && !daemonized)
+			flags |= COMMIT_GRAPH_WRITE_PROGRESS;
+		if (the_repository->settings.commit_graph_file_history)
+			flags |= COMMIT_GRAPH_WRITE_FILE_HISTORY;
 		write_commit_graph_reachable(the_repository->objects->odb,
-					     !quiet && !daemonized ? COMMIT_GRAPH_WRITE_PROGRESS : 0,
-					     NULL);
+					     flags, NULL);
+	}
 
 	if (opts.auto_flag && too_many_loose_objects(&cfg))
 		warning(_("There are too many unreachable loose objects; "
@@ -1545,6 +1593,8 @@ enum maintenance_task_label {
 	TASK_REFLOG_EXPIRE,
 	TASK_WORKTREE_PRUNE,
 	TASK_RERERE_GC,
+	TASK_RENAME_FINGERPRINTS,
+	TASK_GREP_TRIGRAMS,
 
 	/* Leave as final value */
 	TASK__COUNT
@@ -1596,6 +1646,14 @@ static struct maintenance_task tasks[] = {
 		maintenance_task_rerere_gc,
 		rerere_gc_condition,
 	},
+	[TASK_RENAME_FINGERPRINTS] = {
+		"rename-fingerprints",
+		maintenance_task_rename_fingerprints,
+	},
+	[TASK_GREP_TRIGRAMS] = {
+		"grep-trigrams",
+		maintenance_task_grep_trigrams,
+	},
 };
 
 static int compare_tasks_by_selection(const void *a_, const void *b_)
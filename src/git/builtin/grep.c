@@ -18,6 +18,7 @@
 #include "string-list.h"
 #include "run-command.h"
 #include "grep.h"
+#include "grep-trigrams.h"
 #include "quote.h"
 #include "dir.h"
 #include "pathspec.h"
@@ -31,6 +32,7 @@
 #include "pager.h"
 #include "path.h"
 #include "read-cache-ll.h"
+#include "trace2.h"
 #include "write-or-die.h"
 
 static const char *grep_prefix;
@@ -42,6 +44,10 @@ static char const * const grep_usage[] = {
 
 static int recurse_submodules;
 
+/* blobs the trigram index says cannot match are not read at all */
+static struct grep_trigram_query *trigram_query;
+static intmax_t trigram_skipped;
+
 static int num_threads;
 
 static pthread_t *threads;
@@ -63,14 +69,21 @@ struct work_item {
  * The work_items in [todo_start, todo_end) are waiting to be picked
  * up by a consumer thread.
  *
- * The ranges are modulo TODO_SIZE.
+ * The ranges are modulo todo_size, which grows with the number of
+ * threads so that one slow work_item does not keep the others idle
+ * for lack of room behind it.
  */
 #define TODO_SIZE 128
-static struct work_item todo[TODO_SIZE];
+#define TODO_PER_THREAD 32
+static struct work_item *todo;
+static int todo_size;
 static int todo_start;
 static int todo_end;
 static int todo_done;
 
+/* Is a consumer thread writing results to stdout? */
+static int todo_writing;
+
 /* Has all work items been added? */
 static int all_work_added;
 
@@ -110,14 +123,14 @@ static void add_work(struct grep_opt *opt, struct grep_source *gs)
 
 	grep_lock();
 
-	while ((todo_end+1) % ARRAY_SIZE(todo) == todo_done) {
+	while ((todo_end+1) % todo_size == todo_done) {
 		pthread_cond_wait(&cond_write, &grep_mutex);
 	}
 
 	todo[todo_end].source = *gs;
 	todo[todo_end].done = 0;
 	strbuf_reset(&todo[todo_end].out);
-	todo_end = (todo_end + 1) % ARRAY_SIZE(todo);
+	todo_end = (todo_end + 1) % todo_size;
 
 	pthread_cond_signal(&cond_add);
 	grep_unlock();
@@ -136,43 +149,66 @@ static struct work_item *get_work(void)
 		ret = NULL;
 	} else {
 		ret = &todo[todo_start];
-		todo_start = (todo_start + 1) % ARRAY_SIZE(todo);
+		todo_start = (todo_start + 1) % todo_size;
 	}
 	grep_unlock();
 	return ret;
 }
 
-static void work_done(struct work_item *w)
+static void write_work(struct work_item *w)
 {
-	int old_done;
+	if (w->out.len) {
+		const char *p = w->out.buf;
+		size_t len = w->out.len;
+
+		/* Skip the leading hunk mark of the first file. */
+		if (skip_first_line) {
+			while (len) {
+				len--;
+				if (*p++ == '\n')
+					break;
+			}
+			skip_first_line = 0;
+		}
+
+		write_or_die(1, p, len);
+	}
+	grep_source_clear(&w->source);
+}
 
+/*
+ * Mark 'w' as done, and write out the results that are now next in
+ * line.  Only one thread writes at a time, and it does so without
+ * holding grep_mutex, so that the others can carry on meanwhile; it
+ * looks again for results finished in the meantime before it stops.
+ * The slots being written are not reused until todo_done moves past
+ * them.
+ */
+static void work_done(struct work_item *w)
+{
 	grep_lock();
 	w->done = 1;
-	old_done = todo_done;
-	for(; todo[todo_done].done && todo_done != todo_start;
-	    todo_done = (todo_done+1) % ARRAY_SIZE(todo)) {
-		w = &todo[todo_done];
-		if (w->out.len) {
-			const char *p = w->out.buf;
-			size_t len = w->out.len;
-
-			/* Skip the leading hunk mark of the first file. */
-			if (skip_first_line) {
-				while (len) {
-					len--;
-					if (*p++ == '\n')
-						break;
-				}
-				skip_first_line = 0;
-			}
-
-			write_or_die(1, p, len);
-		}
-		grep_source_clear(&w->source);
+	if (todo_writing) {
+		grep_unlock();
+		return;
 	}
 
-	if (old_done != todo_done)
+	todo_writing = 1;
+	while (todo_done != todo_start && todo[todo_done].done) {
+		int i, end = todo_done;
+
+		while (end != todo_start && todo[end].done)
+			end = (end + 1) % todo_size;
+		grep_unlock();
+
+		for (i = todo_done; i != end; i = (i + 1) % todo_size)
+			write_work(&todo[i]);
+
+		grep_lock();
+		todo_done = end;
 		pthread_cond_signal(&cond_write);
+	}
+	todo_writing = 0;
 
 	if (all_work_added && todo_done == todo_end)
 		pthread_cond_signal(&cond_result);
@@ -232,7 +268,11 @@ static void start_threads(struct grep_opt *opt)
 	grep_use_locks = 1;
 	enable_obj_read_lock();
 
-	for (i = 0; i < ARRAY_SIZE(todo); i++) {
+	todo_size = TODO_SIZE;
+	if (num_threads > TODO_SIZE / TODO_PER_THREAD)
+		todo_size = num_threads * TODO_PER_THREAD;
+	CALLOC_ARRAY(todo, todo_size);
+	for (i = 0; i < todo_size; i++) {
 		strbuf_init(&todo[i].out, 0);
 	}
 
@@ -278,6 +318,9 @@ static int wait_all(void)
 	}
 
 	free(threads);
+	for (i = 0; i < todo_size; i++)
+		strbuf_release(&todo[i].out);
+	FREE_AND_NULL(todo);
 
 	pthread_mutex_destroy(&grep_mutex);
 	pthread_mutex_destroy(&grep_attr_mutex);
@@ -361,6 +404,12 @@ static int grep_oid(struct grep_opt *opt, const struct object_id *oid,
 	struct strbuf pathbuf = STRBUF_INIT;
 	struct grep_source gs;
 
+	if (trigram_query &&
+	    !grep_trigrams_may_match(opt->repo, trigram_query, oid)) {
+		trigram_skipped++;
+		return 0;
+	}
+
 	grep_source_name(opt, filename, tree_name_len, &pathbuf);
 	grep_source_init_oid(&gs, pathbuf.buf, path, oid, opt->repo);
 	strbuf_release(&pathbuf);
@@ -1266,17 +1315,23 @@ int cmd_grep(int argc,
 	} else if (!list.nr) {
 		if (!cached)
 			setup_work_tree();
+		else
+			trigram_query = grep_trigram_query_new(&opt);
 
 		hit = grep_cache(&opt, &pathspec, cached);
 	} else {
 		if (cached)
 			die(_("both --cached and trees are given"));
 
+		trigram_query = grep_trigram_query_new(&opt);
 		hit = grep_objects(&opt, &pathspec, &list);
 	}
 
 	if (num_threads > 1)
 		hit |= wait_all();
+	if (trigram_query)
+		trace2_data_intmax("grep", the_repository, "trigrams/skipped",
+				   trigram_skipped);
 	if (hit && show_in_pager)
 		run_pager(&opt, prefix);
 
@@ -1286,6 +1341,7 @@ out:
 	clear_pathspec(&pathspec);
 	string_list_clear(&path_list, 0);
 	free_grep_patterns(&opt);
+	grep_trigram_query_free(trigram_query);
 	object_array_clear(&list);
 	free_repos();
 	return ret;
@@ -6,6 +6,10 @@
 #include "csum-file.h"
 #include "gettext.h"
 #include "hash.h"
+#include "lockfile.h"
+#include "object-file.h"
+#include "oid-array.h"
+#include "repository.h"
 #include "trace2.h"
 
 /*
@@ -213,3 +217,118 @@ uint8_t oid_version(const struct git_hash_algo *algop)
 		die(_("invalid hash version"));
 	}
 }
+
+struct chunkfile *map_chunk_file(struct repository *r, const char *path,
+				 const char *name, uint32_t signature,
+				 unsigned char version,
+				 const unsigned char **data_p,
+				 size_t *data_len_p)
+{
+	struct chunkfile *cf;
+	const unsigned char *data;
+	size_t data_len;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = git_open(path);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return NULL;
+	}
+	data_len = xsize_t(st.st_size);
+	if (data_len < CHUNK_FILE_HEADER_SIZE + CHUNK_TOC_ENTRY_SIZE +
+		       r->hash_algo->rawsz) {
+		close(fd);
+		error(_("%s file %s is too small"), name, path);
+		return NULL;
+	}
+	map = xmmap(NULL, data_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	data = map;
+
+	if (get_be32(data) != signature) {
+		error(_("%s file %s has a bad signature"), name, path);
+		goto bail;
+	}
+	if (data[4] != version) {
+		error(_("%s version %X does not match version %X"),
+		      name, data[4], version);
+		goto bail;
+	}
+	if (data[5] != oid_version(r->hash_algo)) {
+		error(_("%s hash version %X does not match version %X"),
+		      name, data[5], oid_version(r->hash_algo));
+		goto bail;
+	}
+
+	cf = init_chunkfile(NULL);
+	if (read_table_of_contents(cf, data, data_len, CHUNK_FILE_HEADER_SIZE,
+				   data[6], 1)) {
+		free_chunkfile(cf);
+		goto bail;
+	}
+	*data_p = data;
+	*data_len_p = data_len;
+	return cf;
+
+bail:
+	munmap(map, data_len);
+	return NULL;
+}
+
+int pair_oid_fanout_chunk(struct chunkfile *cf, uint32_t chunk_id,
+			  const char *name, const uint32_t **fanout_p,
+			  uint32_t *nr)
+{
+	const unsigned char *chunk;
+	const uint32_t *fanout;
+	size_t chunk_size;
+	int i;
+
+	if (pair_chunk(cf, chunk_id, &chunk, &chunk_size))
+		return -1;
+	if (chunk_size != CHUNK_OID_FANOUT_SIZE)
+		return error(_("%s fanout chunk is wrong size"), name);
+	fanout = (const uint32_t *)chunk;
+	for (i = 0; i < 255; i++)
+		if (ntohl(fanout[i]) > ntohl(fanout[i + 1]))
+			return error(_("%s fanout values out of order"), name);
+	*fanout_p = fanout;
+	*nr = ntohl(fanout[255]);
+	return 0;
+}
+
+struct hashfile *hold_chunk_file(struct repository *r, struct lock_file *lk,
+				 const char *path)
+{
+	hold_lock_file_for_update_mode(lk, path, LOCK_DIE_ON_ERROR, 0444);
+	return hashfd(r->hash_algo, get_lock_file_fd(lk),
+		      get_lock_file_path(lk));
+}
+
+int write_chunk_file(struct chunkfile *cf, uint32_t signature,
+		     unsigned char version,
+		     const struct git_hash_algo *algop, void *data)
+{
+	hashwrite_be32(cf->f, signature);
+	hashwrite_u8(cf->f, version);
+	hashwrite_u8(cf->f, oid_version(algop));
+	hashwrite_u8(cf->f, get_num_chunks(cf));
+	hashwrite_u8(cf->f, 0); /* reserved */
+	return write_chunkfile(cf, data);
+}
+
+void write_oid_fanout_chunk(struct hashfile *f, const struct oid_array *oids)
+{
+	size_t count = 0;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		while (count < oids->nr && oids->oid[count].hash[0] == i)
+			count++;
+		hashwrite_be32(f, count);
+	}
+}
@@ -5,6 +5,9 @@
 
 struct hashfile;
 struct chunkfile;
+struct lock_file;
+struct oid_array;
+struct repository;
 
 #define CHUNK_TOC_ENTRY_SIZE (sizeof(uint32_t) + sizeof(uint64_t))
 
@@ -70,4 +73,55 @@ int read_chunk(struct chunkfile *cf,
 
 uint8_t oid_version(const struct git_hash_algo *algop);
 
+/*
+ * Several indexes under "$GIT_DIR/objects/info/" are chunk files that
+ * start with an 8-byte header made of a 4-byte signature, the version
+ * of the format, the hash version, the number of chunks and a reserved
+ * byte, and keep the sorted object names they describe in a 256-entry
+ * fanout chunk and a lookup chunk.  These helpers read and write that
+ * common part.  'name' describes the file in error messages.
+ */
+#define CHUNK_FILE_HEADER_SIZE 8
+#define CHUNK_OID_FANOUT_SIZE (4 * 256)
+
+/*
+ * Map the file at 'path', check its header and read its table of
+ * contents into a new chunkfile.  The mapped file is returned in
+ * 'data' and 'data_len', to be unmapped by the caller after freeing
+ * the chunkfile.  Returns NULL if the file does not exist, or, after
+ * reporting an error, if it is unusable.
+ */
+struct chunkfile *map_chunk_file(struct repository *r, const char *path,
+				 const char *name, uint32_t signature,
+				 unsigned char version,
+				 const unsigned char **data,
+				 size_t *data_len);
+
+/*
+ * Point 'fanout' at the fanout chunk 'chunk_id' and set 'nr' to the
+ * number of object names it covers, after checking it.  Returns -1 if
+ * the chunk is missing or malformed.
+ */
+int pair_oid_fanout_chunk(struct chunkfile *cf, uint32_t chunk_id,
+			  const char *name, const uint32_t **fanout,
+			  uint32_t *nr);
+
+/*
+ * Take the lock for writing the file at 'path', dying if it cannot
+ * be taken, and return a hashfile that writes to it.
+ */
+struct hashfile *hold_chunk_file(struct repository *r, struct lock_file *lk,
+				 const char *path);
+
+/*
+ * Write the header that map_chunk_file() checks, followed by the
+ * chunks added to 'cf'.
+ */
+int write_chunk_file(struct chunkfile *cf, uint32_t signature,
+		     unsigned char version,
+		     const struct git_hash_algo *algop, void *data);
+
+/* Write the fanout chunk of the sorted object names in 'oids'. */
+void write_oid_fanout_chunk(struct hashfile *f, const struct oid_array *oids);
+
 #endif
@@ -22,6 +22,7 @@
 #include "progress.h"
 #include "bloom.h"
 #include "commit-slab.h"
+#include "file-history.h"
 #include "shallow.h"
 #include "json-writer.h"
 #include "trace2.h"
@@ -2504,6 +2505,39 @@ out:
 	strbuf_release(&path);
 }
 
+/*
+ * Write the file history index for all the commits of the commit-graph
+ * chain, which we load again as it is now on disk.
+ */
+static int write_graph_file_history(struct repository *r,
+				    struct object_directory *odb,
+				    enum commit_graph_write_flags flags)
+{
+	struct oid_array commits = OID_ARRAY_INIT;
+	struct commit_graph *g;
+	uint32_t i;
+	int res;
+
+	close_commit_graph(r->objects);
+	r->objects->commit_graph_attempted = 0;
+	prepare_commit_graph(r);
+
+	for (g = r->objects->commit_graph; g; g = g->base_graph) {
+		for (i = 0; i < g->num_commits; i++) {
+			struct object_id oid;
+			oidread(&oid, g->chunk_oid_lookup + st_mult(g->hash_len, i),
+				r->hash_algo);
+			oid_array_append(&commits, &oid);
+		}
+	}
+
+	res = write_file_history(r, odb->path, &commits,
+				 flags & COMMIT_GRAPH_WRITE_PROGRESS ?
+				 FILE_HISTORY_PROGRESS : 0);
+	oid_array_clear(&commits);
+	return res;
+}
+
 int write_commit_graph(struct object_directory *odb,
 		       const struct string_list *const pack_indexes,
 		       struct oidset *commits,
@@ -2705,6 +2739,9 @@ cleanup:
 	free(ctx.commit_graph_filenames_after);
 	free(ctx.commit_graph_hash_after);
 
+	if (!res && (flags & COMMIT_GRAPH_WRITE_FILE_HISTORY))
+		res = write_graph_file_history(r, odb, flags);
+
 	return res;
 }
 
@@ -151,6 +151,8 @@ enum commit_graph_write_flags {
 	COMMIT_GRAPH_WRITE_SPLIT      = (1 << 2),
 	COMMIT_GRAPH_WRITE_BLOOM_FILTERS = (1 << 3),
 	COMMIT_GRAPH_NO_WRITE_BLOOM_FILTERS = (1 << 4),
+	/* also write the file history index, see file-history.h */
+	COMMIT_GRAPH_WRITE_FILE_HISTORY = (1 << 5),
 };
 
 enum commit_graph_split_flags {
@@ -0,0 +1,547 @@
+#include "git-compat-util.h"
+#include "dir.h"
+#include "fsmonitor-ll.h"
+#include "fsm-listen.h"
+#include "fsmonitor--daemon.h"
+#include "gettext.h"
+#include "hashmap.h"
+#include "simple-ipc.h"
+#include "string-list.h"
+#include "trace.h"
+#include <sys/inotify.h>
+
+/*
+ * Linux backend for the builtin FSMonitor, built on inotify(7).
+ *
+ * inotify watches are not recursive, so we add one watch for every
+ * directory in the worktree (other than ".git" itself), one for the
+ * cookie directory inside <gitdir> and, if <gitdir> is not inside the
+ * worktree, one for <gitdir>.  Watches are added and removed as
+ * directories are created, deleted and renamed.
+ *
+ * fanotify(7) with FAN_REPORT_DFID_NAME could cover the whole tree
+ * with a single mark, but only with FAN_MARK_FILESYSTEM or
+ * FAN_MARK_MOUNT, both of which require CAP_SYS_ADMIN.  The daemon is
+ * normally started on behalf of an ordinary user, so we do not use it.
+ *
+ * The number of inotify watches a user may hold is limited by
+ * /proc/sys/fs/inotify/max_user_watches.  If we run into that limit
+ * we cannot watch the whole worktree, so we refuse to start (or shut
+ * down, if it happens later) rather than serve incomplete answers.
+ * Clients then fall back to scanning the worktree themselves.
+ */
+
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | \
+		    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+		    IN_DELETE_SELF | IN_MOVE_SELF | \
+		    IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR)
+
+/*
+ * Large enough to hold a good number of events per read(2), and at
+ * least one event with a NAME_MAX name.
+ */
+#define EVENT_BUF_SIZE (64 * 1024)
+
+struct watch_entry {
+	struct hashmap_entry ent;
+	int wd;
+	/* set for the directories that make up the worktree watch */
+	unsigned int in_worktree:1;
+	char *path; /* absolute, without a trailing slash */
+};
+
+struct fsm_listen_data
+{
+	int fd_inotify;
+	int fd_stop[2];
+	struct hashmap watches; /* of struct watch_entry, keyed by wd */
+	char *buf;
+	enum shutdown_style {
+		SHUTDOWN_EVENT = 0,
+		FORCE_SHUTDOWN,
+		FORCE_ERROR_STOP,
+	} shutdown_style;
+};
+
+static int watch_entry_cmp(const void *cmp_data UNUSED,
+			   const struct hashmap_entry *eptr,
+			   const struct hashmap_entry *entry_or_key,
+			   const void *keydata UNUSED)
+{
+	const struct watch_entry *a, *b;
+
+	a = container_of(eptr, const struct watch_entry, ent);
+	b = container_of(entry_or_key, const struct watch_entry, ent);
+	return a->wd != b->wd;
+}
+
+static struct watch_entry *find_watch(struct fsm_listen_data *data, int wd)
+{
+	struct watch_entry key;
+
+	hashmap_entry_init(&key.ent, memhash(&wd, sizeof(wd)));
+	key.wd = wd;
+	return hashmap_get_entry(&data->watches, &key, ent, NULL);
+}
+
+static void free_watch(struct fsm_listen_data *data, struct watch_entry *w)
+{
+	hashmap_remove(&data->watches, &w->ent, NULL);
+	free(w->path);
+	free(w);
+}
+
+/*
+ * Add (or update) a watch on the directory 'path'.
+ *
+ * Returns 0 if successful, or if the directory disappeared before we
+ * could watch it (its parent will tell us about that).
+ * Returns -1 otherwise.
+ */
+static int add_watch(struct fsm_listen_data *data, const char *path,
+		     int in_worktree)
+{
+	struct watch_entry *w;
+	int wd;
+
+	wd = inotify_add_watch(data->fd_inotify, path, WATCH_MASK);
+	if (wd < 0) {
+		if (errno == ENOENT || errno == ENOTDIR)
+			return 0;
+		if (errno == ENOSPC)
+			return error(_("reached the inotify watch limit while "
+				       "watching '%s'; consider raising "
+				       "/proc/sys/fs/inotify/max_user_watches"),
+				     path);
+		return error_errno(_("inotify_add_watch('%s') failed"), path);
+	}
+
+	/*
+	 * Watching the same inode again (for example, a directory that
+	 * was moved away and back) gives us the same descriptor.
+	 */
+	w = find_watch(data, wd);
+	if (w) {
+		free(w->path);
+		w->path = xstrdup(path);
+		w->in_worktree = in_worktree;
+		return 0;
+	}
+
+	CALLOC_ARRAY(w, 1);
+	hashmap_entry_init(&w->ent, memhash(&wd, sizeof(wd)));
+	w->wd = wd;
+	w->in_worktree = in_worktree;
+	w->path = xstrdup(path);
+	hashmap_add(&data->watches, &w->ent);
+	return 0;
+}
+
+/*
+ * Watch the worktree directory 'path' and everything below it.  The
+ * ".git" directory is skipped; we only watch its cookie directory.
+ * 'path' is used as scratch space and restored before returning.
+ */
+static int add_watches_recursive(struct fsmonitor_daemon_state *state,
+				 struct strbuf *path)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	size_t len = path->len;
+	struct dirent *de;
+	DIR *dir;
+	int ret = 0;
+
+	if (add_watch(data, path->buf, 1))
+		return -1;
+
+	dir = opendir(path->buf);
+	if (!dir)
+		return 0;
+
+	while (!ret && (de = readdir_skip_dot_and_dotdot(dir))) {
+		strbuf_setlen(path, len);
+		strbuf_addch(path, '/');
+		strbuf_addstr(path, de->d_name);
+
+		if (get_dtype(de, path, 0) != DT_DIR)
+			continue;
+		if (fsmonitor_classify_path_absolute(state, path->buf) !=
+		    IS_WORKDIR_PATH)
+			continue;
+		ret = add_watches_recursive(state, path);
+	}
+	strbuf_setlen(path, len);
+	closedir(dir);
+	return ret;
+}
+
+/*
+ * Forget the watches on the worktree directory 'path' and everything
+ * below it, because it was moved away.
+ */
+static void remove_watches_recursive(struct fsm_listen_data *data,
+				     const char *path)
+{
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+	struct watch_entry **to_remove = NULL;
+	size_t nr = 0, alloc = 0, i;
+	size_t len = strlen(path);
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent) {
+		if (!w->in_worktree || strncmp(w->path, path, len) ||
+		    (w->path[len] && w->path[len] != '/'))
+			continue;
+		ALLOC_GROW(to_remove, nr + 1, alloc);
+		to_remove[nr++] = w;
+	}
+
+	/*
+	 * The kernel will still send IN_IGNORED for these, but we will
+	 * not recognize the descriptor anymore and drop it.
+	 */
+	for (i = 0; i < nr; i++) {
+		inotify_rm_watch(data->fd_inotify, to_remove[i]->wd);
+		free_watch(data, to_remove[i]);
+	}
+	free(to_remove);
+}
+
+static void log_mask_set(const char *path, uint32_t mask)
+{
+	struct strbuf msg = STRBUF_INIT;
+
+	if (mask & IN_MODIFY)
+		strbuf_addstr(&msg, "IN_MODIFY|");
+	if (mask & IN_ATTRIB)
+		strbuf_addstr(&msg, "IN_ATTRIB|");
+	if (mask & IN_CLOSE_WRITE)
+		strbuf_addstr(&msg, "IN_CLOSE_WRITE|");
+	if (mask & IN_CREATE)
+		strbuf_addstr(&msg, "IN_CREATE|");
+	if (mask & IN_DELETE)
+		strbuf_addstr(&msg, "IN_DELETE|");
+	if (mask & IN_MOVED_FROM)
+		strbuf_addstr(&msg, "IN_MOVED_FROM|");
+	if (mask & IN_MOVED_TO)
+		strbuf_addstr(&msg, "IN_MOVED_TO|");
+	if (mask & IN_DELETE_SELF)
+		strbuf_addstr(&msg, "IN_DELETE_SELF|");
+	if (mask & IN_MOVE_SELF)
+		strbuf_addstr(&msg, "IN_MOVE_SELF|");
+	if (mask & IN_ISDIR)
+		strbuf_addstr(&msg, "IN_ISDIR|");
+
+	trace_printf_key(&trace_fsmonitor, "inotify: '%s', mask=0x%x %s",
+			 path, mask, msg.buf);
+
+	strbuf_release(&msg);
+}
+
+/*
+ * Process the events in one buffer from read(2) and publish what we
+ * found.  Sets data->shutdown_style if the daemon should stop.
+ */
+static void handle_events(struct fsmonitor_daemon_state *state,
+			  const char *buf, size_t len)
+{
+	struct fsm_listen_data *data = state->listen_data;
+	struct fsmonitor_batch *batch = NULL;
+	struct string_list cookie_list = STRING_LIST_INIT_DUP;
+	struct strbuf path = STRBUF_INIT;
+	struct strbuf rel = STRBUF_INIT;
+	const struct inotify_event *ev;
+	const char *p;
+
+	for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+		struct watch_entry *w;
+		const char *slash;
+
+		ev = (const struct inotify_event *)p;
+
+		/*
+		 * The kernel queue overflowed and we lost events, so
+		 * we have lost sync with the filesystem.  Flush our
+		 * cached data and the batch we were building, which
+		 * is relative to the token that was just flushed.
+		 */
+		if (ev->mask & IN_Q_OVERFLOW) {
+			trace_printf_key(&trace_fsmonitor,
+					 "inotify: queue overflow");
+			fsmonitor_force_resync(state);
+			fsmonitor_batch__free_list(batch);
+			string_list_clear(&cookie_list, 0);
+			batch = NULL;
+
+			/*
+			 * We may also have missed new directories, so
+			 * walk the worktree again to watch them.
+			 */
+			strbuf_reset(&path);
+			strbuf_addbuf(&path, &state->path_worktree_watch);
+			if (add_watches_recursive(state, &path))
+				goto force_error_stop;
+			continue;
+		}
+
+		w = find_watch(data, ev->wd);
+		if (!w)
+			continue;
+		if (ev->mask & IN_IGNORED) {
+			free_watch(data, w);
+			continue;
+		}
+
+		strbuf_reset(&path);
+		strbuf_addstr(&path, w->path);
+		if (ev->len) {
+			strbuf_addch(&path, '/');
+			strbuf_addstr(&path, ev->name);
+		}
+
+		if (trace_pass_fl(&trace_fsmonitor))
+			log_mask_set(path.buf, ev->mask);
+
+		if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+			/*
+			 * Subdirectories of the worktree are reported
+			 * through their parent.  But if the worktree
+			 * root, <gitdir> or the cookie directory goes
+			 * away, we have to quit.
+			 */
+			if (w->in_worktree &&
+			    strcmp(w->path, state->path_worktree_watch.buf))
+				continue;
+			trace_printf_key(&trace_fsmonitor,
+					 "event: '%s' removed or renamed",
+					 w->path);
+			goto force_shutdown;
+		}
+
+		switch (fsmonitor_classify_path_absolute(state, path.buf)) {
+		case IS_INSIDE_DOT_GIT_WITH_COOKIE_PREFIX:
+		case IS_INSIDE_GITDIR_WITH_COOKIE_PREFIX:
+			/* Use just the filename of the cookie file. */
+			slash = find_last_dir_sep(path.buf);
+			string_list_append(&cookie_list,
+					   slash ? slash + 1 : path.buf);
+			break;
+
+		case IS_INSIDE_DOT_GIT:
+		case IS_INSIDE_GITDIR:
+			/* ignore all other paths inside of .git or gitdir */
+			break;
+
+		case IS_DOT_GIT:
+		case IS_GITDIR:
+			/*
+			 * If .git directory is deleted or renamed away,
+			 * we have to quit.
+			 */
+			if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+				trace_printf_key(&trace_fsmonitor,
+						 "event: gitdir removed");
+				goto force_shutdown;
+			}
+			break;
+
+		case IS_WORKDIR_PATH:
+			strbuf_reset(&rel);
+			strbuf_addstr(&rel, path.buf +
+				      state->path_worktree_watch.len + 1);
+
+			if (!(ev->mask & IN_ISDIR)) {
+				if (!batch)
+					batch = fsmonitor_batch__new();
+				fsmonitor_batch__add_path(batch, rel.buf);
+				break;
+			}
+
+			/*
+			 * A directory changing its own attributes does
+			 * not tell us anything about its contents.
+			 */
+			if (!(ev->mask & ~(IN_ATTRIB | IN_ISDIR)))
+				break;
+
+			if (ev->mask & IN_MOVED_FROM)
+				remove_watches_recursive(data, path.buf);
+			if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+			    add_watches_recursive(state, &path))
+				goto force_error_stop;
+
+			/*
+			 * Anything created in a new directory before we
+			 * started watching it is covered by reporting the
+			 * whole directory.
+			 */
+			strbuf_addch(&rel, '/');
+			if (!batch)
+				batch = fsmonitor_batch__new();
+			fsmonitor_batch__add_path(batch, rel.buf);
+			break;
+
+		case IS_OUTSIDE_CONE:
+		default:
+			trace_printf_key(&trace_fsmonitor,
+					 "ignoring '%s'", path.buf);
+			break;
+		}
+	}
+
+	fsmonitor_publish(state, batch, &cookie_list);
+	string_list_clear(&cookie_list, 0);
+	strbuf_release(&path);
+	strbuf_release(&rel);
+	return;
+
+force_error_stop:
+	data->shutdown_style = FORCE_ERROR_STOP;
+	goto cleanup;
+
+force_shutdown:
+	data->shutdown_style = FORCE_SHUTDOWN;
+cleanup:
+	fsmonitor_batch__free_list(batch);
+	string_list_clear(&cookie_list, 0);
+	strbuf_release(&path);
+	strbuf_release(&rel);
+}
+
+int fsm_listen__ctor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct strbuf path = STRBUF_INIT;
+
+	CALLOC_ARRAY(data, 1);
+	state->listen_data = data;
+	data->fd_stop[0] = data->fd_stop[1] = -1;
+	hashmap_init(&data->watches, watch_entry_cmp, NULL, 0);
+
+	data->fd_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (data->fd_inotify < 0) {
+		error_errno(_("inotify_init1() failed"));
+		goto failed;
+	}
+	if (pipe(data->fd_stop) < 0) {
+		error_errno(_("could not create pipe"));
+		goto failed;
+	}
+
+	strbuf_addbuf(&path, &state->path_worktree_watch);
+	if (add_watches_recursive(state, &path))
+		goto failed;
+
+	if (state->nr_paths_watching > 1 &&
+	    add_watch(data, state->path_gitdir_watch.buf, 0))
+		goto failed;
+
+	strbuf_reset(&path);
+	strbuf_addbuf(&path, &state->path_cookie_prefix);
+	strbuf_strip_suffix(&path, "/");
+	if (add_watch(data, path.buf, 0))
+		goto failed;
+
+	trace_printf_key(&trace_fsmonitor, "inotify: watching %u directories",
+			 hashmap_get_size(&data->watches));
+
+	data->buf = xmalloc(EVENT_BUF_SIZE);
+	strbuf_release(&path);
+	return 0;
+
+failed:
+	strbuf_release(&path);
+	fsm_listen__dtor(state);
+	return -1;
+}
+
+void fsm_listen__dtor(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data;
+	struct hashmap_iter iter;
+	struct watch_entry *w;
+
+	if (!state || !state->listen_data)
+		return;
+
+	data = state->listen_data;
+
+	hashmap_for_each_entry(&data->watches, &iter, w, ent)
+		free(w->path);
+	hashmap_clear_and_free(&data->watches, struct watch_entry, ent);
+
+	if (data->fd_inotify >= 0)
+		close(data->fd_inotify);
+	if (data->fd_stop[0] >= 0)
+		close(data->fd_stop[0]);
+	if (data->fd_stop[1] >= 0)
+		close(data->fd_stop[1]);
+	free(data->buf);
+
+	FREE_AND_NULL(state->listen_data);
+}
+
+void fsm_listen__stop_async(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+
+	if (write(data->fd_stop[1], "", 1) < 0)
+		error_errno(_("could not stop the fsmonitor listener"));
+}
+
+void fsm_listen__loop(struct fsmonitor_daemon_state *state)
+{
+	struct fsm_listen_data *data = state->listen_data;
+
+	/*
+	 * Our watches are in place (see fsm_listen__ctor()), so it's
+	 * safe to start serving client requests.
+	 */
+	ipc_server_start_async(state->ipc_server_data);
+
+	while (data->shutdown_style == SHUTDOWN_EVENT) {
+		struct pollfd pfd[2];
+		ssize_t len;
+
+		pfd[0].fd = data->fd_inotify;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = data->fd_stop[0];
+		pfd[1].events = POLLIN;
+
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			error_errno(_("poll() failed"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		if (pfd[1].revents)
+			break;
+		if (!pfd[0].revents)
+			continue;
+
+		len = read(data->fd_inotify, data->buf, EVENT_BUF_SIZE);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			error_errno(_("could not read inotify events"));
+			data->shutdown_style = FORCE_ERROR_STOP;
+			break;
+		}
+
+		handle_events(state, data->buf, len);
+	}
+
+	switch (data->shutdown_style) {
+	case FORCE_ERROR_STOP:
+		state->listen_error_code = -1;
+		/* fall thru */
+	case FORCE_SHUTDOWN:
+		ipc_server_stop_async(state->ipc_server_data);
+		/* fall thru */
+	case SHUTDOWN_EVENT:
+	default:
+		break;
+	}
+}
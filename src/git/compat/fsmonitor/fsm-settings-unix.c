@@ -5,24 +5,16 @@
 #include "fsmonitor-settings.h"
 #include "fsmonitor-path-utils.h"
 
- /*
- * For the builtin FSMonitor, we create the Unix domain socket for the
- * IPC in the .git directory.  If the working directory is remote,
- * then the socket will be created on the remote file system.  This
- * can fail if the remote file system does not support UDS file types
- * (e.g. smbfs to a Windows server) or if the remote kernel does not
- * allow a non-local process to bind() the socket.  (These problems
- * could be fixed by moving the UDS out of the .git directory and to a
- * well-known local directory on the client machine, but care should
- * be taken to ensure that $HOME is actually local and not a managed
- * file share.)
- *
- * FAT32 and NTFS working directories are problematic too.
- *
- * The builtin FSMonitor uses a Unix domain socket in the .git
- * directory for IPC.  These Windows drive formats do not support
- * Unix domain sockets, so mark them as incompatible for the daemon.
+/*
+ * The builtin FSMonitor talks to its clients over a Unix domain socket,
+ * which fsmonitor_ipc__get_path() puts in the .git directory, or in
+ * fsmonitor.socketDir or $HOME if the .git directory is remote.
  *
+ * Creating the socket fails on a remote filesystem that does not
+ * support the UDS file type, or whose server does not let a client
+ * bind() one, and on FAT32 and NTFS volumes, which cannot hold sockets
+ * at all.  Refuse to start the daemon if the socket would end up on
+ * such a filesystem.
  */
 static enum fsmonitor_reason check_uds_volume(struct repository *r)
 {
@@ -0,0 +1,4 @@
+DEVELOPER=1
+NO_CURL=1
+NO_GETTEXT=1
+NO_TCLTK=1
@@ -44,7 +44,10 @@
 #include "object-name.h"
 #include "read-cache-ll.h"
 #include "setup.h"
+#include "streaming.h"
 #include "strmap.h"
+#include "thread-utils.h"
+#include "trace2.h"
 #include "ws.h"
 
 #ifdef NO_FAST_WORKING_DIRECTORY
@@ -57,6 +60,8 @@ static int diff_detect_rename_default;
 static int diff_indent_heuristic = 1;
 static int diff_rename_limit_default = 1000;
 static int diff_suppress_blank_empty;
+static int diff_patch_threads = 1;
+static int diff_stream_large_files;
 static int diff_use_color_default = -1;
 static int diff_color_moved_default;
 static int diff_color_moved_ws_default;
@@ -78,6 +83,26 @@ static struct diff_options default_diff_options;
 static long diff_algorithm;
 static unsigned ws_error_highlight_default = WSEH_NEW;
 
+/*
+ * The attribute machinery is not thread-safe; this lock protects it
+ * while patches are being generated by several threads (see
+ * diff_flush_patch_parallel()).
+ */
+static pthread_mutex_t diff_attr_mutex;
+static int diff_use_locks;
+
+static inline void diff_attr_lock(void)
+{
+	if (diff_use_locks)
+		pthread_mutex_lock(&diff_attr_mutex);
+}
+
+static inline void diff_attr_unlock(void)
+{
+	if (diff_use_locks)
+		pthread_mutex_unlock(&diff_attr_mutex);
+}
+
 static char diff_colors[][COLOR_MAXLEN] = {
 	GIT_COLOR_RESET,
 	GIT_COLOR_NORMAL,	/* CONTEXT */
@@ -490,6 +515,19 @@ int git_diff_basic_config(const char *var, const char *value,
 		return 0;
 	}
 
+	if (!strcmp(var, "diff.threads")) {
+		diff_patch_threads = git_config_int(var, value, ctx->kvi);
+		if (diff_patch_threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    diff_patch_threads, var);
+		return 0;
+	}
+
+	if (!strcmp(var, "diff.streamlargefiles")) {
+		diff_stream_large_files = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (userdiff_config(var, value) < 0)
 		return -1;
 
@@ -1833,7 +1871,9 @@ static void emit_rewrite_diff(const char *name_a,
 
 	memset(&ecbdata, 0, sizeof(ecbdata));
 	ecbdata.color_diff = want_color(o->use_color);
+	diff_attr_lock();
 	ecbdata.ws_rule = whitespace_rule(o->repo->index, name_b);
+	diff_attr_unlock();
 	ecbdata.opt = o;
 	if (ecbdata.ws_rule & WS_BLANK_AT_EOF) {
 		mmfile_t mf1, mf2;
@@ -3426,6 +3466,22 @@ int diff_filespec_is_binary(struct repository *r,
 	return one->is_binary;
 }
 
+int diff_filespec_is_binary_hint(struct repository *r,
+				 struct diff_filespec *one,
+				 int content_is_binary)
+{
+	if (one->is_binary == -1 && !one->data) {
+		diff_filespec_load_driver(one, r->index);
+		if (one->driver->binary != -1)
+			one->is_binary = one->driver->binary;
+		else if (one->size > repo_settings_get_big_file_threshold(r))
+			one->is_binary = 1;
+		else
+			one->is_binary = content_is_binary;
+	}
+	return diff_filespec_is_binary(r, one);
+}
+
 static const struct userdiff_funcname *
 diff_funcname_pattern(struct diff_options *o, struct diff_filespec *one)
 {
@@ -3531,6 +3587,179 @@ static int set_diff_algorithm(struct diff_options *opts,
 	return 0;
 }
 
+static int reuse_worktree_file(struct index_state *istate,
+			       const char *name,
+			       const struct object_id *oid,
+			       int want_file);
+
+/*
+ * With diff.streamLargeFiles, the patch between two big text files is
+ * generated by xdi_diff_stream() while reading them, instead of saying
+ * they are binary (which is what the big_file_threshold check in
+ * diff_populate_filespec() makes them) or loading them whole.
+ */
+#define DIFF_STREAM_WINDOW (16 * 1024 * 1024)
+#define DIFF_STREAM_HEAD 8000
+
+struct diff_stream {
+	/* the start of the contents, read to check for binary-ness */
+	struct strbuf head;
+	size_t head_pos;
+	/* contents already in memory... */
+	const char *data;
+	size_t size, pos;
+	/* ...or an object... */
+	struct git_istream *st;
+	/* ...or a file in the working tree */
+	int fd;
+};
+
+static ssize_t read_diff_stream_source(struct diff_stream *ds,
+				       char *buf, size_t len)
+{
+	if (ds->st)
+		return read_istream(ds->st, buf, len);
+	if (ds->fd >= 0)
+		return xread(ds->fd, buf, len);
+	if (len > ds->size - ds->pos)
+		len = ds->size - ds->pos;
+	memcpy(buf, ds->data + ds->pos, len);
+	ds->pos += len;
+	return len;
+}
+
+static ssize_t read_diff_stream(void *data, char *buf, size_t len)
+{
+	struct diff_stream *ds = data;
+
+	if (ds->head_pos < ds->head.len) {
+		if (len > ds->head.len - ds->head_pos)
+			len = ds->head.len - ds->head_pos;
+		memcpy(buf, ds->head.buf + ds->head_pos, len);
+		ds->head_pos += len;
+		return len;
+	}
+	return read_diff_stream_source(ds, buf, len);
+}
+
+static void close_diff_stream(struct diff_stream *ds)
+{
+	if (ds->st)
+		close_istream(ds->st);
+	if (ds->fd >= 0)
+		close(ds->fd);
+	strbuf_release(&ds->head);
+}
+
+/*
+ * Prepare to read the contents of 'one', which is missing on this side
+ * of the pair if it is not valid.  Returns -1 if they cannot be
+ * streamed, or should not be because they are binary.
+ */
+static int open_diff_stream(struct repository *r, struct diff_stream *ds,
+			    struct diff_filespec *one, int text)
+{
+	memset(ds, 0, sizeof(*ds));
+	strbuf_init(&ds->head, 0);
+	ds->fd = -1;
+
+	if (!DIFF_FILE_VALID(one))
+		return 0;
+	if (one->data) {
+		ds->data = one->data;
+		ds->size = one->size;
+		if (!text && buffer_is_binary(one->data, one->size))
+			return -1;
+		return 0;
+	}
+	if (one->is_stdin)
+		return -1;
+
+	if (!one->oid_valid ||
+	    reuse_worktree_file(r->index, one->path, &one->oid, 0)) {
+		struct stat st;
+
+		if (would_convert_to_git(r->index, one->path) ||
+		    lstat(one->path, &st) < 0 || !S_ISREG(st.st_mode))
+			return -1;
+		ds->fd = open(one->path, O_RDONLY);
+		if (ds->fd < 0)
+			return -1;
+	} else {
+		enum object_type type;
+		unsigned long size;
+
+		ds->st = open_istream(r, &one->oid, &type, &size, NULL);
+		if (!ds->st || type != OBJ_BLOB)
+			goto fail;
+	}
+
+	/* as much as buffer_is_binary() looks at */
+	strbuf_grow(&ds->head, DIFF_STREAM_HEAD);
+	while (!text && ds->head.len < DIFF_STREAM_HEAD) {
+		ssize_t n = read_diff_stream_source(ds,
+						    ds->head.buf + ds->head.len,
+						    DIFF_STREAM_HEAD - ds->head.len);
+		if (n < 0)
+			goto fail;
+		if (!n)
+			break;
+		strbuf_setlen(&ds->head, ds->head.len + n);
+	}
+	if (!text && buffer_is_binary(ds->head.buf, ds->head.len))
+		goto fail;
+	return 0;
+
+fail:
+	close_diff_stream(ds);
+	ds->st = NULL;
+	ds->fd = -1;
+	return -1;
+}
+
+static int diff_filespec_is_big(struct repository *r,
+				struct diff_filespec *one)
+{
+	struct diff_populate_filespec_options dpf_options = {
+		.check_size_only = 1,
+	};
+
+	if (!DIFF_FILE_VALID(one) || diff_populate_filespec(r, one, &dpf_options))
+		return 0;
+	return one->size > repo_settings_get_big_file_threshold(r);
+}
+
+/*
+ * Whether the patch between 'one' and 'two' should be streamed; the
+ * options that need all the contents at once cannot be.
+ */
+static int want_streamed_diff(struct diff_options *o,
+			      struct diff_filespec *one,
+			      struct diff_filespec *two,
+			      struct userdiff_driver *textconv_one,
+			      struct userdiff_driver *textconv_two)
+{
+	if (!diff_stream_large_files ||
+	    textconv_one || textconv_two ||
+	    o->word_diff || o->color_moved ||
+	    o->flags.funccontext || o->flags.binary)
+		return 0;
+	if ((DIFF_FILE_VALID(one) && !S_ISREG(one->mode)) ||
+	    (DIFF_FILE_VALID(two) && !S_ISREG(two->mode)))
+		return 0;
+
+	diff_attr_lock();
+	diff_filespec_load_driver(one, o->repo->index);
+	diff_filespec_load_driver(two, o->repo->index);
+	diff_attr_unlock();
+	if (!o->flags.text &&
+	    (one->driver->binary == 1 || two->driver->binary == 1))
+		return 0;
+
+	return diff_filespec_is_big(o->repo, one) ||
+	       diff_filespec_is_big(o->repo, two);
+}
+
 static void builtin_diff(const char *name_a,
 			 const char *name_b,
 			 struct diff_filespec *one,
@@ -3550,6 +3779,8 @@ static void builtin_diff(const char *name_a,
 	struct userdiff_driver *textconv_two = NULL;
 	struct strbuf header = STRBUF_INIT;
 	const char *line_prefix = diff_line_prefix(o);
+	struct diff_stream ds1, ds2;
+	int stream = 0;
 
 	diff_set_mnemonic_prefix(o, "a/", "b/");
 	if (o->flags.reverse_diff) {
@@ -3649,12 +3880,22 @@ static void builtin_diff(const char *name_a,
 		}
 	}
 
+	if (!(o->irreversible_delete && lbl[1][0] == '/') &&
+	    want_streamed_diff(o, one, two, textconv_one, textconv_two)) {
+		if (!open_diff_stream(o->repo, &ds1, one, o->flags.text)) {
+			if (!open_diff_stream(o->repo, &ds2, two, o->flags.text))
+				stream = 1;
+			else
+				close_diff_stream(&ds1);
+		}
+	}
+
 	if (o->irreversible_delete && lbl[1][0] == '/') {
 		emit_diff_symbol(o, DIFF_SYMBOL_HEADER, header.buf,
 				 header.len, 0);
 		strbuf_reset(&header);
 		goto free_ab_and_return;
-	} else if (!o->flags.text &&
+	} else if (!stream && !o->flags.text &&
 		   ( (!textconv_one && diff_filespec_is_binary(o->repo, one)) ||
 		     (!textconv_two && diff_filespec_is_binary(o->repo, two)) )) {
 		struct strbuf sb = STRBUF_INIT;
@@ -3716,8 +3957,10 @@ static void builtin_diff(const char *name_a,
 			strbuf_reset(&header);
 		}
 
-		mf1.size = fill_textconv(o->repo, textconv_one, one, &mf1.ptr);
-		mf2.size = fill_textconv(o->repo, textconv_two, two, &mf2.ptr);
+		if (!stream) {
+			mf1.size = fill_textconv(o->repo, textconv_one, one, &mf1.ptr);
+			mf2.size = fill_textconv(o->repo, textconv_two, two, &mf2.ptr);
+		}
 
 		pe = diff_funcname_pattern(o, one);
 		if (!pe)
@@ -3730,8 +3973,10 @@ static void builtin_diff(const char *name_a,
 			lbl[0] = NULL;
 		ecbdata.label_path = lbl;
 		ecbdata.color_diff = want_color(o->use_color);
+		diff_attr_lock();
 		ecbdata.ws_rule = whitespace_rule(o->repo->index, name_b);
-		if (ecbdata.ws_rule & WS_BLANK_AT_EOF)
+		diff_attr_unlock();
+		if (!stream && (ecbdata.ws_rule & WS_BLANK_AT_EOF))
 			check_blank_at_eof(&mf1, &mf2, &ecbdata);
 		ecbdata.opt = o;
 		if (header.len && !o->flags.suppress_diff_headers)
@@ -3741,6 +3986,7 @@ static void builtin_diff(const char *name_a,
 		xpp.ignore_regex_nr = o->ignore_regex_nr;
 		xpp.anchors = o->anchors;
 		xpp.anchors_nr = o->anchors_nr;
+		xpp.arena = o->xdl_arena ? o->xdl_arena : xdiff_arena();
 		xecfg.ctxlen = o->context;
 		xecfg.interhunkctxlen = o->interhunkcontext;
 		xecfg.flags = XDL_EMIT_FUNCNAMES;
@@ -3759,8 +4005,18 @@ static void builtin_diff(const char *name_a,
 
 		if (o->word_diff)
 			init_diff_words_data(&ecbdata, o, one, two);
-		if (xdi_diff_outf(&mf1, &mf2, NULL, fn_out_consume,
-				  &ecbdata, &xpp, &xecfg))
+		if (stream) {
+			unsigned long window =
+				git_env_ulong("GIT_TEST_DIFF_STREAM_WINDOW",
+					      DIFF_STREAM_WINDOW);
+
+			if (xdi_diff_stream(read_diff_stream, &ds1,
+					    read_diff_stream, &ds2, window,
+					    fn_out_consume, &ecbdata,
+					    &xpp, &xecfg))
+				die("unable to generate diff for %s", one->path);
+		} else if (xdi_diff_outf(&mf1, &mf2, NULL, fn_out_consume,
+					 &ecbdata, &xpp, &xecfg))
 			die("unable to generate diff for %s", one->path);
 		if (o->word_diff)
 			free_diff_words_data(&ecbdata);
@@ -3772,6 +4028,10 @@ static void builtin_diff(const char *name_a,
 	}
 
  free_ab_and_return:
+	if (stream) {
+		close_diff_stream(&ds1);
+		close_diff_stream(&ds2);
+	}
 	strbuf_release(&header);
 	diff_free_filespec_data(one);
 	diff_free_filespec_data(two);
@@ -3872,6 +4132,7 @@ static void builtin_diffstat(const char *name_a, const char *name_b,
 		xpp.ignore_regex_nr = o->ignore_regex_nr;
 		xpp.anchors = o->anchors;
 		xpp.anchors_nr = o->anchors_nr;
+		xpp.arena = xdiff_arena();
 		xecfg.ctxlen = o->context;
 		xecfg.interhunkctxlen = o->interhunkcontext;
 		xecfg.flags = XDL_EMIT_NO_HUNK_HDR;
@@ -4567,8 +4828,11 @@ static void run_diff_cmd(const struct external_diff *pgm,
 	int must_show_header = 0;
 	struct userdiff_driver *drv = NULL;
 
-	if (o->flags.allow_external || !o->ignore_driver_algorithm)
+	if (o->flags.allow_external || !o->ignore_driver_algorithm) {
+		diff_attr_lock();
 		drv = userdiff_find_by_path(o->repo->index, attr_path);
+		diff_attr_unlock();
+	}
 
 	if (o->flags.allow_external && drv && drv->external.cmd)
 		pgm = &drv->external;
@@ -4576,11 +4840,15 @@ static void run_diff_cmd(const struct external_diff *pgm,
 	if (msg) {
 		/*
 		 * don't use colors when the header is intended for an
-		 * external diff driver
+		 * external diff driver; abbreviating the object names
+		 * looks at the object store outside of the object
+		 * reading API, so keep it from racing with other threads
 		 */
+		obj_read_lock();
 		fill_metainfo(msg, name, other, one, two, o, p,
 			      &must_show_header,
 			      want_color(o->use_color) && !pgm);
+		obj_read_unlock();
 		xfrm_msg = msg->len ? msg->buf : NULL;
 	}
 
@@ -6668,6 +6936,209 @@ static void create_filepairs_for_header_only_notifications(struct diff_options *
 	strset_clear(&present);
 }
 
+/*
+ * How many file pairs per thread may have their patch ready while
+ * an earlier one is still being worked on.
+ */
+#define PATCH_WINDOW_PER_THREAD 16
+
+struct patch_todo {
+	struct diff_options *o;
+	struct diff_filepair **pairs;
+	struct emitted_diff_symbols *out;
+	char *done;
+	int nr, next, shown, window;
+	int found_changes;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_done;
+	pthread_cond_t cond_shown;
+};
+
+static int patch_can_run_in_parallel(struct diff_options *o,
+				     struct diff_filepair **pairs, int nr)
+{
+	struct index_state *istate = o->repo->index;
+	int i;
+
+	/*
+	 * Moved-line coloring and word diffs need to see the patches of
+	 * all pairs, output prefixes come from the (stateful) graph code
+	 * and external diffs write to o->file directly.  With the index
+	 * loaded, populating a filespec may go to the working tree, and
+	 * in a partial clone it may fetch, neither of which we want to
+	 * do from several threads.
+	 */
+	if (o->emitted_symbols || o->output_prefix || o->word_diff ||
+	    (o->flags.allow_external && external_diff()) ||
+	    (istate && istate->cache) || repo_has_promisor_remote(o->repo))
+		return 0;
+
+	for (i = 0; i < nr; i++) {
+		struct diff_filepair *p = pairs[i];
+		struct userdiff_driver *drv;
+
+		if (DIFF_PAIR_UNMERGED(p) ||
+		    S_ISGITLINK(p->one->mode) || S_ISGITLINK(p->two->mode) ||
+		    p->one->count > 1 || p->two->count > 1 ||
+		    (DIFF_FILE_VALID(p->one) && !p->one->oid_valid) ||
+		    (DIFF_FILE_VALID(p->two) && !p->two->oid_valid))
+			return 0;
+
+		/* load the drivers now so that the threads only read them */
+		diff_filespec_load_driver(p->one, istate);
+		diff_filespec_load_driver(p->two, istate);
+		if (o->flags.allow_textconv &&
+		    (p->one->driver->textconv || p->two->driver->textconv))
+			return 0;
+
+		/*
+		 * The threads keep the whole patch in memory, which is
+		 * what streaming the big files is meant to avoid.
+		 */
+		if (diff_stream_large_files &&
+		    (diff_filespec_is_big(o->repo, p->one) ||
+		     diff_filespec_is_big(o->repo, p->two)))
+			return 0;
+
+		/*
+		 * run_diff_cmd() lets a driver's algorithm stick to the
+		 * options for the pairs that follow, which the threads,
+		 * each with their own copy of the options, cannot mimic.
+		 */
+		drv = userdiff_find_by_path(istate, p->one->path);
+		if (drv && ((o->flags.allow_external && drv->external.cmd) ||
+			    (!o->ignore_driver_algorithm && drv->algorithm)))
+			return 0;
+	}
+	return 1;
+}
+
+static void *patch_thread(void *data)
+{
+	struct patch_todo *todo = data;
+	struct diff_options o = *todo->o;
+	int i;
+
+	o.xdl_arena = xdl_arena_new();
+
+	pthread_mutex_lock(&todo->mutex);
+	for (;;) {
+		while (todo->next < todo->nr &&
+		       todo->next >= todo->shown + todo->window)
+			pthread_cond_wait(&todo->cond_shown, &todo->mutex);
+		if (todo->next >= todo->nr)
+			break;
+		i = todo->next++;
+		pthread_mutex_unlock(&todo->mutex);
+
+		o.emitted_symbols = &todo->out[i];
+		o.found_changes = 0;
+		diff_flush_patch(todo->pairs[i], &o);
+
+		pthread_mutex_lock(&todo->mutex);
+		todo->done[i] = 1;
+		if (o.found_changes)
+			todo->found_changes = 1;
+		pthread_cond_broadcast(&todo->cond_done);
+	}
+	pthread_mutex_unlock(&todo->mutex);
+
+	xdl_arena_free(o.xdl_arena);
+	return NULL;
+}
+
+/*
+ * Generate the patches of the queued file pairs in several threads,
+ * each buffering the symbols of one pair at a time, and show them in
+ * queue order so that the output is the same as in a single thread.
+ * Returns 0 without doing anything if threads cannot be used.
+ */
+static int diff_flush_patch_parallel(struct diff_options *o)
+{
+	struct diff_queue_struct *q = &diff_queued_diff;
+	struct patch_todo todo = { .o = o };
+	int nr_threads = diff_patch_threads ? diff_patch_threads : online_cpus();
+	int had_obj_read_lock = obj_read_use_lock;
+	pthread_t *threads;
+	int i, j;
+
+	if (!HAVE_THREADS || nr_threads < 2 || q->nr < 2)
+		return 0;
+
+	ALLOC_ARRAY(todo.pairs, q->nr);
+	for (i = 0; i < q->nr; i++)
+		if (check_pair_status(q->queue[i]))
+			todo.pairs[todo.nr++] = q->queue[i];
+	if (todo.nr < 2 || !patch_can_run_in_parallel(o, todo.pairs, todo.nr)) {
+		free(todo.pairs);
+		return 0;
+	}
+	if (nr_threads > todo.nr)
+		nr_threads = todo.nr;
+	todo.window = nr_threads * PATCH_WINDOW_PER_THREAD;
+	CALLOC_ARRAY(todo.out, todo.nr);
+	CALLOC_ARRAY(todo.done, todo.nr);
+
+	/* lazily read from the config; do it before the threads race for it */
+	repo_settings_get_big_file_threshold(the_repository);
+
+	pthread_mutex_init(&todo.mutex, NULL);
+	pthread_cond_init(&todo.cond_done, NULL);
+	pthread_cond_init(&todo.cond_shown, NULL);
+	pthread_mutex_init(&diff_attr_mutex, NULL);
+	diff_use_locks = 1;
+	enable_obj_read_lock();
+
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL, patch_thread, &todo);
+		if (err)
+			die(_("unable to create patch thread: %s"), strerror(err));
+	}
+
+	for (i = 0; i < todo.nr; i++) {
+		struct emitted_diff_symbols *out = &todo.out[i];
+
+		pthread_mutex_lock(&todo.mutex);
+		while (!todo.done[i])
+			pthread_cond_wait(&todo.cond_done, &todo.mutex);
+		pthread_mutex_unlock(&todo.mutex);
+
+		for (j = 0; j < out->nr; j++) {
+			emit_diff_symbol_from_struct(o, &out->buf[j]);
+			free((void *)out->buf[j].line);
+		}
+		FREE_AND_NULL(out->buf);
+
+		pthread_mutex_lock(&todo.mutex);
+		todo.shown = i + 1;
+		pthread_cond_broadcast(&todo.cond_shown);
+		pthread_mutex_unlock(&todo.mutex);
+	}
+
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join patch thread");
+	free(threads);
+
+	if (!had_obj_read_lock)
+		disable_obj_read_lock();
+	diff_use_locks = 0;
+	pthread_mutex_destroy(&diff_attr_mutex);
+	pthread_cond_destroy(&todo.cond_shown);
+	pthread_cond_destroy(&todo.cond_done);
+	pthread_mutex_destroy(&todo.mutex);
+
+	if (todo.found_changes)
+		o->found_changes = 1;
+	trace2_data_intmax("diff", o->repo, "patch/threads", nr_threads);
+
+	free(todo.done);
+	free(todo.out);
+	free(todo.pairs);
+	return 1;
+}
+
 static void diff_flush_patch_all_file_pairs(struct diff_options *o)
 {
 	int i;
@@ -6683,6 +7154,9 @@ static void diff_flush_patch_all_file_pairs(struct diff_options *o)
 	if (o->additional_path_headers)
 		create_filepairs_for_header_only_notifications(o);
 
+	if (diff_flush_patch_parallel(o))
+		return;
+
 	for (i = 0; i < q->nr; i++) {
 		struct diff_filepair *p = q->queue[i];
 		if (check_pair_status(p))
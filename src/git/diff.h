@@ -72,6 +72,7 @@ struct oid_array;
 struct option;
 struct repository;
 struct rev_info;
+struct s_xdlarena;
 struct userdiff_driver;
 
 typedef int (*pathchange_fn_t)(struct diff_options *options,
@@ -403,6 +404,13 @@ struct diff_options {
 	struct repository *repo;
 	struct strmap *additional_path_headers;
 
+	/*
+	 * Buffers for xdiff to reuse from one file pair to the next.
+	 * Only set in the copies of the options given to the threads
+	 * generating patches in parallel; see diff.threads.
+	 */
+	struct s_xdlarena *xdl_arena;
+
 	int no_free;
 };
 
@@ -35,16 +35,6 @@
  */
 #define HASHBASE 107927
 
-struct spanhash {
-	unsigned int hashval;
-	unsigned int cnt;
-};
-struct spanhash_top {
-	int alloc_log2;
-	int free;
-	struct spanhash data[FLEX_ARRAY];
-};
-
 static struct spanhash_top *spanhash_rehash(struct spanhash_top *orig)
 {
 	struct spanhash_top *new_spanhash;
@@ -120,15 +110,14 @@ static int spanhash_cmp(const void *a_, const void *b_)
 		a->hashval > b->hashval ? 1 : 0;
 }
 
-static struct spanhash_top *hash_chars(struct repository *r,
-				       struct diff_filespec *one)
+static struct spanhash_top *hash_buffer(const void *data, unsigned long size,
+					int is_text)
 {
 	int i, n;
 	unsigned int accum1, accum2, hashval;
 	struct spanhash_top *hash;
-	unsigned char *buf = one->data;
-	unsigned int sz = one->size;
-	int is_text = !diff_filespec_is_binary(r, one);
+	const unsigned char *buf = data;
+	unsigned int sz = size;
 
 	i = INITIAL_HASH_SIZE;
 	hash = xmalloc(st_add(sizeof(*hash),
@@ -166,6 +155,26 @@ static struct spanhash_top *hash_chars(struct repository *r,
 	return hash;
 }
 
+static struct spanhash_top *hash_chars(struct repository *r,
+				       struct diff_filespec *one)
+{
+	return hash_buffer(one->data, one->size,
+			   !diff_filespec_is_binary(r, one));
+}
+
+struct spanhash_top *diffcore_fingerprint_buffer(const void *buf,
+						 unsigned long size,
+						 int is_text)
+{
+	return hash_buffer(buf, size, is_text);
+}
+
+void *diffcore_count_fingerprint(struct repository *r,
+				 struct diff_filespec *one)
+{
+	return hash_chars(r, one);
+}
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
@@ -6,6 +6,7 @@
 #define USE_THE_REPOSITORY_VARIABLE
 
 #include "git-compat-util.h"
+#include "config.h"
 #include "diff.h"
 #include "diffcore.h"
 #include "object-file.h"
@@ -14,8 +15,10 @@
 #include "oid-array.h"
 #include "progress.h"
 #include "promisor-remote.h"
+#include "rename-fingerprints.h"
 #include "string-list.h"
 #include "strmap.h"
+#include "thread-utils.h"
 #include "trace2.h"
 
 /* Table of rename/copy destinations */
@@ -129,6 +132,24 @@ static void inexact_prefetch(void *prefetch_options)
 	oid_array_clear(&to_fetch);
 }
 
+/*
+ * We would not consider edits that change the file size so
+ * drastically.  delta_size must be smaller than
+ * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
+ *
+ * Note that base_size == 0 case is handled here already
+ * and the final score computation in estimate_similarity() would
+ * not have a divide-by-zero issue.
+ */
+static int sizes_may_be_similar(unsigned long a, unsigned long b,
+				int minimum_score)
+{
+	unsigned long max_size = a > b ? a : b;
+	unsigned long delta_size = max_size - (a < b ? a : b);
+
+	return max_size * (MAX_SCORE-minimum_score) >= delta_size * MAX_SCORE;
+}
+
 static int estimate_similarity(struct repository *r,
 			       struct diff_filespec *src,
 			       struct diff_filespec *dst,
@@ -148,7 +169,7 @@ static int estimate_similarity(struct repository *r,
 	 * match than anything else; the destination does not even
 	 * call into this function in that case.
 	 */
-	unsigned long max_size, delta_size, base_size, src_copied, literal_added;
+	unsigned long max_size, src_copied, literal_added;
 	int score;
 
 	/* We deal only with regular files.  Symlink renames are handled
@@ -176,23 +197,16 @@ static int estimate_similarity(struct repository *r,
 	    diff_populate_filespec(r, dst, dpf_opt))
 		return 0;
 
-	max_size = ((src->size > dst->size) ? src->size : dst->size);
-	base_size = ((src->size < dst->size) ? src->size : dst->size);
-	delta_size = max_size - base_size;
-
-	/* We would not consider edits that change the file size so
-	 * drastically.  delta_size must be smaller than
-	 * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
-	 *
-	 * Note that base_size == 0 case is handled here already
-	 * and the final score computation below would not have a
-	 * divide-by-zero issue.
-	 */
-	if (max_size * (MAX_SCORE-minimum_score) < delta_size * MAX_SCORE)
+	if (!sizes_may_be_similar(src->size, dst->size, minimum_score))
 		return 0;
+	max_size = ((src->size > dst->size) ? src->size : dst->size);
 
 	dpf_opt->check_size_only = 0;
 
+	if (!src->cnt_data)
+		src->cnt_data = lookup_rename_fingerprint(r, src);
+	if (!dst->cnt_data)
+		dst->cnt_data = lookup_rename_fingerprint(r, dst);
 	if (!src->cnt_data && diff_populate_filespec(r, src, dpf_opt))
 		return 0;
 	if (!dst->cnt_data && diff_populate_filespec(r, dst, dpf_opt))
@@ -1127,6 +1141,261 @@ static int too_many_rename_candidates(int num_destinations, int num_sources,
 	return 1;
 }
 
+static int size_compare(const void *a_, const void *b_)
+{
+	unsigned long a = *(const unsigned long *)a_;
+	unsigned long b = *(const unsigned long *)b_;
+
+	return a < b ? -1 : a > b;
+}
+
+/*
+ * Does 'size' pass sizes_may_be_similar() with any of the 'nr'
+ * sorted 'sizes'?  Those that do form a contiguous range, starting
+ * at the first one that is at least size * minimum_score / MAX_SCORE.
+ */
+static int has_similar_size(unsigned long size, const unsigned long *sizes,
+			    int nr, int minimum_score)
+{
+	int lo = 0, hi = nr;
+
+	while (lo < hi) {
+		int mi = lo + (hi - lo) / 2;
+		if (sizes[mi] * MAX_SCORE < size * minimum_score)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return lo < nr && sizes_may_be_similar(size, sizes[lo], minimum_score);
+}
+
+static void add_fingerprint_candidate(struct repository *r,
+				      struct diff_filespec *one,
+				      struct diff_filespec **specs, int *nr,
+				      struct diff_populate_filespec_options *dpf_opt)
+{
+	if (!S_ISREG(one->mode))
+		return;
+	dpf_opt->check_size_only = 1;
+	if (!one->cnt_data && diff_populate_filespec(r, one, dpf_opt))
+		return;
+	specs[(*nr)++] = one;
+}
+
+static void fill_fingerprints(struct repository *r,
+			      struct diff_filespec **specs, int nr,
+			      const unsigned long *other_sizes, int other_nr,
+			      int minimum_score,
+			      struct diff_populate_filespec_options *dpf_opt)
+{
+	int i;
+
+	dpf_opt->check_size_only = 0;
+	for (i = 0; i < nr; i++) {
+		struct diff_filespec *one = specs[i];
+
+		if (one->cnt_data ||
+		    !has_similar_size(one->size, other_sizes, other_nr,
+				      minimum_score))
+			continue;
+		one->cnt_data = lookup_rename_fingerprint(r, one);
+		if (one->cnt_data || diff_populate_filespec(r, one, dpf_opt))
+			continue;
+		one->cnt_data = diffcore_count_fingerprint(r, one);
+		diff_free_filespec_blob(one);
+	}
+}
+
+/*
+ * Fill in the cnt_data of every source and destination that
+ * estimate_similarity() would compute it for, so that comparing
+ * them afterwards only reads the filespecs and can be done from
+ * several threads.  A file whose size rules out every possible
+ * partner is left alone, just like estimate_similarity() would.
+ */
+static void prepare_fingerprints(struct repository *r,
+				 int minimum_score, int skip_unmodified,
+				 struct diff_populate_filespec_options *dpf_opt)
+{
+	struct diff_filespec **srcs, **dsts;
+	unsigned long *src_sizes, *dst_sizes;
+	int src_nr = 0, dst_nr = 0, i;
+
+	ALLOC_ARRAY(srcs, rename_src_nr);
+	for (i = 0; i < rename_src_nr; i++) {
+		if (skip_unmodified && diff_unmodified_pair(rename_src[i].p))
+			continue;
+		add_fingerprint_candidate(r, rename_src[i].p->one,
+					  srcs, &src_nr, dpf_opt);
+	}
+	ALLOC_ARRAY(dsts, rename_dst_nr);
+	for (i = 0; i < rename_dst_nr; i++) {
+		if (rename_dst[i].is_rename)
+			continue;
+		add_fingerprint_candidate(r, rename_dst[i].p->two,
+					  dsts, &dst_nr, dpf_opt);
+	}
+
+	ALLOC_ARRAY(src_sizes, src_nr);
+	for (i = 0; i < src_nr; i++)
+		src_sizes[i] = srcs[i]->size;
+	QSORT(src_sizes, src_nr, size_compare);
+	ALLOC_ARRAY(dst_sizes, dst_nr);
+	for (i = 0; i < dst_nr; i++)
+		dst_sizes[i] = dsts[i]->size;
+	QSORT(dst_sizes, dst_nr, size_compare);
+
+	fill_fingerprints(r, srcs, src_nr, dst_sizes, dst_nr,
+			  minimum_score, dpf_opt);
+	fill_fingerprints(r, dsts, dst_nr, src_sizes, src_nr,
+			  minimum_score, dpf_opt);
+
+	free(src_sizes);
+	free(dst_sizes);
+	free(srcs);
+	free(dsts);
+}
+
+struct rename_matrix {
+	struct repository *repo;
+	struct diff_score *mx;
+	int *rows; /* index in rename_dst of each row of mx */
+	int nr, next, done;
+	int minimum_score;
+	int skip_unmodified;
+	int want_copies;
+	int prepared; /* prepare_fingerprints() was run */
+	int num_sources;
+	struct progress *progress;
+	pthread_mutex_t mutex;
+};
+
+static void score_rename_row(struct rename_matrix *rm, int row,
+			     struct diff_populate_filespec_options *dpf_opt)
+{
+	struct diff_filespec *two = rename_dst[rm->rows[row]].p->two;
+	struct diff_score *m = &rm->mx[row * NUM_CANDIDATE_PER_DST];
+	int j;
+
+	for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
+		m[j].dst = -1;
+
+	for (j = 0; j < rename_src_nr; j++) {
+		struct diff_filespec *one = rename_src[j].p->one;
+		struct diff_score this_src;
+
+		assert(!one->rename_used || rm->want_copies || break_idx);
+
+		if (rm->skip_unmodified &&
+		    diff_unmodified_pair(rename_src[j].p))
+			continue;
+
+		/*
+		 * Once the fingerprints are prepared, a missing one
+		 * means estimate_similarity() would give up on the pair
+		 * anyway; do not let it populate the filespecs.
+		 */
+		if (rm->prepared && (!one->cnt_data || !two->cnt_data))
+			this_src.score = 0;
+		else
+			this_src.score = estimate_similarity(rm->repo, one, two,
+							     rm->minimum_score,
+							     dpf_opt);
+		this_src.name_score = basename_same(one, two);
+		this_src.dst = rm->rows[row];
+		this_src.src = j;
+		record_if_better(m, &this_src);
+		/*
+		 * Once we run estimate_similarity,
+		 * We do not need the text anymore.
+		 */
+		diff_free_filespec_blob(one);
+		diff_free_filespec_blob(two);
+	}
+}
+
+static void *rename_matrix_thread(void *data)
+{
+	struct rename_matrix *rm = data;
+	struct diff_populate_filespec_options dpf_opt = { 0 };
+	int row;
+
+	pthread_mutex_lock(&rm->mutex);
+	while (rm->next < rm->nr) {
+		row = rm->next++;
+		pthread_mutex_unlock(&rm->mutex);
+
+		score_rename_row(rm, row, &dpf_opt);
+
+		pthread_mutex_lock(&rm->mutex);
+		rm->done++;
+		display_progress(rm->progress,
+				 (uint64_t)rm->done * (uint64_t)rm->num_sources);
+	}
+	pthread_mutex_unlock(&rm->mutex);
+	return NULL;
+}
+
+static int get_rename_threads(struct repository *r)
+{
+	int nr_threads = 1;
+
+	repo_config_get_int(r, "diff.renamethreads", &nr_threads);
+	if (nr_threads < 0)
+		die(_("invalid number of threads specified (%d) for %s"),
+		    nr_threads, "diff.renameThreads");
+	if (!nr_threads)
+		nr_threads = online_cpus();
+	return HAVE_THREADS ? nr_threads : 1;
+}
+
+/*
+ * Fill the rows of the similarity matrix, in several threads if we
+ * were asked to.  Each row (destination) is scored independently and
+ * lands at the same place in rm->mx either way, so the result does
+ * not depend on the number of threads.
+ */
+static void score_rename_matrix(struct rename_matrix *rm,
+				struct diff_populate_filespec_options *dpf_opt)
+{
+	int nr_threads = get_rename_threads(rm->repo);
+	pthread_t *threads;
+	int i;
+
+	if (nr_threads > rm->nr)
+		nr_threads = rm->nr;
+	if (nr_threads < 2) {
+		for (i = 0; i < rm->nr; i++) {
+			score_rename_row(rm, i, dpf_opt);
+			display_progress(rm->progress,
+					 (uint64_t)(i + 1) * (uint64_t)rm->num_sources);
+		}
+		return;
+	}
+
+	prepare_fingerprints(rm->repo, rm->minimum_score,
+			     rm->skip_unmodified, dpf_opt);
+	rm->prepared = 1;
+
+	pthread_mutex_init(&rm->mutex, NULL);
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 rename_matrix_thread, rm);
+		if (err)
+			die(_("unable to create rename detection thread: %s"),
+			    strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join rename detection thread");
+	free(threads);
+	pthread_mutex_destroy(&rm->mutex);
+
+	trace2_data_intmax("diff", rm->repo, "inexact_renames/threads",
+			   nr_threads);
+}
+
 static int find_renames(struct diff_score *mx,
 			int dst_cnt,
 			int minimum_score,
@@ -1389,7 +1658,9 @@ void diffcore_rename_extended(struct diff_options *options,
 	struct diff_queue_struct *q = &diff_queued_diff;
 	struct diff_queue_struct outq = DIFF_QUEUE_INIT;
 	struct diff_score *mx;
-	int i, j, rename_count, skip_unmodified = 0;
+	struct rename_matrix matrix = { 0 };
+	int *rows;
+	int i, rename_count, skip_unmodified = 0;
 	int num_destinations, dst_cnt;
 	int num_sources, want_copies;
 	struct progress *progress = NULL;
@@ -1580,46 +1851,24 @@ void diffcore_rename_extended(struct diff_options *options,
 	}
 
 	CALLOC_ARRAY(mx, st_mult(NUM_CANDIDATE_PER_DST, num_destinations));
+	ALLOC_ARRAY(rows, num_destinations);
 	for (dst_cnt = i = 0; i < rename_dst_nr; i++) {
-		struct diff_filespec *two = rename_dst[i].p->two;
-		struct diff_score *m;
-
 		if (rename_dst[i].is_rename)
 			continue; /* exact or basename match already handled */
-
-		m = &mx[dst_cnt * NUM_CANDIDATE_PER_DST];
-		for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
-			m[j].dst = -1;
-
-		for (j = 0; j < rename_src_nr; j++) {
-			struct diff_filespec *one = rename_src[j].p->one;
-			struct diff_score this_src;
-
-			assert(!one->rename_used || want_copies || break_idx);
-
-			if (skip_unmodified &&
-			    diff_unmodified_pair(rename_src[j].p))
-				continue;
-
-			this_src.score = estimate_similarity(options->repo,
-							     one, two,
-							     minimum_score,
-							     &dpf_options);
-			this_src.name_score = basename_same(one, two);
-			this_src.dst = i;
-			this_src.src = j;
-			record_if_better(m, &this_src);
-			/*
-			 * Once we run estimate_similarity,
-			 * We do not need the text anymore.
-			 */
-			diff_free_filespec_blob(one);
-			diff_free_filespec_blob(two);
-		}
-		dst_cnt++;
-		display_progress(progress,
-				 (uint64_t)dst_cnt * (uint64_t)num_sources);
+		rows[dst_cnt++] = i;
 	}
+
+	matrix.repo = options->repo;
+	matrix.mx = mx;
+	matrix.rows = rows;
+	matrix.nr = dst_cnt;
+	matrix.minimum_score = minimum_score;
+	matrix.skip_unmodified = skip_unmodified;
+	matrix.want_copies = want_copies;
+	matrix.num_sources = num_sources;
+	matrix.progress = progress;
+	score_rename_matrix(&matrix, &dpf_options);
+	free(rows);
 	stop_progress(&progress);
 
 	/* cost matrix sorted by most to least similar pair */
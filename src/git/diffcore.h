@@ -92,6 +92,15 @@ void diff_free_filespec_data(struct diff_filespec *);
 void diff_free_filespec_blob(struct diff_filespec *);
 int diff_filespec_is_binary(struct repository *, struct diff_filespec *);
 
+/*
+ * Like diff_filespec_is_binary(), but when the answer would have to
+ * come from the contents, take it from 'content_is_binary' (what
+ * buffer_is_binary() said about the same blob earlier) instead of
+ * reading them.
+ */
+int diff_filespec_is_binary_hint(struct repository *, struct diff_filespec *,
+				 int content_is_binary);
+
 /**
  * This records a pair of `struct diff_filespec`; the filespec for a file in
  * the "old" set (i.e. preimage) is called `one`, and the filespec for a file
@@ -217,6 +226,37 @@ void diff_debug_queue(const char *, struct diff_queue_struct *);
 #define diff_debug_queue(a,b) do { /* nothing */ } while (0)
 #endif
 
+/*
+ * The fingerprint diffcore_count_changes() compares: the number of
+ * bytes in each chunk of the contents, keyed by the hash of the chunk
+ * and sorted by it, with a zero count after the last one.
+ */
+struct spanhash {
+	unsigned int hashval;
+	unsigned int cnt;
+};
+struct spanhash_top {
+	int alloc_log2;
+	int free;
+	struct spanhash data[FLEX_ARRAY];
+};
+
+/*
+ * Fingerprint 'size' bytes at 'buf'; when 'is_text' is set, the CR of
+ * a CRLF line ending is ignored, as it is for a non-binary filespec.
+ */
+struct spanhash_top *diffcore_fingerprint_buffer(const void *buf,
+						 unsigned long size,
+						 int is_text);
+
+/*
+ * Compute the fingerprint of the populated filespec 'one' that
+ * diffcore_count_changes() would otherwise compute on demand, for
+ * callers that want to store it in one->cnt_data up front.
+ */
+void *diffcore_count_fingerprint(struct repository *r,
+				 struct diff_filespec *one);
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
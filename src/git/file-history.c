@@ -0,0 +1,653 @@
+#include "git-compat-util.h"
+#include "file-history.h"
+#include "chunk-format.h"
+#include "commit.h"
+#include "csum-file.h"
+#include "diff.h"
+#include "diffcore.h"
+#include "gettext.h"
+#include "hash-lookup.h"
+#include "hex.h"
+#include "lockfile.h"
+#include "object-file.h"
+#include "object-store.h"
+#include "oid-array.h"
+#include "path.h"
+#include "progress.h"
+#include "repository.h"
+#include "strmap.h"
+#include "string-list.h"
+#include "trace2.h"
+
+/*
+ * The file is a chunk file with the header that map_chunk_file() in
+ * chunk-format.h reads.  The chunks are:
+ *
+ *   OIDF: the usual 256-entry fanout of the sorted commit names
+ *   OIDL: the sorted names of all the commits the index knows
+ *   PIDX: for each changed path, in strcmp() order, the 32-bit offset
+ *         of its name in PATH and the 32-bit position of its first
+ *         change in CHNG
+ *   PATH: the NUL-terminated names of the changed paths
+ *   CHNG: the changes of all paths, each the 32-bit position in OIDL of
+ *         the commit that made it followed by the 32-bit position of
+ *         the previous change along the first-parent chain (or
+ *         FH_NO_COMMIT), sorted by commit per path
+ *
+ * All integers are in network byte order.
+ */
+#define FH_SIGNATURE 0x46485354 /* "FHST" */
+#define FH_VERSION 1
+
+#define FH_CHUNKID_OIDFANOUT 0x4f494446 /* "OIDF" */
+#define FH_CHUNKID_OIDLOOKUP 0x4f49444c /* "OIDL" */
+#define FH_CHUNKID_PATHINDEX 0x50494458 /* "PIDX" */
+#define FH_CHUNKID_PATHS 0x50415448 /* "PATH" */
+#define FH_CHUNKID_CHANGES 0x43484e47 /* "CHNG" */
+
+#define FH_PATH_INDEX_WIDTH 8
+#define FH_CHANGE_WIDTH 8
+
+#define FH_NO_COMMIT 0xffffffff
+
+struct file_history {
+	const unsigned char *data;
+	size_t data_len;
+	const struct git_hash_algo *algop;
+
+	uint32_t num_commits;
+	uint32_t num_paths;
+	uint32_t num_changes;
+	size_t paths_size;
+	const uint32_t *chunk_oid_fanout;
+	const unsigned char *chunk_oid_lookup;
+	const unsigned char *chunk_path_index;
+	const unsigned char *chunk_paths;
+	const unsigned char *chunk_changes;
+};
+
+static char *file_history_filename(const char *object_dir)
+{
+	return xstrfmt("%s/info/file-history", object_dir);
+}
+
+void free_file_history(struct file_history *fh)
+{
+	if (!fh)
+		return;
+	munmap((void *)fh->data, fh->data_len);
+	free(fh);
+}
+
+static struct file_history *load_file_history_one(struct repository *r,
+						  const char *path)
+{
+	struct file_history *fh;
+	struct chunkfile *cf;
+	const unsigned char *data;
+	size_t data_len, chunk_size;
+
+	cf = map_chunk_file(r, path, "file-history", FH_SIGNATURE,
+			    FH_VERSION, &data, &data_len);
+	if (!cf)
+		return NULL;
+
+	CALLOC_ARRAY(fh, 1);
+	fh->data = data;
+	fh->data_len = data_len;
+	fh->algop = r->hash_algo;
+
+	if (pair_oid_fanout_chunk(cf, FH_CHUNKID_OIDFANOUT, "file-history",
+				  &fh->chunk_oid_fanout, &fh->num_commits))
+		goto corrupt;
+	if (pair_chunk(cf, FH_CHUNKID_OIDLOOKUP, &fh->chunk_oid_lookup,
+		       &chunk_size) ||
+	    chunk_size != st_mult(r->hash_algo->rawsz, fh->num_commits))
+		goto corrupt;
+	if (pair_chunk(cf, FH_CHUNKID_PATHINDEX, &fh->chunk_path_index,
+		       &chunk_size) ||
+	    chunk_size % FH_PATH_INDEX_WIDTH)
+		goto corrupt;
+	fh->num_paths = chunk_size / FH_PATH_INDEX_WIDTH;
+	if (pair_chunk(cf, FH_CHUNKID_PATHS, &fh->chunk_paths,
+		       &fh->paths_size) ||
+	    (fh->paths_size && fh->chunk_paths[fh->paths_size - 1]))
+		goto corrupt;
+	if (pair_chunk(cf, FH_CHUNKID_CHANGES, &fh->chunk_changes,
+		       &chunk_size) ||
+	    chunk_size % FH_CHANGE_WIDTH)
+		goto corrupt;
+	fh->num_changes = chunk_size / FH_CHANGE_WIDTH;
+
+	free_chunkfile(cf);
+	return fh;
+
+corrupt:
+	error(_("file-history file %s is corrupt"), path);
+	free_chunkfile(cf);
+	free_file_history(fh);
+	return NULL;
+}
+
+struct file_history *load_file_history(struct repository *r)
+{
+	struct file_history *fh;
+	char *path = file_history_filename(r->objects->odb->path);
+
+	fh = load_file_history_one(r, path);
+	free(path);
+	if (fh)
+		trace2_data_intmax("file_history", r, "file_history/commits",
+				   fh->num_commits);
+	return fh;
+}
+
+static const char *fh_path(struct file_history *fh, uint32_t pos)
+{
+	uint32_t offset = get_be32(fh->chunk_path_index +
+				   st_mult(FH_PATH_INDEX_WIDTH, pos));
+
+	if (offset >= fh->paths_size)
+		return NULL;
+	return (const char *)fh->chunk_paths + offset;
+}
+
+/*
+ * Return the range of changes of the path at 'pos' in PIDX in 'first'
+ * and 'end', or -1 if they are out of bounds.
+ */
+static int fh_path_changes(struct file_history *fh, uint32_t pos,
+			   uint32_t *first, uint32_t *end)
+{
+	const unsigned char *entry = fh->chunk_path_index +
+				     st_mult(FH_PATH_INDEX_WIDTH, pos);
+
+	*first = get_be32(entry + 4);
+	if (pos + 1 < fh->num_paths)
+		*end = get_be32(entry + FH_PATH_INDEX_WIDTH + 4);
+	else
+		*end = fh->num_changes;
+	if (*first > *end || *end > fh->num_changes)
+		return -1;
+	return 0;
+}
+
+static int fh_find_path(struct file_history *fh, const char *path,
+			uint32_t *first, uint32_t *end)
+{
+	uint32_t lo = 0, hi = fh->num_paths;
+
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		const char *name = fh_path(fh, mi);
+		int cmp;
+
+		if (!name)
+			return -1;
+		cmp = strcmp(name, path);
+		if (!cmp)
+			return fh_path_changes(fh, mi, first, end);
+		if (cmp < 0)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return -1;
+}
+
+int file_history_lookup(struct file_history *fh,
+			const struct object_id *commit, const char *path,
+			struct object_id *last_change)
+{
+	uint32_t pos, lo, hi, prev;
+
+	if (!bsearch_hash(commit->hash, fh->chunk_oid_fanout,
+			  fh->chunk_oid_lookup, fh->algop->rawsz, &pos))
+		return -1;
+	if (fh_find_path(fh, path, &lo, &hi))
+		return 0;
+
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		const unsigned char *change = fh->chunk_changes +
+					      st_mult(FH_CHANGE_WIDTH, mi);
+		uint32_t c = get_be32(change);
+
+		if (c < pos) {
+			lo = mi + 1;
+			continue;
+		}
+		if (c > pos) {
+			hi = mi;
+			continue;
+		}
+
+		prev = get_be32(change + 4);
+		if (prev != FH_NO_COMMIT && prev >= fh->num_commits)
+			return -1;
+		if (!last_change)
+			return 1;
+		if (prev == FH_NO_COMMIT)
+			oidclr(last_change, fh->algop);
+		else
+			oidread(last_change,
+				fh->chunk_oid_lookup +
+				st_mult(fh->algop->rawsz, prev),
+				fh->algop);
+		return 1;
+	}
+	return 0;
+}
+
+struct fh_change {
+	uint32_t commit;
+	uint32_t prev;
+};
+
+struct fh_changes {
+	struct fh_change *items;
+	size_t nr, alloc;
+};
+
+struct write_file_history_context {
+	struct repository *r;
+	struct file_history *old;
+	struct oid_array *commits;
+
+	/* position of the first parent of each commit, or FH_NO_COMMIT */
+	uint32_t *first_parent;
+
+	/*
+	 * Entry and exit times of each commit in a depth-first walk of
+	 * the tree the first-parent links make; a commit is a first-parent
+	 * ancestor of another exactly when its interval encloses the
+	 * other's.
+	 */
+	uint32_t *enter, *leave;
+
+	/* path -> struct fh_changes */
+	struct strmap paths;
+	size_t num_changes;
+
+	struct progress *progress;
+};
+
+static void add_change(struct write_file_history_context *ctx,
+		       const char *path, uint32_t commit)
+{
+	struct fh_changes *changes = strmap_get(&ctx->paths, path);
+
+	if (!changes) {
+		CALLOC_ARRAY(changes, 1);
+		strmap_put(&ctx->paths, path, changes);
+	}
+	ALLOC_GROW(changes->items, changes->nr + 1, changes->alloc);
+	changes->items[changes->nr].commit = commit;
+	changes->items[changes->nr].prev = FH_NO_COMMIT;
+	changes->nr++;
+	ctx->num_changes++;
+}
+
+/*
+ * Take over what the old index knows, marking the commits it covers
+ * in 'known'.
+ */
+static void reuse_old_changes(struct write_file_history_context *ctx,
+			      char *known)
+{
+	struct file_history *old = ctx->old;
+	const unsigned rawsz = ctx->r->hash_algo->rawsz;
+	uint32_t *map, i;
+
+	ALLOC_ARRAY(map, old->num_commits);
+	for (i = 0; i < old->num_commits; i++) {
+		struct object_id oid;
+		int pos;
+
+		oidread(&oid, old->chunk_oid_lookup + st_mult(rawsz, i),
+			ctx->r->hash_algo);
+		pos = oid_array_lookup(ctx->commits, &oid);
+		map[i] = pos < 0 ? FH_NO_COMMIT : (uint32_t)pos;
+		if (pos >= 0)
+			known[pos] = 1;
+	}
+
+	for (i = 0; i < old->num_paths; i++) {
+		const char *path = fh_path(old, i);
+		uint32_t first, end;
+
+		if (!path || fh_path_changes(old, i, &first, &end))
+			continue;
+		for (; first < end; first++) {
+			uint32_t c = get_be32(old->chunk_changes +
+					      st_mult(FH_CHANGE_WIDTH, first));
+
+			if (c < old->num_commits && map[c] != FH_NO_COMMIT)
+				add_change(ctx, path, map[c]);
+		}
+	}
+	free(map);
+}
+
+static void compute_changes(struct write_file_history_context *ctx,
+			    struct commit *c, uint32_t pos)
+{
+	struct diff_options diffopt;
+	int i;
+
+	repo_diff_setup(ctx->r, &diffopt);
+	diffopt.flags.recursive = 1;
+	diffopt.detect_rename = 0;
+	diff_setup_done(&diffopt);
+
+	if (c->parents)
+		diff_tree_oid(&c->parents->item->object.oid, &c->object.oid,
+			      "", &diffopt);
+	else
+		diff_tree_oid(NULL, &c->object.oid, "", &diffopt);
+	diffcore_std(&diffopt);
+
+	for (i = 0; i < diff_queued_diff.nr; i++)
+		add_change(ctx, diff_queued_diff.queue[i]->two->path, pos);
+	diff_queue_clear(&diff_queued_diff);
+}
+
+static void number_first_parent_tree(struct write_file_history_context *ctx)
+{
+	uint32_t nr = ctx->commits->nr;
+	uint32_t *child_start, *children, *next_child, *stack;
+	uint32_t i, clock = 0;
+
+	CALLOC_ARRAY(child_start, st_add(nr, 1));
+	ALLOC_ARRAY(children, nr);
+	ALLOC_ARRAY(next_child, nr);
+	ALLOC_ARRAY(stack, nr);
+	ALLOC_ARRAY(ctx->enter, nr);
+	ALLOC_ARRAY(ctx->leave, nr);
+
+	for (i = 0; i < nr; i++)
+		if (ctx->first_parent[i] != FH_NO_COMMIT)
+			child_start[ctx->first_parent[i] + 1]++;
+	for (i = 0; i < nr; i++)
+		child_start[i + 1] += child_start[i];
+	for (i = 0; i < nr; i++)
+		next_child[i] = child_start[i];
+	for (i = 0; i < nr; i++)
+		if (ctx->first_parent[i] != FH_NO_COMMIT)
+			children[next_child[ctx->first_parent[i]]++] = i;
+	for (i = 0; i < nr; i++)
+		next_child[i] = child_start[i];
+
+	for (i = 0; i < nr; i++) {
+		uint32_t depth = 0;
+
+		if (ctx->first_parent[i] != FH_NO_COMMIT)
+			continue;
+		ctx->enter[i] = clock++;
+		stack[depth++] = i;
+		while (depth) {
+			uint32_t top = stack[depth - 1];
+
+			if (next_child[top] < child_start[top + 1]) {
+				uint32_t child = children[next_child[top]++];
+
+				ctx->enter[child] = clock++;
+				stack[depth++] = child;
+			} else {
+				ctx->leave[top] = clock++;
+				depth--;
+			}
+		}
+	}
+
+	free(child_start);
+	free(children);
+	free(next_child);
+	free(stack);
+}
+
+static int change_enter_cmp(const void *va, const void *vb, void *data)
+{
+	const struct fh_change *a = va, *b = vb;
+	struct write_file_history_context *ctx = data;
+
+	if (ctx->enter[a->commit] != ctx->enter[b->commit])
+		return ctx->enter[a->commit] < ctx->enter[b->commit] ? -1 : 1;
+	return 0;
+}
+
+static int change_commit_cmp(const void *va, const void *vb)
+{
+	const struct fh_change *a = va, *b = vb;
+
+	if (a->commit != b->commit)
+		return a->commit < b->commit ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Find for each change of a path the previous change along the
+ * first-parent chain, i.e. its nearest ancestor in the first-parent
+ * tree among the other changes of the path.  Visiting the changes in
+ * walk order, the ancestors of each are exactly those still on the
+ * stack once the ones that were left before it are popped.
+ */
+static void link_changes(struct write_file_history_context *ctx,
+			 struct fh_changes *changes, uint32_t *stack)
+{
+	size_t i, nr, depth = 0;
+
+	/* a path may be reported twice, e.g. when its type changed */
+	QSORT(changes->items, changes->nr, change_commit_cmp);
+	for (i = nr = 0; i < changes->nr; i++)
+		if (!nr || changes->items[nr - 1].commit != changes->items[i].commit)
+			changes->items[nr++] = changes->items[i];
+	ctx->num_changes -= changes->nr - nr;
+	changes->nr = nr;
+
+	QSORT_S(changes->items, changes->nr, change_enter_cmp, ctx);
+	for (i = 0; i < changes->nr; i++) {
+		struct fh_change *c = &changes->items[i];
+
+		while (depth && ctx->leave[stack[depth - 1]] < ctx->enter[c->commit])
+			depth--;
+		c->prev = depth ? stack[depth - 1] : FH_NO_COMMIT;
+		stack[depth++] = c->commit;
+	}
+	QSORT(changes->items, changes->nr, change_commit_cmp);
+}
+
+struct write_fh_chunk_data {
+	struct write_file_history_context *ctx;
+	struct string_list *paths;
+};
+
+static int write_fh_chunk_oid_fanout(struct hashfile *f, void *data)
+{
+	struct write_fh_chunk_data *d = data;
+
+	write_oid_fanout_chunk(f, d->ctx->commits);
+	return 0;
+}
+
+static int write_fh_chunk_oid_lookup(struct hashfile *f, void *data)
+{
+	struct write_fh_chunk_data *d = data;
+	struct oid_array *commits = d->ctx->commits;
+	size_t i;
+
+	for (i = 0; i < commits->nr; i++)
+		hashwrite(f, commits->oid[i].hash, d->ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_fh_chunk_path_index(struct hashfile *f, void *data)
+{
+	struct write_fh_chunk_data *d = data;
+	size_t offset = 0, first = 0;
+	struct string_list_item *item;
+
+	for_each_string_list_item(item, d->paths) {
+		struct fh_changes *changes = item->util;
+
+		hashwrite_be32(f, offset);
+		hashwrite_be32(f, first);
+		offset += strlen(item->string) + 1;
+		first += changes->nr;
+	}
+	return 0;
+}
+
+static int write_fh_chunk_paths(struct hashfile *f, void *data)
+{
+	struct write_fh_chunk_data *d = data;
+	struct string_list_item *item;
+
+	for_each_string_list_item(item, d->paths)
+		hashwrite(f, item->string, strlen(item->string) + 1);
+	return 0;
+}
+
+static int write_fh_chunk_changes(struct hashfile *f, void *data)
+{
+	struct write_fh_chunk_data *d = data;
+	struct string_list_item *item;
+
+	for_each_string_list_item(item, d->paths) {
+		struct fh_changes *changes = item->util;
+		size_t i;
+
+		for (i = 0; i < changes->nr; i++) {
+			hashwrite_be32(f, changes->items[i].commit);
+			hashwrite_be32(f, changes->items[i].prev);
+		}
+	}
+	return 0;
+}
+
+int write_file_history(struct repository *r, const char *object_dir,
+		       struct oid_array *commits, unsigned flags)
+{
+	struct write_file_history_context ctx = {
+		.r = r,
+		.commits = commits,
+	};
+	struct string_list paths = STRING_LIST_INIT_NODUP;
+	struct write_fh_chunk_data data = {
+		.ctx = &ctx,
+		.paths = &paths,
+	};
+	struct lock_file lk = LOCK_INIT;
+	struct hashmap_iter iter;
+	struct strmap_entry *e;
+	struct chunkfile *cf;
+	struct hashfile *f;
+	char *path = file_history_filename(object_dir);
+	char *known = NULL;
+	uint32_t *stack = NULL;
+	size_t i, paths_size = 0, computed = 0;
+	int ret = 0;
+
+	strmap_init(&ctx.paths);
+	oid_array_sort(commits);
+	if (commits->nr >= FH_NO_COMMIT) {
+		ret = error(_("too many commits to write file history"));
+		goto out;
+	}
+	if (safe_create_leading_directories(r, path)) {
+		ret = error(_("unable to create leading directories of %s"),
+			    path);
+		goto out;
+	}
+
+	CALLOC_ARRAY(known, commits->nr);
+	ctx.old = load_file_history_one(r, path);
+	if (ctx.old)
+		reuse_old_changes(&ctx, known);
+
+	ALLOC_ARRAY(ctx.first_parent, commits->nr);
+	if (flags & FILE_HISTORY_PROGRESS)
+		ctx.progress = start_delayed_progress(r,
+					_("Computing file history"),
+					commits->nr);
+	for (i = 0; i < commits->nr; i++) {
+		struct commit *c = lookup_commit(r, &commits->oid[i]);
+		int pos = -1;
+
+		display_progress(ctx.progress, i + 1);
+		if (!c || repo_parse_commit(r, c)) {
+			ret = error(_("unable to parse commit %s"),
+				    oid_to_hex(&commits->oid[i]));
+			goto out;
+		}
+		if (c->parents)
+			pos = oid_array_lookup(commits,
+					       &c->parents->item->object.oid);
+		ctx.first_parent[i] = pos < 0 ? FH_NO_COMMIT : (uint32_t)pos;
+		if (!known[i]) {
+			compute_changes(&ctx, c, i);
+			computed++;
+		}
+	}
+	stop_progress(&ctx.progress);
+	trace2_data_intmax("file_history", r, "file_history/computed",
+			   computed);
+
+	number_first_parent_tree(&ctx);
+	ALLOC_ARRAY(stack, commits->nr);
+	strmap_for_each_entry(&ctx.paths, &iter, e) {
+		link_changes(&ctx, e->value, stack);
+		string_list_append(&paths, e->key)->util = e->value;
+		paths_size += strlen(e->key) + 1;
+	}
+	string_list_sort(&paths);
+	if (paths_size >= FH_NO_COMMIT || ctx.num_changes >= FH_NO_COMMIT) {
+		ret = error(_("too many changes to write file history"));
+		goto out;
+	}
+
+	f = hold_chunk_file(r, &lk, path);
+
+	cf = init_chunkfile(f);
+	add_chunk(cf, FH_CHUNKID_OIDFANOUT, CHUNK_OID_FANOUT_SIZE,
+		  write_fh_chunk_oid_fanout);
+	add_chunk(cf, FH_CHUNKID_OIDLOOKUP,
+		  st_mult(r->hash_algo->rawsz, commits->nr),
+		  write_fh_chunk_oid_lookup);
+	add_chunk(cf, FH_CHUNKID_PATHINDEX,
+		  st_mult(FH_PATH_INDEX_WIDTH, paths.nr),
+		  write_fh_chunk_path_index);
+	add_chunk(cf, FH_CHUNKID_PATHS, paths_size, write_fh_chunk_paths);
+	add_chunk(cf, FH_CHUNKID_CHANGES,
+		  st_mult(FH_CHANGE_WIDTH, ctx.num_changes),
+		  write_fh_chunk_changes);
+
+	write_chunk_file(cf, FH_SIGNATURE, FH_VERSION, r->hash_algo, &data);
+	free_chunkfile(cf);
+
+	/* let go of the old file before it is replaced */
+	free_file_history(ctx.old);
+	ctx.old = NULL;
+
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_COMMIT_GRAPH,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	if (commit_lock_file(&lk))
+		ret = error_errno(_("unable to write %s"), path);
+
+out:
+	stop_progress(&ctx.progress);
+	free_file_history(ctx.old);
+	strmap_for_each_entry(&ctx.paths, &iter, e) {
+		struct fh_changes *changes = e->value;
+		free(changes->items);
+	}
+	strmap_clear(&ctx.paths, 1);
+	string_list_clear(&paths, 0);
+	free(ctx.first_parent);
+	free(ctx.enter);
+	free(ctx.leave);
+	free(stack);
+	free(known);
+	free(path);
+	return ret;
+}
@@ -0,0 +1,48 @@
+#ifndef FILE_HISTORY_H
+#define FILE_HISTORY_H
+
+struct repository;
+struct object_id;
+struct oid_array;
+struct file_history;
+
+/*
+ * The file history index records, for every commit in the commit-graph
+ * and every path that commit changed relative to its first parent, the
+ * nearest commit further down the first-parent chain that changed the
+ * same path.  Between the two the path has the same contents, which
+ * lets blame go straight from one change of a file to the previous one
+ * without looking at the commits in between.  It lives in
+ * "$GIT_DIR/objects/info/file-history" and is written together with the
+ * commit-graph by "git commit-graph write --file-history".
+ */
+
+#define FILE_HISTORY_PROGRESS (1 << 0)
+
+/*
+ * Write the index of 'object_dir' for 'commits', which are all the
+ * commits of the commit-graph just written, reusing what the existing
+ * index already knows.  Returns 0 on success and a negative value after
+ * reporting an error.
+ */
+int write_file_history(struct repository *r, const char *object_dir,
+		       struct oid_array *commits, unsigned flags);
+
+/*
+ * Load the index of 'r', or return NULL if there is none.
+ */
+struct file_history *load_file_history(struct repository *r);
+void free_file_history(struct file_history *fh);
+
+/*
+ * Look up whether 'commit' changed 'path' relative to its first parent.
+ * Returns -1 if the index does not know 'commit', and 0 if the commit
+ * did not change the path.  Otherwise returns 1 and, unless it is NULL,
+ * stores in 'last_change' the nearest first-parent ancestor of 'commit'
+ * that changed 'path' too, or the null oid if there is no such commit.
+ */
+int file_history_lookup(struct file_history *fh,
+			const struct object_id *commit, const char *path,
+			struct object_id *last_change);
+
+#endif /* FILE_HISTORY_H */
@@ -4,6 +4,7 @@
 #ifdef HAVE_FSMONITOR_DAEMON_BACKEND
 
 #include "hashmap.h"
+#include "list.h"
 #include "thread-utils.h"
 #include "fsmonitor-path-utils.h"
 
@@ -51,6 +52,10 @@ struct fsmonitor_daemon_state {
 	int cookie_seq;
 	struct hashmap cookies;
 
+	struct hashmap stat_cache;
+	struct list_head stat_cache_lru;
+	uint64_t stat_cache_gen;
+
 	int listen_error_code;
 	int health_error_code;
 	struct fsm_listen_data *listen_data;
@@ -43,6 +43,12 @@ int fsmonitor_ipc__send_command(const char *command UNUSED,
 	return -1;
 }
 
+int fsmonitor_ipc__send_stat_request(const char *request UNUSED,
+				     struct strbuf *answer UNUSED)
+{
+	return -1;
+}
+
 #else
 
 int fsmonitor_ipc__is_supported(void)
@@ -173,4 +179,40 @@ int fsmonitor_ipc__send_command(const char *command,
 	return 0;
 }
 
+int fsmonitor_ipc__send_stat_request(const char *request,
+				     struct strbuf *answer)
+{
+	struct ipc_client_connection *connection = NULL;
+	struct ipc_client_connect_options options
+		= IPC_CLIENT_CONNECT_OPTIONS_INIT;
+	enum ipc_active_state state;
+	int ret;
+
+	strbuf_reset(answer);
+
+	options.wait_if_busy = 1;
+	options.wait_if_not_found = 0;
+
+	trace2_region_enter("fsm_client", "stat", NULL);
+
+	state = ipc_client_try_connect(fsmonitor_ipc__get_path(the_repository),
+				       &options, &connection);
+	if (state != IPC_STATE__LISTENING) {
+		ret = -1;
+		goto done;
+	}
+
+	ret = ipc_client_send_command_to_connection(connection, request,
+						    strlen(request), answer);
+	ipc_client_close_connection(connection);
+
+	trace2_data_intmax("fsm_client", NULL,
+			   "stat/response-length", answer->len);
+
+done:
+	trace2_region_leave("fsm_client", "stat", NULL);
+
+	return ret;
+}
+
 #endif
@@ -47,4 +47,15 @@ int fsmonitor_ipc__send_query(const char *since_token,
 int fsmonitor_ipc__send_command(const char *command,
 				struct strbuf *answer);
 
+/*
+ * Connect to a `git-fsmonitor--daemon` process via simple-ipc and
+ * send a "stat" request, which asks which of the given cache entries
+ * still match the worktree.  If no daemon is available, we DO NOT try
+ * to start one, nor do we die.
+ *
+ * Returns -1 on error; 0 on success.
+ */
+int fsmonitor_ipc__send_stat_request(const char *request,
+				     struct strbuf *answer);
+
 #endif /* FSMONITOR_IPC_H */
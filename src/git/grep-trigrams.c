@@ -0,0 +1,543 @@
+#include "git-compat-util.h"
+#include "grep-trigrams.h"
+#include "bloom.h"
+#include "chunk-format.h"
+#include "config.h"
+#include "csum-file.h"
+#include "gettext.h"
+#include "grep.h"
+#include "hash-lookup.h"
+#include "lockfile.h"
+#include "object-file.h"
+#include "object-store.h"
+#include "oid-array.h"
+#include "packfile.h"
+#include "path.h"
+#include "progress.h"
+#include "repository.h"
+#include "trace2.h"
+
+/*
+ * The file is a chunk file with the header that map_chunk_file() in
+ * chunk-format.h reads.  The chunks are:
+ *
+ *   OIDF: the usual 256-entry fanout of the sorted blob names
+ *   OIDL: the sorted blob names
+ *   TGIX: for each blob, the 64-bit offset in TGBF where its filter
+ *         ends; it starts where the filter of the previous blob ends
+ *   TGBF: the Bloom filters of all the blobs
+ *
+ * All integers are in network byte order.
+ */
+#define GTI_SIGNATURE 0x47545249 /* "GTRI" */
+#define GTI_VERSION 1
+
+#define GTI_CHUNKID_OIDFANOUT 0x4f494446 /* "OIDF" */
+#define GTI_CHUNKID_OIDLOOKUP 0x4f49444c /* "OIDL" */
+#define GTI_CHUNKID_INDEX 0x54474958 /* "TGIX" */
+#define GTI_CHUNKID_FILTERS 0x54474246 /* "TGBF" */
+
+#define GTI_INDEX_WIDTH 8
+
+/*
+ * The filters are never shared with the commit-graph, but use the same
+ * hash functions and the same number of bits per entry.
+ */
+static const struct bloom_filter_settings trigram_settings = {
+	.hash_version = 2,
+	.num_hashes = 7,
+	.bits_per_entry = 10,
+};
+
+struct grep_trigrams {
+	const unsigned char *data;
+	size_t data_len;
+	unsigned hash_len;
+
+	uint32_t num_blobs;
+	const uint32_t *chunk_oid_fanout;
+	const unsigned char *chunk_oid_lookup;
+	const unsigned char *chunk_index;
+	const unsigned char *chunk_filters;
+	size_t filters_len;
+};
+
+static char *grep_trigrams_filename(struct repository *r)
+{
+	return xstrfmt("%s/info/grep-trigrams", r->objects->odb->path);
+}
+
+static void free_grep_trigrams(struct grep_trigrams *gt)
+{
+	if (!gt)
+		return;
+	munmap((void *)gt->data, gt->data_len);
+	free(gt);
+}
+
+static struct grep_trigrams *load_grep_trigrams(struct repository *r,
+						const char *path)
+{
+	struct grep_trigrams *gt;
+	struct chunkfile *cf;
+	const unsigned char *data;
+	size_t data_len, chunk_size;
+
+	cf = map_chunk_file(r, path, "grep-trigrams", GTI_SIGNATURE,
+			    GTI_VERSION, &data, &data_len);
+	if (!cf)
+		return NULL;
+
+	CALLOC_ARRAY(gt, 1);
+	gt->data = data;
+	gt->data_len = data_len;
+	gt->hash_len = r->hash_algo->rawsz;
+
+	if (pair_oid_fanout_chunk(cf, GTI_CHUNKID_OIDFANOUT, "grep-trigrams",
+				  &gt->chunk_oid_fanout, &gt->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, GTI_CHUNKID_OIDLOOKUP, &gt->chunk_oid_lookup,
+		       &chunk_size) ||
+	    chunk_size != st_mult(gt->hash_len, gt->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, GTI_CHUNKID_INDEX, &gt->chunk_index,
+		       &chunk_size) ||
+	    chunk_size != st_mult(GTI_INDEX_WIDTH, gt->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, GTI_CHUNKID_FILTERS, &gt->chunk_filters,
+		       &gt->filters_len))
+		goto corrupt;
+
+	free_chunkfile(cf);
+	return gt;
+
+corrupt:
+	error(_("grep-trigrams file %s is corrupt"), path);
+	free_chunkfile(cf);
+	free_grep_trigrams(gt);
+	return NULL;
+}
+
+static struct grep_trigrams *prepare_grep_trigrams(struct repository *r)
+{
+	struct raw_object_store *o = r->objects;
+	int enabled = 1;
+	char *path;
+
+	if (o->grep_trigrams_attempted)
+		return o->grep_trigrams;
+	o->grep_trigrams_attempted = 1;
+
+	repo_config_get_bool(r, "grep.trigramindex", &enabled);
+	if (!enabled)
+		return NULL;
+
+	path = grep_trigrams_filename(r);
+	o->grep_trigrams = load_grep_trigrams(r, path);
+	free(path);
+	if (o->grep_trigrams)
+		trace2_data_intmax("grep", r, "trigrams/blobs",
+				   o->grep_trigrams->num_blobs);
+	return o->grep_trigrams;
+}
+
+void close_grep_trigrams(struct raw_object_store *o)
+{
+	free_grep_trigrams(o->grep_trigrams);
+	o->grep_trigrams = NULL;
+	o->grep_trigrams_attempted = 0;
+}
+
+/*
+ * Point 'filter' at the filter of 'oid', or return -1 if the index
+ * does not know the blob.  The filter of a blob without any trigram,
+ * i.e. one shorter than three bytes, is empty.
+ */
+static int find_filter(struct grep_trigrams *gt, const struct object_id *oid,
+		       struct bloom_filter *filter)
+{
+	uint64_t start = 0, end;
+	uint32_t pos;
+
+	if (!bsearch_hash(oid->hash, gt->chunk_oid_fanout,
+			  gt->chunk_oid_lookup, gt->hash_len, &pos))
+		return -1;
+
+	if (pos)
+		start = get_be64(gt->chunk_index + st_mult(GTI_INDEX_WIDTH,
+							   pos - 1));
+	end = get_be64(gt->chunk_index + st_mult(GTI_INDEX_WIDTH, pos));
+	if (end < start || end > gt->filters_len)
+		return -1;
+
+	memset(filter, 0, sizeof(*filter));
+	filter->data = (unsigned char *)gt->chunk_filters + start;
+	filter->len = end - start;
+	return 0;
+}
+
+static uint32_t trigram_at(const unsigned char *p)
+{
+	return ((uint32_t)tolower(p[0]) << 16) |
+	       ((uint32_t)tolower(p[1]) << 8) |
+	       (uint32_t)tolower(p[2]);
+}
+
+static void trigram_key(uint32_t trigram, struct bloom_key *key)
+{
+	char buf[3];
+
+	buf[0] = trigram >> 16;
+	buf[1] = trigram >> 8;
+	buf[2] = trigram;
+	fill_bloom_key(buf, sizeof(buf), key, &trigram_settings);
+}
+
+struct grep_trigram_query {
+	/*
+	 * For each pattern, the keys of the trigrams every match of it
+	 * contains; a blob may match if it has them all for any one
+	 * pattern.
+	 */
+	struct trigram_pattern {
+		struct bloom_key *keys;
+		size_t nr;
+	} *patterns;
+	size_t nr, alloc;
+};
+
+struct trigram_set {
+	uint32_t *v;
+	size_t nr, alloc;
+};
+
+static void add_trigrams(const char *lit, size_t len, void *data)
+{
+	struct trigram_set *set = data;
+	size_t i;
+
+	for (i = 0; i + 2 < len; i++) {
+		ALLOC_GROW(set->v, set->nr + 1, set->alloc);
+		set->v[set->nr++] = trigram_at((const unsigned char *)lit + i);
+	}
+}
+
+static int cmp_uint32(const void *a_, const void *b_)
+{
+	uint32_t a = *(const uint32_t *)a_;
+	uint32_t b = *(const uint32_t *)b_;
+
+	return a < b ? -1 : a > b;
+}
+
+struct grep_trigram_query *grep_trigram_query_new(const struct grep_opt *opt)
+{
+	struct grep_trigram_query *q;
+	struct trigram_set set = { 0 };
+	enum grep_pattern_type type = opt->pattern_type_option;
+	struct grep_pat *p;
+
+	if (!opt->pattern_list || opt->invert || opt->unmatch_name_only ||
+	    opt->allow_textconv || opt->all_match || opt->no_body_match ||
+	    opt->header_list)
+		return NULL;
+	if (type == GREP_PATTERN_TYPE_UNSPECIFIED)
+		type = opt->extended_regexp_option ? GREP_PATTERN_TYPE_ERE :
+						     GREP_PATTERN_TYPE_BRE;
+
+	CALLOC_ARRAY(q, 1);
+	for (p = opt->pattern_list; p; p = p->next) {
+		struct trigram_pattern *tp;
+		size_t i, j;
+
+		/* --and, --not and friends */
+		if (p->token != GREP_PATTERN)
+			goto cannot_tell;
+
+		set.nr = 0;
+		if (grep_pattern_literals(p->pattern, p->patternlen, type,
+					  opt->ignore_case, add_trigrams, &set) ||
+		    !set.nr)
+			goto cannot_tell;
+
+		QSORT(set.v, set.nr, cmp_uint32);
+		for (i = j = 1; i < set.nr; i++)
+			if (set.v[i] != set.v[j - 1])
+				set.v[j++] = set.v[i];
+		set.nr = j;
+
+		ALLOC_GROW(q->patterns, q->nr + 1, q->alloc);
+		tp = &q->patterns[q->nr++];
+		CALLOC_ARRAY(tp->keys, set.nr);
+		tp->nr = set.nr;
+		for (i = 0; i < set.nr; i++)
+			trigram_key(set.v[i], &tp->keys[i]);
+	}
+	free(set.v);
+	return q;
+
+cannot_tell:
+	free(set.v);
+	grep_trigram_query_free(q);
+	return NULL;
+}
+
+void grep_trigram_query_free(struct grep_trigram_query *q)
+{
+	size_t i, j;
+
+	if (!q)
+		return;
+	for (i = 0; i < q->nr; i++) {
+		for (j = 0; j < q->patterns[i].nr; j++)
+			clear_bloom_key(&q->patterns[i].keys[j]);
+		free(q->patterns[i].keys);
+	}
+	free(q->patterns);
+	free(q);
+}
+
+int grep_trigrams_may_match(struct repository *r,
+			    struct grep_trigram_query *q,
+			    const struct object_id *oid)
+{
+	struct grep_trigrams *gt = prepare_grep_trigrams(r);
+	struct bloom_filter filter;
+	size_t i, j;
+
+	if (!gt || find_filter(gt, oid, &filter))
+		return 1;
+
+	for (i = 0; i < q->nr; i++) {
+		struct trigram_pattern *tp = &q->patterns[i];
+
+		for (j = 0; j < tp->nr; j++)
+			if (bloom_filter_contains(&filter, &tp->keys[j],
+						  &trigram_settings) <= 0)
+				break;
+		if (j == tp->nr)
+			return 1;
+	}
+	return 0;
+}
+
+struct write_grep_trigrams_context {
+	struct repository *r;
+	struct grep_trigrams *old;
+	struct oid_array candidates;
+
+	/* the blobs that made it into the new index, in order */
+	struct oid_array blobs;
+	uint64_t *ends;
+	size_t ends_alloc;
+
+	/* the filters of all the blobs */
+	struct strbuf filters;
+
+	/* the distinct trigrams of the blob at hand, and a bit for each */
+	uint32_t *trigrams;
+	size_t trigrams_nr, trigrams_alloc;
+	unsigned char *seen;
+
+	struct progress *progress;
+};
+
+static int add_loose_candidate(const struct object_id *oid,
+			       const char *path UNUSED, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+	oid_array_append(&ctx->candidates, oid);
+	return 0;
+}
+
+static int add_packed_candidate(const struct object_id *oid,
+				struct packed_git *pack UNUSED,
+				uint32_t pos UNUSED, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+	oid_array_append(&ctx->candidates, oid);
+	return 0;
+}
+
+static void add_blob_filter(struct write_grep_trigrams_context *ctx,
+			    const unsigned char *buf, size_t size)
+{
+	struct bloom_filter filter = { 0 };
+	size_t i, start;
+
+	ctx->trigrams_nr = 0;
+	for (i = 0; i + 2 < size; i++) {
+		uint32_t t = trigram_at(buf + i);
+
+		if (ctx->seen[t / 8] & (1 << (t % 8)))
+			continue;
+		ctx->seen[t / 8] |= 1 << (t % 8);
+		ALLOC_GROW(ctx->trigrams, ctx->trigrams_nr + 1,
+			   ctx->trigrams_alloc);
+		ctx->trigrams[ctx->trigrams_nr++] = t;
+	}
+
+	filter.len = (st_mult(ctx->trigrams_nr,
+			      trigram_settings.bits_per_entry) +
+		      BITS_PER_WORD - 1) / BITS_PER_WORD;
+	start = ctx->filters.len;
+	strbuf_addchars(&ctx->filters, 0, filter.len);
+	filter.data = (unsigned char *)ctx->filters.buf + start;
+
+	for (i = 0; i < ctx->trigrams_nr; i++) {
+		uint32_t t = ctx->trigrams[i];
+		struct bloom_key key;
+
+		ctx->seen[t / 8] &= ~(1 << (t % 8));
+		trigram_key(t, &key);
+		add_key_to_filter(&key, &filter, &trigram_settings);
+		clear_bloom_key(&key);
+	}
+}
+
+static void add_blob(struct write_grep_trigrams_context *ctx,
+		     const struct object_id *oid)
+{
+	struct bloom_filter old_filter;
+	enum object_type type;
+	unsigned long size;
+
+	if (ctx->old && !find_filter(ctx->old, oid, &old_filter)) {
+		strbuf_add(&ctx->filters, old_filter.data, old_filter.len);
+	} else {
+		void *buf;
+
+		type = oid_object_info(ctx->r, oid, &size);
+		if (type != OBJ_BLOB ||
+		    size > repo_settings_get_big_file_threshold(ctx->r))
+			return;
+		buf = repo_read_object_file(ctx->r, oid, &type, &size);
+		if (!buf)
+			return;
+		add_blob_filter(ctx, buf, size);
+		free(buf);
+	}
+
+	ALLOC_GROW(ctx->ends, ctx->blobs.nr + 1, ctx->ends_alloc);
+	ctx->ends[ctx->blobs.nr] = ctx->filters.len;
+	oid_array_append(&ctx->blobs, oid);
+}
+
+static int write_gti_chunk_oid_fanout(struct hashfile *f, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+
+	write_oid_fanout_chunk(f, &ctx->blobs);
+	return 0;
+}
+
+static int write_gti_chunk_oid_lookup(struct hashfile *f, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->blobs.nr; i++)
+		hashwrite(f, ctx->blobs.oid[i].hash, ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_gti_chunk_index(struct hashfile *f, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->blobs.nr; i++)
+		hashwrite_be64(f, ctx->ends[i]);
+	return 0;
+}
+
+static int write_gti_chunk_filters(struct hashfile *f, void *data)
+{
+	struct write_grep_trigrams_context *ctx = data;
+
+	hashwrite(f, ctx->filters.buf, ctx->filters.len);
+	return 0;
+}
+
+int write_grep_trigrams(struct repository *r, unsigned flags)
+{
+	struct write_grep_trigrams_context ctx = {
+		.r = r,
+		.candidates = OID_ARRAY_INIT,
+		.blobs = OID_ARRAY_INIT,
+		.filters = STRBUF_INIT,
+	};
+	struct lock_file lk = LOCK_INIT;
+	struct chunkfile *cf;
+	struct hashfile *f;
+	char *path = grep_trigrams_filename(r);
+	size_t i;
+	int ret = 0;
+
+	if (safe_create_leading_directories(r, path)) {
+		ret = error(_("unable to create leading directories of %s"),
+			    path);
+		goto out;
+	}
+	ctx.old = load_grep_trigrams(r, path);
+
+	for_each_loose_object(add_loose_candidate, &ctx,
+			      FOR_EACH_OBJECT_LOCAL_ONLY);
+	for_each_packed_object(r, add_packed_candidate, &ctx,
+			       FOR_EACH_OBJECT_LOCAL_ONLY);
+	oid_array_sort(&ctx.candidates);
+
+	/* one bit for each of the 2^24 possible trigrams */
+	ctx.seen = xcalloc(1 << 21, 1);
+
+	if (flags & GREP_TRIGRAMS_PROGRESS)
+		ctx.progress = start_delayed_progress(r,
+					_("Indexing trigrams for grep"),
+					ctx.candidates.nr);
+	for (i = 0; i < ctx.candidates.nr; i++) {
+		display_progress(ctx.progress, i + 1);
+		if (i && oideq(&ctx.candidates.oid[i - 1],
+			       &ctx.candidates.oid[i]))
+			continue;
+		add_blob(&ctx, &ctx.candidates.oid[i]);
+	}
+	stop_progress(&ctx.progress);
+
+	f = hold_chunk_file(r, &lk, path);
+
+	cf = init_chunkfile(f);
+	add_chunk(cf, GTI_CHUNKID_OIDFANOUT, CHUNK_OID_FANOUT_SIZE,
+		  write_gti_chunk_oid_fanout);
+	add_chunk(cf, GTI_CHUNKID_OIDLOOKUP,
+		  st_mult(r->hash_algo->rawsz, ctx.blobs.nr),
+		  write_gti_chunk_oid_lookup);
+	add_chunk(cf, GTI_CHUNKID_INDEX,
+		  st_mult(GTI_INDEX_WIDTH, ctx.blobs.nr),
+		  write_gti_chunk_index);
+	add_chunk(cf, GTI_CHUNKID_FILTERS, ctx.filters.len,
+		  write_gti_chunk_filters);
+
+	write_chunk_file(cf, GTI_SIGNATURE, GTI_VERSION, r->hash_algo, &ctx);
+	free_chunkfile(cf);
+
+	/* let go of the old file before it is replaced */
+	free_grep_trigrams(ctx.old);
+	ctx.old = NULL;
+	close_grep_trigrams(r->objects);
+
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	if (commit_lock_file(&lk))
+		ret = error_errno(_("unable to write %s"), path);
+
+out:
+	free_grep_trigrams(ctx.old);
+	oid_array_clear(&ctx.candidates);
+	oid_array_clear(&ctx.blobs);
+	free(ctx.ends);
+	free(ctx.trigrams);
+	free(ctx.seen);
+	strbuf_release(&ctx.filters);
+	free(path);
+	return ret;
+}
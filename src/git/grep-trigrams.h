@@ -0,0 +1,50 @@
+#ifndef GREP_TRIGRAMS_H
+#define GREP_TRIGRAMS_H
+
+struct repository;
+struct raw_object_store;
+struct object_id;
+struct grep_opt;
+struct grep_trigram_query;
+
+/*
+ * The grep trigram index remembers, for the blobs of the repository,
+ * a Bloom filter of the (ASCII case-folded) three-byte sequences each
+ * of them contains.  A blob whose filter lacks a trigram that every
+ * match of the patterns must contain cannot match, and "git grep" over
+ * committed trees skips it without reading it.  The index lives in
+ * "$GIT_DIR/objects/info/grep-trigrams" and is written by the
+ * "grep-trigrams" task of git-maintenance(1).
+ */
+
+#define GREP_TRIGRAMS_PROGRESS (1 << 0)
+
+/*
+ * Write the index for every local blob, reusing what the existing
+ * index already knows.  Returns 0 on success and a negative value
+ * after reporting an error.
+ */
+int write_grep_trigrams(struct repository *r, unsigned flags);
+
+/*
+ * Work out which trigrams a blob has to contain to match the patterns
+ * of 'opt'.  Returns NULL when the index cannot tell, e.g. because a
+ * pattern has no literal part of three bytes or more, or because of
+ * options like --invert-match under which a blob without a match is
+ * still of interest.
+ */
+struct grep_trigram_query *grep_trigram_query_new(const struct grep_opt *opt);
+void grep_trigram_query_free(struct grep_trigram_query *q);
+
+/*
+ * Return 0 if the index of 'r' says that the blob 'oid' cannot match
+ * the query, and 1 if it may (which includes the blobs the index does
+ * not know).
+ */
+int grep_trigrams_may_match(struct repository *r,
+			    struct grep_trigram_query *q,
+			    const struct object_id *oid);
+
+void close_grep_trigrams(struct raw_object_store *o);
+
+#endif /* GREP_TRIGRAMS_H */
@@ -12,7 +12,9 @@
 #include "diff.h"
 #include "diffcore.h"
 #include "quote.h"
+#include "string-list.h"
 #include "help.h"
+#include "kwset.h"
 
 static int grep_source_load(struct grep_source *gs);
 static int grep_source_is_binary(struct grep_source *gs,
@@ -244,6 +246,256 @@ static int is_fixed(const char *s, size_t len)
 	return 1;
 }
 
+/*
+ * With --ignore-case, the regex engines may let an ASCII letter match
+ * a non-ASCII character (e.g. "k" the Kelvin sign, or "i" the dotted
+ * capital I of Turkish); such bytes end a literal.
+ */
+static int icase_literal(unsigned char c)
+{
+	return c && !(c & 0x80) && !strchr("iks", tolower(c));
+}
+
+static void flush_literal(struct strbuf *run, grep_literal_fn fn, void *data)
+{
+	if (run->len)
+		fn(run->buf, run->len, data);
+	strbuf_reset(run);
+}
+
+static int is_quantifier(const char *p, const char *end)
+{
+	if (p < end && *p && strchr("*?{", *p))
+		return 1;
+	return p + 1 < end && *p == '\\' && p[1] && strchr("?{", p[1]);
+}
+
+static const char *skip_bracket(const char *p, const char *end, int pcre)
+{
+	p++;
+	if (p < end && *p == '^')
+		p++;
+	if (p < end && *p == ']')
+		p++;
+	while (p < end && *p != ']') {
+		if (pcre && *p == '\\') {
+			if (p + 1 >= end)
+				return NULL;
+			p += 2;
+		} else if (*p == '[' && p + 1 < end && p[1] &&
+			   strchr(":.=", p[1])) {
+			char close = p[1];
+
+			for (p += 2; p + 1 < end; p++)
+				if (p[0] == close && p[1] == ']')
+					break;
+			if (p + 1 >= end)
+				return NULL;
+			p += 2;
+		} else {
+			p++;
+		}
+	}
+	return p < end ? p + 1 : NULL;
+}
+
+/*
+ * Skip the rest of an interval like "{2,3}" (or "\{2,3\}" in a basic
+ * regular expression).  Where the braces are literal instead, they and
+ * what is between them are merely not taken as required.
+ */
+static const char *skip_interval(const char *p, const char *end, int escaped)
+{
+	for (; p < end; p++) {
+		if (!escaped && *p == '}')
+			return p + 1;
+		if (escaped && *p == '\\' && p + 1 < end && p[1] == '}')
+			return p + 2;
+	}
+	return end;
+}
+
+/*
+ * Skip the rest of a group, "(...)" or "\(...\)", whatever alternations
+ * it has inside.  Returns NULL if the group is not closed.
+ */
+static const char *skip_group(const char *p, const char *end,
+			      int escaped, int pcre)
+{
+	int depth = 1;
+
+	while (p < end) {
+		if (*p == '\\') {
+			if (p + 1 >= end)
+				return NULL;
+			if (escaped && p[1] == '(')
+				depth++;
+			else if (escaped && p[1] == ')' && !--depth)
+				return p + 2;
+			p += 2;
+		} else if (*p == '[') {
+			p = skip_bracket(p, end, pcre);
+			if (!p)
+				return NULL;
+		} else {
+			if (!escaped && *p == '(')
+				depth++;
+			else if (!escaped && *p == ')' && !--depth)
+				return p + 1;
+			p++;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Whatever is not obviously a required literal byte ends the current
+ * run, so that this can get away with treating the basic, extended
+ * and Perl syntaxes alike: "\(" opens a group and "{" an interval in
+ * each of them, which is merely conservative where they are literal.
+ */
+static int regex_literals(const char *p, size_t len, int pcre, int icase,
+			  grep_literal_fn fn, void *data)
+{
+	const char *end = p + len;
+	struct strbuf run = STRBUF_INIT;
+	int ret = 0;
+
+	while (p < end) {
+		unsigned char c = *p;
+		const char *next = p + 1;
+
+		switch (c) {
+		case '\\':
+			if (next == end) {
+				ret = -1;
+				goto out;
+			}
+			c = *next++;
+			if (c == '|') {
+				ret = -1;
+				goto out;
+			}
+			if (c == '(' || c == '{') {
+				next = c == '(' ? skip_group(next, end, 1, pcre) :
+						  skip_interval(next, end, 1);
+				if (!next) {
+					ret = -1;
+					goto out;
+				}
+				flush_literal(&run, fn, data);
+				p = next;
+				continue;
+			}
+			if (isalnum(c)) {
+				/*
+				 * Word boundaries and character classes
+				 * are fine, but PCRE has escapes with
+				 * arguments (e.g. "\x41") whose
+				 * characters must not be taken as
+				 * literals, and \Q...\E quoting.
+				 */
+				if (pcre && !strchr("bBdDsSwWAzZGhHvVRK", c)) {
+					ret = -1;
+					goto out;
+				}
+				flush_literal(&run, fn, data);
+				p = next;
+				continue;
+			}
+			if (!c || strchr("<>`')}?+", c)) {
+				flush_literal(&run, fn, data);
+				p = next;
+				continue;
+			}
+			break;
+		case '[':
+			next = skip_bracket(p, end, pcre);
+			if (!next) {
+				ret = -1;
+				goto out;
+			}
+			flush_literal(&run, fn, data);
+			p = next;
+			continue;
+		case '(':
+			/* options like "(?i)" change what follows */
+			if (pcre && next < end && (*next == '?' || *next == '*')) {
+				ret = -1;
+				goto out;
+			}
+			next = skip_group(next, end, 0, pcre);
+			if (!next) {
+				ret = -1;
+				goto out;
+			}
+			flush_literal(&run, fn, data);
+			p = next;
+			continue;
+		case '{':
+			next = skip_interval(next, end, 0);
+			flush_literal(&run, fn, data);
+			p = next;
+			continue;
+		case '|':
+			ret = -1;
+			goto out;
+		case '.':
+		case '^':
+		case '$':
+		case '*':
+		case '?':
+		case '+':
+		case ')':
+		case '}':
+		case '\0':
+			flush_literal(&run, fn, data);
+			p = next;
+			continue;
+		}
+
+		if (icase && !icase_literal(c)) {
+			flush_literal(&run, fn, data);
+		} else if (is_quantifier(next, end)) {
+			/* a multi-byte character is repeated as a whole */
+			if (c & 0x80)
+				while (run.len && (run.buf[run.len - 1] & 0x80))
+					strbuf_setlen(&run, run.len - 1);
+			flush_literal(&run, fn, data);
+		} else {
+			strbuf_addch(&run, c);
+		}
+		p = next;
+	}
+	flush_literal(&run, fn, data);
+
+out:
+	strbuf_release(&run);
+	return ret;
+}
+
+int grep_pattern_literals(const char *pat, size_t len,
+			  enum grep_pattern_type type, int ignore_case,
+			  grep_literal_fn fn, void *data)
+{
+	struct strbuf run = STRBUF_INIT;
+	size_t i;
+
+	if (type != GREP_PATTERN_TYPE_FIXED)
+		return regex_literals(pat, len, type == GREP_PATTERN_TYPE_PCRE,
+				      ignore_case, fn, data);
+
+	for (i = 0; i < len; i++) {
+		if (!pat[i] || (ignore_case && !icase_literal(pat[i])))
+			flush_literal(&run, fn, data);
+		else
+			strbuf_addch(&run, pat[i]);
+	}
+	flush_literal(&run, fn, data);
+	strbuf_release(&run);
+	return 0;
+}
+
 #ifdef USE_LIBPCRE2
 #define GREP_PCRE2_DEBUG_MALLOC 0
 
@@ -767,7 +1019,89 @@ static struct grep_expr *grep_splice_or(struct grep_expr *x, struct grep_expr *y
 	return z;
 }
 
-void compile_grep_patterns(struct grep_opt *opt)
+static void longest_literal(const char *lit, size_t len, void *data)
+{
+	struct strbuf *longest = data;
+
+	if (len > longest->len) {
+		strbuf_reset(longest);
+		strbuf_add(longest, lit, len);
+	}
+}
+
+/*
+ * Add to 'out' literals one of which every line matching 'x' contains,
+ * or return -1 if there is no telling.
+ */
+static int expr_literals(struct grep_opt *opt, struct grep_expr *x,
+			 struct string_list *out)
+{
+	struct strbuf longest = STRBUF_INIT;
+	struct grep_pat *p;
+	size_t nr = out->nr;
+	int ret = 0;
+
+	switch (x->node) {
+	case GREP_NODE_ATOM:
+		p = x->u.atom;
+		if (grep_pattern_literals(p->pattern, p->patternlen,
+					  p->fixed ? GREP_PATTERN_TYPE_FIXED :
+						     opt->pattern_type_option,
+					  p->ignore_case, longest_literal,
+					  &longest) || !longest.len)
+			ret = -1;
+		else
+			string_list_append(out, longest.buf);
+		strbuf_release(&longest);
+		return ret;
+	case GREP_NODE_AND:
+		/* either side will do */
+		if (!expr_literals(opt, x->u.binary.left, out))
+			return 0;
+		while (out->nr > nr)
+			free(out->items[--out->nr].string);
+		return expr_literals(opt, x->u.binary.right, out);
+	case GREP_NODE_OR:
+		if (expr_literals(opt, x->u.binary.left, out))
+			return -1;
+		return expr_literals(opt, x->u.binary.right, out);
+	default:
+		return -1;
+	}
+}
+
+static void compile_prefilter(struct grep_opt *opt)
+{
+	struct string_list literals = STRING_LIST_INIT_DUP;
+	struct grep_expr atom = { .node = GREP_NODE_ATOM };
+	struct grep_pat *p;
+	size_t i;
+
+	if (opt->pattern_expression) {
+		if (expr_literals(opt, opt->pattern_expression, &literals))
+			goto out;
+	} else {
+		for (p = opt->pattern_list; p; p = p->next) {
+			atom.u.atom = p;
+			if (p->token != GREP_PATTERN ||
+			    expr_literals(opt, &atom, &literals))
+				goto out;
+		}
+	}
+	if (!literals.nr)
+		goto out;
+
+	opt->prefilter = kwsalloc(opt->ignore_case ? tolower_trans_tbl : NULL);
+	for (i = 0; i < literals.nr; i++)
+		kwsincr(opt->prefilter, literals.items[i].string,
+			strlen(literals.items[i].string));
+	kwsprep(opt->prefilter);
+
+out:
+	string_list_clear(&literals, 0);
+}
+
+static void compile_grep_patterns_1(struct grep_opt *opt)
 {
 	struct grep_pat *p;
 	struct grep_expr *header_expr = prep_header_patterns(opt);
@@ -814,6 +1148,12 @@ void compile_grep_patterns(struct grep_opt *opt)
 	opt->all_match = 1;
 }
 
+void compile_grep_patterns(struct grep_opt *opt)
+{
+	compile_grep_patterns_1(opt);
+	compile_prefilter(opt);
+}
+
 static void free_pattern_expr(struct grep_expr *x)
 {
 	switch (x->node) {
@@ -862,6 +1202,10 @@ void free_grep_patterns(struct grep_opt *opt)
 
 	if (opt->pattern_expression)
 		free_pattern_expr(opt->pattern_expression);
+	if (opt->prefilter) {
+		kwsfree(opt->prefilter);
+		opt->prefilter = NULL;
+	}
 }
 
 static const char *end_of_line(const char *cp, unsigned long *left)
@@ -1441,17 +1785,26 @@ static int should_lookahead(struct grep_opt *opt)
 {
 	struct grep_pat *p;
 
-	if (opt->pattern_expression)
-		return 0; /* punt for too complex stuff */
 	if (opt->invert)
 		return 0;
+	if (opt->header_list)
+		return 0; /* lines of the header and the body differ */
 	for (p = opt->pattern_list; p; p = p->next) {
-		if (p->token != GREP_PATTERN)
+		if (p->token == GREP_PATTERN_HEAD ||
+		    p->token == GREP_PATTERN_BODY)
 			return 0; /* punt for "header only" and stuff */
 	}
+	if (opt->pattern_expression)
+		return !!opt->prefilter; /* only its literals can tell */
 	return 1;
 }
 
+/*
+ * Skip to the beginning of the line that has the next match of any
+ * of the patterns.  For an expression of patterns, skip to the next
+ * line that has one of the literals that every matching line
+ * contains instead.
+ */
 static int look_ahead(struct grep_opt *opt,
 		      unsigned long *left_p,
 		      unsigned *lno_p,
@@ -1461,34 +1814,54 @@ static int look_ahead(struct grep_opt *opt,
 	const char *bol = *bol_p;
 	struct grep_pat *p;
 	const char *sp, *last_bol;
-	regoff_t earliest = -1;
+	const char *earliest = NULL;
 
-	for (p = opt->pattern_list; p; p = p->next) {
+	if (opt->pattern_expression) {
+		size_t offset = kwsexec(opt->prefilter, bol, *left_p, NULL);
+
+		if (offset != (size_t)-1)
+			earliest = bol + offset;
+	}
+
+	for (p = opt->pattern_expression ? NULL : opt->pattern_list;
+	     p; p = p->next) {
 		int hit;
 		regmatch_t m;
 
-		hit = patmatch(p, bol, bol + *left_p, &m, 0);
-		if (hit < 0)
-			return -1;
-		if (!hit || m.rm_so < 0 || m.rm_eo < 0)
+		/*
+		 * A match found further down the buffer for an earlier
+		 * line is still the next one, and a pattern that did
+		 * not match the rest of the buffer then does not match
+		 * what is left of it now; searching again for each hit
+		 * of another pattern would be quadratic.
+		 */
+		if (p->no_next_match)
 			continue;
-		if (earliest < 0 || m.rm_so < earliest)
-			earliest = m.rm_so;
+		if (!p->next_match || p->next_match < bol) {
+			hit = patmatch(p, bol, bol + *left_p, &m, 0);
+			if (hit < 0)
+				return -1;
+			if (!hit || m.rm_so < 0 || m.rm_eo < 0) {
+				p->no_next_match = 1;
+				continue;
+			}
+			p->next_match = bol + m.rm_so;
+		}
+		if (!earliest || p->next_match < earliest)
+			earliest = p->next_match;
 	}
 
-	if (earliest < 0) {
+	if (!earliest) {
 		*bol_p = bol + *left_p;
 		*left_p = 0;
 		return 1;
 	}
-	for (sp = bol + earliest; bol < sp && sp[-1] != '\n'; sp--)
+	for (sp = earliest; bol < sp && sp[-1] != '\n'; sp--)
 		; /* find the beginning of the line */
 	last_bol = sp;
 
-	for (sp = bol; sp < last_bol; sp++) {
-		if (*sp == '\n')
-			lno++;
-	}
+	for (sp = bol; (sp = memchr(sp, '\n', last_bol - sp)); sp++)
+		lno++;
 	*left_p -= last_bol - bol;
 	*bol_p = last_bol;
 	*lno_p = lno;
@@ -1576,6 +1949,7 @@ static int grep_source_1(struct grep_opt *opt, struct grep_source *gs, int colle
 	struct userdiff_driver *textconv = NULL;
 	enum grep_context ctx = GREP_CONTEXT_HEAD;
 	xdemitconf_t xecfg;
+	struct grep_pat *p;
 
 	if (!opt->status_only && gs->name == NULL)
 		BUG("grep call which could print a name requires "
@@ -1640,12 +2014,25 @@ static int grep_source_1(struct grep_opt *opt, struct grep_source *gs, int colle
 	opt->priv = &xecfg;
 
 	try_lookahead = should_lookahead(opt);
+	for (p = opt->pattern_list; p; p = p->next) {
+		p->next_match = NULL;
+		p->no_next_match = 0;
+	}
 
 	if (fill_textconv_grep(opt->repo, textconv, gs) < 0)
 		return 0;
 
 	bol = gs->buf;
 	left = gs->size;
+
+	/*
+	 * Without any of the literals that every match contains, no line
+	 * can match; there is no need to even split the buffer into lines.
+	 */
+	if (opt->prefilter && !opt->invert &&
+	    kwsexec(opt->prefilter, bol, left, NULL) == (size_t)-1)
+		left = 0;
+
 	while (left) {
 		const char *eol;
 		int hit;
@@ -27,6 +27,7 @@ typedef int pcre2_general_context;
 #include "userdiff.h"
 
 struct repository;
+struct kwset_t;
 
 enum grep_pat_token {
 	GREP_PATTERN,
@@ -86,6 +87,13 @@ struct grep_pat {
 	unsigned is_fixed:1;
 	unsigned ignore_case:1;
 	unsigned word_regexp:1;
+
+	/*
+	 * Where look_ahead() found the next match of this pattern in the
+	 * buffer at hand, or that there is none.
+	 */
+	const char *next_match;
+	unsigned no_next_match:1;
 };
 
 enum grep_expr_node {
@@ -124,6 +132,12 @@ struct grep_opt {
 	struct grep_pat **header_tail;
 	struct grep_expr *pattern_expression;
 
+	/*
+	 * Literals one of which every line that matches contains; a
+	 * buffer without any of them is not looked at line by line.
+	 */
+	struct kwset_t *prefilter;
+
 	/*
 	 * NEEDSWORK: See if we can remove this field, because the repository
 	 * should probably be per-source. That is, grep.c functions using this
@@ -211,6 +225,21 @@ void append_grep_pat(struct grep_opt *opt, const char *pat, size_t patlen, const
 void append_grep_pattern(struct grep_opt *opt, const char *pat, const char *origin, int no, enum grep_pat_token t);
 void append_header_grep_pattern(struct grep_opt *, enum grep_header_field, const char *);
 void compile_grep_patterns(struct grep_opt *opt);
+
+/*
+ * Call 'fn' with each run of bytes that every match of the pattern
+ * 'pat' contains, as written in the pattern.  With 'ignore_case', the
+ * runs contain only bytes whose case-insensitive matches are the two
+ * ASCII cases of it.  The runs are found conservatively and may well
+ * miss literals that a smarter look at the pattern would find.
+ * Returns -1 when the pattern has constructs (e.g. an alternation at
+ * the top level) that may allow a match without the runs reported so
+ * far, and 0 otherwise.
+ */
+typedef void (*grep_literal_fn)(const char *lit, size_t len, void *data);
+int grep_pattern_literals(const char *pat, size_t len,
+			  enum grep_pattern_type type, int ignore_case,
+			  grep_literal_fn fn, void *data);
 void free_grep_patterns(struct grep_opt *opt);
 int grep_buffer(struct grep_opt *opt, const char *buf, unsigned long size);
 
@@ -83,6 +83,12 @@ struct ll_merge_options {
 
 	/* Extra xpparam_t flags as defined in xdiff/xdiff.h. */
 	long xdl_opts;
+
+	/*
+	 * The arena for xdiff to use, for callers merging from several
+	 * threads; defaults to xdiff_arena().
+	 */
+	xdlarena_t *xdl_arena;
 };
 
 #define LL_MERGE_OPTIONS_INIT { .conflict_style = -1 }
@@ -108,6 +114,38 @@ enum ll_merge_result ll_merge(mmbuffer_t *result_buf,
 	     struct index_state *istate,
 	     const struct ll_merge_options *opts);
 
+/*
+ * What ll_merge_prepare() found out about how to merge a path.
+ */
+struct ll_merge_prepared {
+	const struct ll_merge_driver *driver;
+	int marker_size;
+};
+
+/**
+ * Look up how `ll_merge()` would merge `path`, for a caller that wants
+ * to do the merge itself with `ll_merge_prepared()` in another thread,
+ * where the attributes cannot be looked at.  Returns -1 if the merge
+ * cannot be done that way, because it renormalizes or runs an external
+ * merge driver.
+ */
+int ll_merge_prepare(struct ll_merge_prepared *prep,
+		     struct index_state *istate, const char *path,
+		     const struct ll_merge_options *opts);
+
+/**
+ * Like `ll_merge()`, for a path prepared with `ll_merge_prepare()` and
+ * the same options.  Safe to call from several threads at once, each
+ * with its own `opts->xdl_arena`.
+ */
+enum ll_merge_result ll_merge_prepared(const struct ll_merge_prepared *prep,
+				       mmbuffer_t *result_buf,
+				       const char *path,
+				       mmfile_t *ancestor, const char *ancestor_label,
+				       mmfile_t *ours, const char *our_label,
+				       mmfile_t *theirs, const char *their_label,
+				       const struct ll_merge_options *opts);
+
 int ll_merge_marker_size(struct index_state *istate, const char *path);
 void reset_merge_attributes(void);
 
@@ -23,6 +23,7 @@
 #include "alloc.h"
 #include "advice.h"
 #include "attr.h"
+#include "bulk-checkin.h"
 #include "cache-tree.h"
 #include "commit.h"
 #include "commit-reach.h"
@@ -48,6 +49,7 @@
 #include "revision.h"
 #include "sparse-index.h"
 #include "strmap.h"
+#include "thread-utils.h"
 #include "trace2.h"
 #include "tree.h"
 #include "unpack-trees.h"
@@ -403,6 +405,16 @@ struct merge_options_internal {
 	/* call_depth: recursion level counter for merging merge bases */
 	int call_depth;
 
+	/*
+	 * premerged: content merges done ahead of process_entry()
+	 *
+	 * A map of pathnames to struct premerged_content, filled by
+	 * premerge_contents() while process_entries() runs and NULL
+	 * otherwise.  merge_3way() takes its result from here when the
+	 * merge it is asked for was already done.
+	 */
+	struct strmap *premerged;
+
 	/* field that holds submodule conflict information */
 	struct string_list conflicted_submodules;
 };
@@ -2048,63 +2060,123 @@ static void initialize_attr_index(struct merge_options *opt)
 	}
 }
 
-static int merge_3way(struct merge_options *opt,
-		      const char *path,
-		      const struct object_id *o,
-		      const struct object_id *a,
-		      const struct object_id *b,
-		      const char *pathnames[3],
-		      const int extra_marker_size,
-		      mmbuffer_t *result_buf)
+static void init_ll_merge_options(struct merge_options *opt,
+				  const int extra_marker_size,
+				  struct ll_merge_options *ll_opts)
 {
-	mmfile_t orig, src1, src2;
-	struct ll_merge_options ll_opts = LL_MERGE_OPTIONS_INIT;
-	char *base, *name1, *name2;
-	enum ll_merge_result merge_status;
-
-	if (!opt->priv->attr_index.initialized)
-		initialize_attr_index(opt);
-
-	ll_opts.renormalize = opt->renormalize;
-	ll_opts.extra_marker_size = extra_marker_size;
-	ll_opts.xdl_opts = opt->xdl_opts;
-	ll_opts.conflict_style = opt->conflict_style;
+	ll_opts->renormalize = opt->renormalize;
+	ll_opts->extra_marker_size = extra_marker_size;
+	ll_opts->xdl_opts = opt->xdl_opts;
+	ll_opts->conflict_style = opt->conflict_style;
 
 	if (opt->priv->call_depth) {
-		ll_opts.virtual_ancestor = 1;
-		ll_opts.variant = 0;
+		ll_opts->virtual_ancestor = 1;
+		ll_opts->variant = 0;
 	} else {
 		switch (opt->recursive_variant) {
 		case MERGE_VARIANT_OURS:
-			ll_opts.variant = XDL_MERGE_FAVOR_OURS;
+			ll_opts->variant = XDL_MERGE_FAVOR_OURS;
 			break;
 		case MERGE_VARIANT_THEIRS:
-			ll_opts.variant = XDL_MERGE_FAVOR_THEIRS;
+			ll_opts->variant = XDL_MERGE_FAVOR_THEIRS;
 			break;
 		default:
-			ll_opts.variant = 0;
+			ll_opts->variant = 0;
 			break;
 		}
 	}
+}
 
+static void get_merge_labels(struct merge_options *opt,
+			     const char *pathnames[3],
+			     char **base, char **name1, char **name2)
+{
 	assert(pathnames[0] && pathnames[1] && pathnames[2] && opt->ancestor);
 	if (pathnames[0] == pathnames[1] && pathnames[1] == pathnames[2]) {
-		base  = mkpathdup("%s", opt->ancestor);
-		name1 = mkpathdup("%s", opt->branch1);
-		name2 = mkpathdup("%s", opt->branch2);
+		*base  = mkpathdup("%s", opt->ancestor);
+		*name1 = mkpathdup("%s", opt->branch1);
+		*name2 = mkpathdup("%s", opt->branch2);
 	} else {
-		base  = mkpathdup("%s:%s", opt->ancestor, pathnames[0]);
-		name1 = mkpathdup("%s:%s", opt->branch1,  pathnames[1]);
-		name2 = mkpathdup("%s:%s", opt->branch2,  pathnames[2]);
+		*base  = mkpathdup("%s:%s", opt->ancestor, pathnames[0]);
+		*name1 = mkpathdup("%s:%s", opt->branch1,  pathnames[1]);
+		*name2 = mkpathdup("%s:%s", opt->branch2,  pathnames[2]);
 	}
+}
+
+struct premerged_content {
+	const char *path;
+	struct object_id o, a, b;
+	int extra_marker_size;
+	struct ll_merge_options ll_opts;
+	struct ll_merge_prepared prep;
+	char *base, *name1, *name2;
 
-	read_mmblob(&orig, o);
-	read_mmblob(&src1, a);
-	read_mmblob(&src2, b);
+	mmbuffer_t result;
+	enum ll_merge_result status;
+};
 
-	merge_status = ll_merge(result_buf, path, &orig, base,
-				&src1, name1, &src2, name2,
-				&opt->priv->attr_index, &ll_opts);
+/*
+ * Take the result of the content merge of 'path' if premerge_contents()
+ * already did it, returning 0 if it did not.
+ */
+static int take_premerged(struct merge_options *opt,
+			  const char *path,
+			  const struct object_id *o,
+			  const struct object_id *a,
+			  const struct object_id *b,
+			  const int extra_marker_size,
+			  mmbuffer_t *result_buf,
+			  enum ll_merge_result *merge_status)
+{
+	struct premerged_content *pm;
+
+	if (!opt->priv->premerged)
+		return 0;
+	pm = strmap_get(opt->priv->premerged, path);
+	if (!pm || !pm->result.ptr ||
+	    !oideq(&pm->o, o) || !oideq(&pm->a, a) || !oideq(&pm->b, b) ||
+	    pm->extra_marker_size != extra_marker_size)
+		return 0;
+
+	*result_buf = pm->result;
+	*merge_status = pm->status;
+	pm->result.ptr = NULL;
+	return 1;
+}
+
+static int merge_3way(struct merge_options *opt,
+		      const char *path,
+		      const struct object_id *o,
+		      const struct object_id *a,
+		      const struct object_id *b,
+		      const char *pathnames[3],
+		      const int extra_marker_size,
+		      mmbuffer_t *result_buf)
+{
+	mmfile_t orig, src1, src2;
+	struct ll_merge_options ll_opts = LL_MERGE_OPTIONS_INIT;
+	char *base, *name1, *name2;
+	enum ll_merge_result merge_status;
+
+	if (!opt->priv->attr_index.initialized)
+		initialize_attr_index(opt);
+
+	init_ll_merge_options(opt, extra_marker_size, &ll_opts);
+	get_merge_labels(opt, pathnames, &base, &name1, &name2);
+
+	if (!take_premerged(opt, path, o, a, b, extra_marker_size,
+			    result_buf, &merge_status)) {
+		read_mmblob(&orig, o);
+		read_mmblob(&src1, a);
+		read_mmblob(&src2, b);
+
+		merge_status = ll_merge(result_buf, path, &orig, base,
+					&src1, name1, &src2, name2,
+					&opt->priv->attr_index, &ll_opts);
+		free(orig.ptr);
+		free(src1.ptr);
+		free(src2.ptr);
+	}
 	if (merge_status == LL_MERGE_BINARY_CONFLICT)
 		path_msg(opt, CONFLICT_BINARY, 0,
 			 path, NULL, NULL, NULL,
@@ -2114,9 +2186,6 @@ static int merge_3way(struct merge_options *opt,
 	free(base);
 	free(name1);
 	free(name2);
-	free(orig.ptr);
-	free(src1.ptr);
-	free(src2.ptr);
 	return merge_status;
 }
 
@@ -4395,6 +4464,205 @@ static void prefetch_for_content_merges(struct merge_options *opt,
 	oid_array_clear(&to_fetch);
 }
 
+/*
+ * Whether the entry needs a content merge of two regular files that
+ * process_entry() will hand to merge_3way() without first changing the
+ * entry, and that ll_merge_prepared() can do in another thread.
+ */
+static int can_premerge(struct merge_options *opt,
+			const char *path,
+			struct conflict_info *ci,
+			struct premerged_content *pm)
+{
+	struct version_info *o = &ci->stages[0];
+	struct version_info *a = &ci->stages[1];
+	struct version_info *b = &ci->stages[2];
+	int two_way;
+
+	if (ci->merged.clean || ci->match_mask || ci->dirmask ||
+	    ci->df_conflict || ci->filemask < 6 ||
+	    !S_ISREG(a->mode) || !S_ISREG(b->mode) ||
+	    oideq(&a->oid, &b->oid) ||
+	    oideq(&a->oid, &o->oid) || oideq(&b->oid, &o->oid))
+		return 0;
+
+	two_way = ((S_IFMT & o->mode) != (S_IFMT & a->mode));
+	oidcpy(&pm->o, two_way ? null_oid(the_hash_algo) : &o->oid);
+	oidcpy(&pm->a, &a->oid);
+	oidcpy(&pm->b, &b->oid);
+	pm->path = path;
+	pm->extra_marker_size = opt->priv->call_depth * 2;
+	pm->ll_opts = (struct ll_merge_options)LL_MERGE_OPTIONS_INIT;
+	init_ll_merge_options(opt, pm->extra_marker_size, &pm->ll_opts);
+	return !ll_merge_prepare(&pm->prep, &opt->priv->attr_index, path,
+				 &pm->ll_opts);
+}
+
+/*
+ * Read a blob for premerge_thread().  Unlike read_mmblob(), do not die,
+ * fetch or complain: return -1 for anything that is not a text blob that
+ * the built-in drivers can merge silently (missing, not a blob, binary
+ * or too big), and leave the merge and its messages to the main thread.
+ */
+static int read_premerge_blob(mmfile_t *mm, const struct object_id *oid)
+{
+	enum object_type type;
+	unsigned long size;
+	void *buf = NULL;
+	struct object_info oi = {
+		.typep = &type,
+		.sizep = &size,
+		.contentp = &buf,
+	};
+
+	if (is_null_oid(oid)) {
+		mm->ptr = xstrdup("");
+		mm->size = 0;
+		return 0;
+	}
+	if (oid_object_info_extended(the_repository, oid, &oi,
+				     OBJECT_INFO_LOOKUP_REPLACE |
+				     OBJECT_INFO_SKIP_FETCH_OBJECT) < 0 ||
+	    type != OBJ_BLOB || size > MAX_XDIFF_SIZE ||
+	    buffer_is_binary(buf, size)) {
+		free(buf);
+		mm->ptr = NULL;
+		return -1;
+	}
+	mm->ptr = buf;
+	mm->size = size;
+	return 0;
+}
+
+struct premerge_todo {
+	struct premerged_content *items;
+	int nr, alloc, next;
+	pthread_mutex_t mutex;
+};
+
+static void *premerge_thread(void *data)
+{
+	struct premerge_todo *todo = data;
+	xdlarena_t *arena = xdl_arena_new();
+
+	for (;;) {
+		struct premerged_content *pm;
+		mmfile_t orig, src1, src2;
+
+		pthread_mutex_lock(&todo->mutex);
+		pm = todo->next < todo->nr ? &todo->items[todo->next++] : NULL;
+		pthread_mutex_unlock(&todo->mutex);
+		if (!pm)
+			break;
+
+		src1.ptr = src2.ptr = NULL;
+		if (!read_premerge_blob(&orig, &pm->o) &&
+		    !read_premerge_blob(&src1, &pm->a) &&
+		    !read_premerge_blob(&src2, &pm->b)) {
+			pm->ll_opts.xdl_arena = arena;
+			pm->status = ll_merge_prepared(&pm->prep, &pm->result,
+						       pm->path,
+						       &orig, pm->base,
+						       &src1, pm->name1,
+						       &src2, pm->name2,
+						       &pm->ll_opts);
+		}
+		free(orig.ptr);
+		free(src1.ptr);
+		free(src2.ptr);
+	}
+
+	xdl_arena_free(arena);
+	return NULL;
+}
+
+/*
+ * Do the content merges process_entries() is going to need in several
+ * threads, leaving their results in opt->priv->premerged.  Which entries
+ * need one is known upfront, and they are independent of each other.
+ *
+ * The threads only take on merges that cannot print anything, so that
+ * the output does not depend on how they were scheduled; the others are
+ * left to process_entry(), which does them in path order as usual.
+ */
+static void premerge_contents(struct merge_options *opt,
+			      struct string_list *plist,
+			      struct premerge_todo *todo)
+{
+	struct string_list_item *e;
+	int nr_threads = opt->threads;
+	int had_obj_read_lock = obj_read_use_lock;
+	pthread_t *threads;
+	int i;
+
+	if (!HAVE_THREADS || nr_threads < 2)
+		return;
+
+	if (!opt->priv->attr_index.initialized)
+		initialize_attr_index(opt);
+	for (e = &plist->items[plist->nr-1]; e >= plist->items; --e) {
+		struct premerged_content *pm;
+
+		ALLOC_GROW(todo->items, todo->nr + 1, todo->alloc);
+		pm = &todo->items[todo->nr];
+		memset(pm, 0, sizeof(*pm));
+		if (!can_premerge(opt, e->string, e->util, pm))
+			continue;
+		get_merge_labels(opt, ((struct conflict_info *)e->util)->pathnames,
+				 &pm->base, &pm->name1, &pm->name2);
+		todo->nr++;
+	}
+	if (todo->nr < 2)
+		return;
+	if (nr_threads > todo->nr)
+		nr_threads = todo->nr;
+
+	trace2_region_enter("merge", "premerge", opt->repo);
+	pthread_mutex_init(&todo->mutex, NULL);
+	enable_obj_read_lock();
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL, premerge_thread, todo);
+		if (err)
+			die(_("unable to create merge thread: %s"), strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	if (!had_obj_read_lock)
+		disable_obj_read_lock();
+	pthread_mutex_destroy(&todo->mutex);
+
+	opt->priv->premerged = xmalloc(sizeof(*opt->priv->premerged));
+	strmap_init(opt->priv->premerged);
+	for (i = 0; i < todo->nr; i++)
+		strmap_put(opt->priv->premerged, todo->items[i].path,
+			   &todo->items[i]);
+	trace2_data_intmax("merge", opt->repo, "premerge/threads", nr_threads);
+	trace2_data_intmax("merge", opt->repo, "premerge/merges", todo->nr);
+	trace2_region_leave("merge", "premerge", opt->repo);
+}
+
+static void clear_premerged(struct merge_options *opt,
+			    struct premerge_todo *todo)
+{
+	int i;
+
+	if (opt->priv->premerged) {
+		strmap_clear(opt->priv->premerged, 0);
+		FREE_AND_NULL(opt->priv->premerged);
+	}
+	for (i = 0; i < todo->nr; i++) {
+		struct premerged_content *pm = &todo->items[i];
+
+		free(pm->result.ptr);
+		free(pm->base);
+		free(pm->name1);
+		free(pm->name2);
+	}
+	free(todo->items);
+}
+
 static int process_entries(struct merge_options *opt,
 			   struct object_id *result_oid)
 {
@@ -4405,6 +4673,7 @@ static int process_entries(struct merge_options *opt,
 	struct directory_versions dir_metadata = { STRING_LIST_INIT_NODUP,
 						   STRING_LIST_INIT_NODUP,
 						   NULL, 0 };
+	struct premerge_todo premerge = { 0 };
 	int ret = 0;
 	const int record_tree = (!opt->mergeability_only ||
 				 opt->priv->call_depth);
@@ -4445,6 +4714,9 @@ static int process_entries(struct merge_options *opt,
 	 */
 	trace2_region_enter("merge", "processing", opt->repo);
 	prefetch_for_content_merges(opt, &plist);
+	premerge_contents(opt, &plist, &premerge);
+	/* the merged blobs and the trees are written in one go */
+	begin_odb_transaction();
 	for (entry = &plist.items[plist.nr-1]; entry >= plist.items; --entry) {
 		char *path = entry->string;
 		/*
@@ -4492,6 +4764,8 @@ static int process_entries(struct merge_options *opt,
 		       opt->repo->hash_algo->rawsz) < 0)
 		ret = -1;
 cleanup:
+	end_odb_transaction();
+	clear_premerged(opt, &premerge);
 	string_list_clear(&plist, 0);
 	string_list_clear(&dir_metadata.versions, 0);
 	string_list_clear(&dir_metadata.offsets, 0);
@@ -5358,6 +5632,13 @@ static void merge_recursive_config(struct merge_options *opt, int ui)
 	git_config_get_int("merge.renamelimit", &opt->rename_limit);
 	git_config_get_bool("merge.renormalize", &renormalize);
 	opt->renormalize = renormalize;
+	if (!git_config_get_int("merge.threads", &opt->threads)) {
+		if (opt->threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    opt->threads, "merge.threads");
+		if (!opt->threads)
+			opt->threads = online_cpus();
+	}
 	if (!git_config_get_string("diff.renames", &value)) {
 		opt->detect_renames = git_config_rename("diff.renames", value);
 		free(value);
@@ -5407,6 +5688,7 @@ static void init_merge_options(struct merge_options *opt,
 	strbuf_init(&opt->obuf, 0);
 
 	opt->renormalize = 0;
+	opt->threads = 1;
 
 	opt->conflict_style = -1;
 	opt->xdl_opts = DIFF_WITH_ALG(opt, HISTOGRAM_DIFF);
@@ -86,6 +86,7 @@ struct merge_options {
 	unsigned mergeability_only : 1; /* exit early, write fewer objects */
 	unsigned record_conflict_msgs_as_headers : 1;
 	const char *msg_header_prefix;
+	int threads; /* for the content merges; 1 does them as they come */
 
 	/* internal fields used by the implementation */
 	struct merge_options_internal *priv;
@@ -115,6 +115,157 @@ static void remove_dir_entry(struct index_state *istate, struct cache_entry *ce)
 	}
 }
 
+/*
+ * The name hash is a flat table of slots holding the hash of a name
+ * next to the entry, with linear probing.  Looking a name up only has
+ * to look at the entries whose hash matches, instead of following a
+ * chain through every entry that landed in the same bucket; this is
+ * what case-insensitive lookups from a large index spend their time
+ * on, especially for names that are not in the index.
+ *
+ * A removed entry leaves its slot marked as deleted, so that probing
+ * goes on past it.  The table is kept less than 3/4 full, deleted slots
+ * included, and rebuilt when it would fill up further.
+ */
+struct name_slot {
+	unsigned int hash;
+	unsigned int deleted;
+	struct cache_entry *ce;
+};
+
+static inline unsigned int name_table_start(const struct name_table *t,
+					    unsigned int hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	return hash & t->mask;
+}
+
+static void name_table_init(struct name_table *t, unsigned int nr)
+{
+	unsigned int size = 64;
+
+	while (size / 4 * 3 <= nr)
+		size <<= 1;
+	CALLOC_ARRAY(t->slots, size);
+	t->mask = size - 1;
+	t->nr = 0;
+	t->deleted = 0;
+}
+
+static void name_table_place(struct name_table *t, struct cache_entry *ce,
+			     unsigned int hash)
+{
+	unsigned int i = name_table_start(t, hash);
+
+	while (t->slots[i].ce)
+		i = (i + 1) & t->mask;
+	if (t->slots[i].deleted) {
+		t->slots[i].deleted = 0;
+		t->deleted--;
+	}
+	t->slots[i].hash = hash;
+	t->slots[i].ce = ce;
+	t->nr++;
+}
+
+static void name_table_add(struct name_table *t, struct cache_entry *ce,
+			   unsigned int hash)
+{
+	if (t->nr + t->deleted + 1 >= (t->mask + 1) / 4 * 3) {
+		struct name_table old = *t;
+		unsigned int i;
+
+		name_table_init(t, 2 * old.nr + 1);
+		for (i = 0; i <= old.mask; i++)
+			if (old.slots[i].ce)
+				name_table_place(t, old.slots[i].ce,
+						 old.slots[i].hash);
+		free(old.slots);
+	}
+	name_table_place(t, ce, hash);
+}
+
+static void name_table_remove(struct name_table *t, struct cache_entry *ce,
+			      unsigned int hash)
+{
+	unsigned int i;
+
+	for (i = name_table_start(t, hash); t->slots[i].ce || t->slots[i].deleted;
+	     i = (i + 1) & t->mask) {
+		if (t->slots[i].ce != ce)
+			continue;
+		t->slots[i].ce = NULL;
+		t->slots[i].deleted = 1;
+		t->nr--;
+		t->deleted++;
+		return;
+	}
+}
+
+/*
+ * Add all the hashed entries of the index to the empty table at once,
+ * when building the name hash.  Placing them one after the other in
+ * index order would write all over the table; grouping them by the
+ * region of the table they go to first makes the writes sequential,
+ * which is much faster for large indexes.  Tables small enough to stay
+ * in the cache are filled in index order.
+ */
+#define NAME_TABLE_SMALL (64 * 1024)
+
+static void name_table_fill(struct index_state *istate)
+{
+	struct name_table *t = &istate->name_hash;
+	unsigned int shift = 0, nr_regions, nr = 0, i;
+	unsigned int *offset;
+	struct name_slot *sorted;
+
+	if (t->mask < NAME_TABLE_SMALL) {
+		for (i = 0; i < istate->cache_nr; i++) {
+			struct cache_entry *ce = istate->cache[i];
+
+			if ((ce->ce_flags & CE_HASHED) &&
+			    !S_ISSPARSEDIR(ce->ce_mode))
+				name_table_place(t, ce, ce->ent.hash);
+		}
+		return;
+	}
+
+	while ((t->mask >> shift) >= 2048)
+		shift++;
+	nr_regions = (t->mask >> shift) + 1;
+	CALLOC_ARRAY(offset, nr_regions + 1);
+
+	for (i = 0; i < istate->cache_nr; i++) {
+		struct cache_entry *ce = istate->cache[i];
+
+		if (!(ce->ce_flags & CE_HASHED) || S_ISSPARSEDIR(ce->ce_mode))
+			continue;
+		offset[(name_table_start(t, ce->ent.hash) >> shift) + 1]++;
+		nr++;
+	}
+	for (i = 1; i <= nr_regions; i++)
+		offset[i] += offset[i - 1];
+
+	ALLOC_ARRAY(sorted, nr);
+	for (i = 0; i < istate->cache_nr; i++) {
+		struct cache_entry *ce = istate->cache[i];
+		struct name_slot *s;
+
+		if (!(ce->ce_flags & CE_HASHED) || S_ISSPARSEDIR(ce->ce_mode))
+			continue;
+		s = &sorted[offset[name_table_start(t, ce->ent.hash) >> shift]++];
+		s->hash = ce->ent.hash;
+		s->ce = ce;
+	}
+	for (i = 0; i < nr; i++)
+		name_table_place(t, sorted[i].ce, sorted[i].hash);
+
+	free(sorted);
+	free(offset);
+}
+
 static void hash_index_entry(struct index_state *istate, struct cache_entry *ce)
 {
 	if (ce->ce_flags & CE_HASHED)
@@ -123,29 +274,55 @@ static void hash_index_entry(struct index_state *istate, struct cache_entry *ce)
 
 	if (!S_ISSPARSEDIR(ce->ce_mode)) {
 		hashmap_entry_init(&ce->ent, memihash(ce->name, ce_namelen(ce)));
-		hashmap_add(&istate->name_hash, &ce->ent);
+		name_table_add(&istate->name_hash, ce, ce->ent.hash);
 	}
 
 	if (ignore_case)
 		add_dir_entry(istate, ce);
 }
 
-static int cache_entry_cmp(const void *cmp_data UNUSED,
-			   const struct hashmap_entry *eptr,
-			   const struct hashmap_entry *entry_or_key,
-			   const void *remove)
+/*
+ * Like hash_index_entry(), for use when hashing the whole index in
+ * order, except that the entry is left for name_table_fill() to add
+ * to the name hash.  Consecutive entries in a sorted index usually
+ * share their parent directory, so 'prev_dir' is the directory of the
+ * previous entry and we skip hashing and looking up the parent
+ * directory again when it is spelled the same.  Returns the directory
+ * of 'ce', to be passed in for the next entry.
+ */
+static struct dir_entry *hash_index_entry_in_order(struct index_state *istate,
+						   struct cache_entry *ce,
+						   struct dir_entry *prev_dir)
 {
-	const struct cache_entry *ce1, *ce2;
+	struct dir_entry *dir, *ret;
+	int dirlen;
 
-	ce1 = container_of(eptr, const struct cache_entry, ent);
-	ce2 = container_of(entry_or_key, const struct cache_entry, ent);
+	if (ce->ce_flags & CE_HASHED)
+		return prev_dir;
+	ce->ce_flags |= CE_HASHED;
 
-	/*
-	 * For remove_name_hash, find the exact entry (pointer equality); for
-	 * index_file_exists, find all entries with matching hash code and
-	 * decide whether the entry matches in same_name.
-	 */
-	return remove ? !(ce1 == ce2) : 0;
+	if (!S_ISSPARSEDIR(ce->ce_mode))
+		hashmap_entry_init(&ce->ent, memihash(ce->name, ce_namelen(ce)));
+	if (!ignore_case)
+		return NULL;
+
+	/* same computation of the parent directory as in hash_dir_entry() */
+	dirlen = ce_namelen(ce);
+	while (dirlen > 0 && !is_dir_sep(ce->name[dirlen - 1]))
+		dirlen--;
+	dirlen--;
+
+	if (prev_dir && dirlen >= 0 && prev_dir->namelen == dirlen &&
+	    !memcmp(prev_dir->name, ce->name, dirlen))
+		dir = prev_dir;
+	else
+		dir = hash_dir_entry(istate, ce, ce_namelen(ce));
+
+	/* Add reference to the directory entry (and parents if 0). */
+	ret = dir;
+	while (dir && !(dir->nr++))
+		dir = dir->parent;
+	return ret;
 }
 
 static int lazy_try_threaded = 1;
@@ -492,11 +669,10 @@ static void *lazy_name_thread_proc(void *_data)
 	for (k = 0; k < d->istate->cache_nr; k++) {
 		struct cache_entry *ce_k = d->istate->cache[k];
 		ce_k->ce_flags |= CE_HASHED;
-		if (!S_ISSPARSEDIR(ce_k->ce_mode)) {
+		if (!S_ISSPARSEDIR(ce_k->ce_mode))
 			hashmap_entry_init(&ce_k->ent, d->lazy_entries[k].hash_name);
-			hashmap_add(&d->istate->name_hash, &ce_k->ent);
-		}
 	}
+	name_table_fill(d->istate);
 
 	return NULL;
 }
@@ -595,7 +771,7 @@ static void lazy_init_name_hash(struct index_state *istate)
 		return;
 	trace_performance_enter();
 	trace2_region_enter("index", "name-hash-init", istate->repo);
-	hashmap_init(&istate->name_hash, cache_entry_cmp, NULL, istate->cache_nr);
+	name_table_init(&istate->name_hash, istate->cache_nr);
 	hashmap_init(&istate->dir_hash, dir_entry_cmp, NULL, istate->cache_nr);
 
 	if (lookup_lazy_params(istate)) {
@@ -609,9 +785,12 @@ static void lazy_init_name_hash(struct index_state *istate)
 		threaded_lazy_init_name_hash(istate);
 		hashmap_enable_item_counting(&istate->dir_hash);
 	} else {
+		struct dir_entry *dir = NULL;
 		int nr;
 		for (nr = 0; nr < istate->cache_nr; nr++)
-			hash_index_entry(istate, istate->cache[nr]);
+			dir = hash_index_entry_in_order(istate,
+							istate->cache[nr], dir);
+		name_table_fill(istate);
 	}
 
 	istate->name_hash_initialized = 1;
@@ -649,7 +828,8 @@ void remove_name_hash(struct index_state *istate, struct cache_entry *ce)
 	if (!istate->name_hash_initialized || !(ce->ce_flags & CE_HASHED))
 		return;
 	ce->ce_flags &= ~CE_HASHED;
-	hashmap_remove(&istate->name_hash, &ce->ent, ce);
+	if (!S_ISSPARSEDIR(ce->ce_mode))
+		name_table_remove(&istate->name_hash, ce, ce->ent.hash);
 
 	if (ignore_case)
 		remove_dir_entry(istate, ce);
@@ -734,16 +914,19 @@ void adjust_dirname_case(struct index_state *istate, char *name)
 
 struct cache_entry *index_file_exists(struct index_state *istate, const char *name, int namelen, int icase)
 {
-	struct cache_entry *ce;
+	struct name_table *t = &istate->name_hash;
 	unsigned int hash = memihash(name, namelen);
+	unsigned int i;
 
 	lazy_init_name_hash(istate);
 	expand_to_path(istate, name, namelen, icase);
 
-	ce = hashmap_get_entry_from_hash(&istate->name_hash, hash, NULL,
-					 struct cache_entry, ent);
-	hashmap_for_each_entry_from(&istate->name_hash, ce, ent) {
-		if (same_name(ce, name, namelen, icase))
+	for (i = name_table_start(t, hash); t->slots[i].ce || t->slots[i].deleted;
+	     i = (i + 1) & t->mask) {
+		struct cache_entry *ce = t->slots[i].ce;
+
+		if (ce && t->slots[i].hash == hash &&
+		    same_name(ce, name, namelen, icase))
 			return ce;
 	}
 	return NULL;
@@ -755,6 +938,6 @@ void free_name_hash(struct index_state *istate)
 		return;
 	istate->name_hash_initialized = 0;
 
-	hashmap_clear(&istate->name_hash);
+	FREE_AND_NULL(istate->name_hash.slots);
 	hashmap_clear_and_free(&istate->dir_hash, struct dir_entry, ent);
 }
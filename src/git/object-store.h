@@ -117,6 +117,14 @@ struct raw_object_store {
 	struct commit_graph *commit_graph;
 	unsigned commit_graph_attempted : 1; /* if loading has been attempted */
 
+	/* see rename-fingerprints.h */
+	struct rename_fingerprints *rename_fingerprints;
+	unsigned rename_fingerprints_attempted : 1;
+
+	/* see grep-trigrams.h */
+	struct grep_trigrams *grep_trigrams;
+	unsigned grep_trigrams_attempted : 1;
+
 	/*
 	 * private data
 	 *
@@ -22,6 +22,8 @@
 #include "object-store.h"
 #include "midx.h"
 #include "commit-graph.h"
+#include "rename-fingerprints.h"
+#include "grep-trigrams.h"
 #include "pack-revindex.h"
 #include "promisor-remote.h"
 #include "pack-mtimes.h"
@@ -375,6 +377,8 @@ void close_object_store(struct raw_object_store *o)
 	}
 
 	close_commit_graph(o);
+	close_rename_fingerprints(o);
+	close_grep_trigrams(o);
 }
 
 void unlink_pack_path(const char *pack_name, int force_delete)
@@ -1872,8 +1876,15 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 			      (uintmax_t)curpos, p->pack_name);
 			data = NULL;
 		} else {
+			/*
+			 * Both buffers are ours alone (the base is not put
+			 * back in the cache until below), so other threads
+			 * can read objects while we apply the delta.
+			 */
+			obj_read_unlock();
 			data = patch_delta(base, base_size, delta_data,
 					   delta_size, &size);
+			obj_read_lock();
 
 			/*
 			 * We could not apply the delta; warn the user, but
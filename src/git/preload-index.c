@@ -7,9 +7,11 @@
 
 #include "git-compat-util.h"
 #include "pathspec.h"
+#include "config.h"
 #include "dir.h"
 #include "environment.h"
 #include "fsmonitor.h"
+#include "fsmonitor-ipc.h"
 #include "gettext.h"
 #include "parse.h"
 #include "preload-index.h"
@@ -17,14 +19,16 @@
 #include "read-cache.h"
 #include "thread-utils.h"
 #include "repository.h"
+#include "strbuf.h"
 #include "symlinks.h"
 #include "trace2.h"
 
 /*
  * Mostly randomly chosen maximum thread counts: we
- * cap the parallelism to 20 threads, and we want
- * to have at least 500 lstat's per thread for it to
- * be worth starting a thread.
+ * cap the parallelism to 20 threads by default (see
+ * core.preloadIndexThreads), and we want to have at
+ * least 500 lstat's per thread for it to be worth
+ * starting a thread.
  */
 #define MAX_PARALLEL (20)
 #define THREAD_COST (500)
@@ -103,18 +107,100 @@ static void *preload_thread(void *_data)
 	return NULL;
 }
 
+/*
+ * With fsmonitor.statCache, ask the builtin fsmonitor daemon which of
+ * the entries that the threads would lstat() still match the worktree.
+ * The daemon remembers the stat data of the files it was asked about
+ * until they change, so this is a single round trip even when the
+ * index has no fsmonitor token yet.  The threads then only lstat()
+ * what the daemon could not vouch for.
+ */
+static void preload_from_fsmonitor(struct index_state *index,
+				   const struct pathspec *pathspec)
+{
+	struct strbuf request = STRBUF_INIT;
+	struct strbuf answer = STRBUF_INIT;
+	struct cache_def cache = CACHE_DEF_INIT;
+	struct cache_entry **ces;
+	int enabled, i, nr = 0, nr_valid = 0;
+
+	if (fsm_settings__get_mode(index->repo) != FSMONITOR_MODE_IPC ||
+	    repo_config_get_bool(index->repo, "fsmonitor.statcache", &enabled) ||
+	    !enabled)
+		return;
+
+	ALLOC_ARRAY(ces, index->cache_nr);
+	strbuf_addstr(&request, "stat\n");
+	for (i = 0; i < index->cache_nr; i++) {
+		struct cache_entry *ce = index->cache[i];
+		const struct stat_data *sd = &ce->ce_stat_data;
+
+		if (ce_stage(ce) || S_ISGITLINK(ce->ce_mode))
+			continue;
+		if (ce_uptodate(ce) || ce_skip_worktree(ce) || ce_intent_to_add(ce))
+			continue;
+		if (ce->ce_flags & CE_FSMONITOR_VALID)
+			continue;
+		if (strchr(ce->name, '\n'))
+			continue;
+		if (pathspec && !ce_path_match(index, ce, pathspec, NULL))
+			continue;
+		if (threaded_has_symlink_leading_path(&cache, ce->name, ce_namelen(ce)))
+			continue;
+		strbuf_addf(&request, "%o %u %u %u %u %u %u %u %u %u %s\n",
+			    ce->ce_mode,
+			    sd->sd_ctime.sec, sd->sd_ctime.nsec,
+			    sd->sd_mtime.sec, sd->sd_mtime.nsec,
+			    sd->sd_dev, sd->sd_ino, sd->sd_uid, sd->sd_gid,
+			    sd->sd_size, ce->name);
+		ces[nr++] = ce;
+	}
+
+	/* A daemon that does not know "stat" answers with a token. */
+	if (nr && !fsmonitor_ipc__send_stat_request(request.buf, &answer) &&
+	    answer.len == nr + 5 && starts_with(answer.buf, "stat\n")) {
+		for (i = 0; i < nr; i++) {
+			if (answer.buf[5 + i] != '=' ||
+			    is_racy_timestamp(index, ces[i]))
+				continue;
+			ce_mark_uptodate(ces[i]);
+			mark_fsmonitor_valid(index, ces[i]);
+			nr_valid++;
+		}
+	}
+	trace2_data_intmax("index", NULL, "preload/fsmonitor_stat", nr_valid);
+
+	cache_def_clear(&cache);
+	strbuf_release(&request);
+	strbuf_release(&answer);
+	free(ces);
+}
+
+static int preload_max_threads(void)
+{
+	int max_threads;
+
+	if (repo_config_get_int(the_repository, "core.preloadindexthreads",
+				&max_threads) || max_threads < 1)
+		return MAX_PARALLEL;
+	return max_threads;
+}
+
 void preload_index(struct index_state *index,
 		   const struct pathspec *pathspec,
 		   unsigned int refresh_flags)
 {
-	int threads, i, work, offset;
-	struct thread_data data[MAX_PARALLEL];
+	int threads, max_threads, i, work, offset;
+	struct thread_data *data;
 	struct progress_data pd;
 	int t2_sum_lstat = 0;
 
 	if (!HAVE_THREADS || !core_preload_index)
 		return;
 
+	if (fsmonitor_ipc__is_supported())
+		preload_from_fsmonitor(index, pathspec);
+
 	threads = index->cache_nr / THREAD_COST;
 	if ((index->cache_nr > 1) && (threads < 2) && git_env_bool("GIT_TEST_PRELOAD_INDEX", 0))
 		threads = 2;
@@ -124,11 +210,12 @@ void preload_index(struct index_state *index,
 	trace2_region_enter("index", "preload", NULL);
 
 	trace_performance_enter();
-	if (threads > MAX_PARALLEL)
-		threads = MAX_PARALLEL;
+	max_threads = preload_max_threads();
+	if (threads > max_threads)
+		threads = max_threads;
 	offset = 0;
 	work = DIV_ROUND_UP(index->cache_nr, threads);
-	memset(&data, 0, sizeof(data));
+	CALLOC_ARRAY(data, threads);
 
 	memset(&pd, 0, sizeof(pd));
 	if (refresh_flags & REFRESH_PROGRESS && isatty(2)) {
@@ -168,9 +255,11 @@ void preload_index(struct index_state *index,
 		for (i = 0; i < threads; i++)
 			clear_pathspec(&data[i].pathspec);
 	}
+	free(data);
 
 	trace_performance_leave("preload index");
 
+	trace2_data_intmax("index", NULL, "preload/threads", threads);
 	trace2_data_intmax("index", NULL, "preload/sum_lstat", t2_sum_lstat);
 	trace2_region_leave("index", "preload", NULL);
 }
@@ -163,6 +163,16 @@ enum sparse_index_mode {
 	INDEX_PARTIALLY_SPARSE,
 };
 
+/*
+ * The index entries by the (case-insensitive) hash of their name, in
+ * an open-addressed table; see name-hash.c.
+ */
+struct name_slot;
+struct name_table {
+	struct name_slot *slots;
+	unsigned int mask, nr, deleted;
+};
+
 struct index_state {
 	struct cache_entry **cache;
 	unsigned int version;
@@ -178,7 +188,7 @@ struct index_state {
 		 updated_skipworktree : 1,
 		 fsmonitor_has_run_once : 1;
 	enum sparse_index_mode sparse_index;
-	struct hashmap name_hash;
+	struct name_table name_hash;
 	struct hashmap dir_hash;
 	struct object_id oid;
 	struct untracked_cache *untracked;
@@ -33,6 +33,8 @@
 #include "commit-reach.h"
 #include "worktree.h"
 #include "hashmap.h"
+#include "replace-object.h"
+#include "thread-utils.h"
 
 static struct ref_msg {
 	const char *gone;
@@ -2292,6 +2294,152 @@ static const char *get_refname(struct used_atom *atom, struct ref_array_item *re
 	return show_ref(&atom->u.refname, ref->refname);
 }
 
+/*
+ * Reading the objects is what dominates formatting many refs with atoms
+ * like "%(contents:subject)" or "%(objectsize)".  The object store can
+ * be read from several threads (see enable_obj_read_lock()), so before
+ * a batch of refs is formatted, worker threads read the objects the
+ * used atoms need into the items.  Parsing them and filling in the
+ * values still happens in populate_value(), in the main thread.
+ */
+#define PREFETCH_BATCH 1024
+#define PREFETCH_MAX_THREADS 16
+
+struct ref_prefetch {
+	struct expand_data data;
+	int ret;
+};
+
+struct prefetch_queue {
+	struct ref_array_item **items;
+	size_t nr, next;
+	pthread_mutex_t mutex;
+};
+
+static int prefetch_threads(void)
+{
+	struct object_info empty = OBJECT_INFO_INIT;
+	int nr_threads;
+
+	if (!HAVE_THREADS)
+		return 1;
+	if (!need_tagged && !memcmp(&oi.info, &empty, sizeof(empty)))
+		return 1;
+	nr_threads = online_cpus();
+	return nr_threads < PREFETCH_MAX_THREADS ? nr_threads : PREFETCH_MAX_THREADS;
+}
+
+static void *prefetch_objects_thread(void *data)
+{
+	struct prefetch_queue *q = data;
+	int want_content = need_tagged || oi.info.contentp;
+
+	for (;;) {
+		struct ref_array_item *ref = NULL;
+		struct ref_prefetch *p;
+
+		pthread_mutex_lock(&q->mutex);
+		while (!ref && q->next < q->nr) {
+			ref = q->items[q->next++];
+			if (ref->value || ref->prefetch)
+				ref = NULL;
+		}
+		pthread_mutex_unlock(&q->mutex);
+		if (!ref)
+			return NULL;
+
+		CALLOC_ARRAY(p, 1);
+		p->data.oid = ref->objectname;
+		if (oi.info.typep || want_content)
+			p->data.info.typep = &p->data.type;
+		if (oi.info.sizep || want_content)
+			p->data.info.sizep = &p->data.size;
+		if (oi.info.disk_sizep)
+			p->data.info.disk_sizep = &p->data.disk_size;
+		if (oi.info.delta_base_oid)
+			p->data.info.delta_base_oid = &p->data.delta_base_oid;
+		if (want_content)
+			p->data.info.contentp = &p->data.content;
+
+		/*
+		 * Leave fetching missing objects from a promisor remote and
+		 * reporting errors to get_object().
+		 */
+		p->ret = oid_object_info_extended(the_repository, &p->data.oid,
+						  &p->data.info,
+						  OBJECT_INFO_LOOKUP_REPLACE |
+						  OBJECT_INFO_SKIP_FETCH_OBJECT);
+		ref->prefetch = p;
+	}
+}
+
+static void prefetch_ref_objects(struct ref_array_item **items, size_t nr)
+{
+	struct prefetch_queue q = {
+		.items = items,
+		.nr = nr,
+	};
+	pthread_t threads[PREFETCH_MAX_THREADS];
+	int nr_threads = prefetch_threads();
+	int had_obj_read_lock = obj_read_use_lock;
+	size_t todo = 0;
+
+	for (size_t i = 0; i < nr; i++)
+		if (!items[i]->value && !items[i]->prefetch)
+			todo++;
+	if ((size_t)nr_threads > todo)
+		nr_threads = todo;
+	if (nr_threads < 2)
+		return;
+
+	if (replace_refs_enabled(the_repository))
+		prepare_replace_object(the_repository);
+
+	pthread_mutex_init(&q.mutex, NULL);
+	enable_obj_read_lock();
+	for (int i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 prefetch_objects_thread, &q);
+		if (err)
+			die(_("unable to create thread: %s"), strerror(err));
+	}
+	for (int i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	if (!had_obj_read_lock)
+		disable_obj_read_lock();
+	pthread_mutex_destroy(&q.mutex);
+}
+
+static void free_ref_prefetch(struct ref_array_item *ref)
+{
+	if (!ref->prefetch)
+		return;
+	free(ref->prefetch->data.content);
+	FREE_AND_NULL(ref->prefetch);
+}
+
+/*
+ * Use what the worker threads read for 'ref', if anything.  Returns 1
+ * if 'oi' has been filled in.
+ */
+static int use_prefetched_object(struct ref_array_item *ref,
+				 struct expand_data *oi)
+{
+	struct ref_prefetch *p = ref->prefetch;
+
+	if (!p || p->ret || !oideq(&p->data.oid, &oi->oid)) {
+		free_ref_prefetch(ref);
+		return 0;
+	}
+	oi->type = p->data.type;
+	oi->size = p->data.size;
+	oi->disk_size = p->data.disk_size;
+	oidcpy(&oi->delta_base_oid, &p->data.delta_base_oid);
+	oi->content = p->data.content;
+	FREE_AND_NULL(ref->prefetch);
+	return 1;
+}
+
 static int get_object(struct ref_array_item *ref, int deref, struct object **obj,
 		      struct expand_data *oi, struct strbuf *err)
 {
@@ -2302,7 +2450,8 @@ static int get_object(struct ref_array_item *ref, int deref, struct object **obj
 		oi->info.sizep = &oi->size;
 		oi->info.typep = &oi->type;
 	}
-	if (oid_object_info_extended(the_repository, &oi->oid, &oi->info,
+	if ((deref || !use_prefetched_object(ref, oi)) &&
+	    oid_object_info_extended(the_repository, &oi->oid, &oi->info,
 				     OBJECT_INFO_LOOKUP_REPLACE))
 		return strbuf_addf_ret(err, -1, _("missing object %s for %s"),
 				       oid_to_hex(&oi->oid), ref->refname);
@@ -2559,8 +2708,10 @@ static int populate_value(struct ref_array_item *ref, struct strbuf *err)
 	if (need_tagged)
 		oi.info.contentp = &oi.content;
 	if (!memcmp(&oi.info, &empty, sizeof(empty)) &&
-	    !memcmp(&oi_deref.info, &empty, sizeof(empty)))
+	    !memcmp(&oi_deref.info, &empty, sizeof(empty))) {
+		free_ref_prefetch(ref);
 		return 0;
+	}
 
 
 	oi.oid = ref->objectname;
@@ -2946,6 +3097,7 @@ static void free_array_item(struct ref_array_item *item)
 	}
 	free(item->counts);
 	free(item->is_base);
+	free_ref_prefetch(item);
 	free(item);
 }
 
@@ -2955,30 +3107,57 @@ struct ref_filter_and_format_cbdata {
 
 	struct ref_filter_and_format_internal {
 		int count;
+		/*
+		 * Refs that have been filtered but not yet formatted, so
+		 * that their objects can be read ahead in parallel.
+		 */
+		struct ref_array batch;
+		int batch_size;
 	} internal;
 };
 
-static int filter_and_format_one(const char *refname, const char *referent, const struct object_id *oid, int flag, void *cb_data)
+static void format_ref_batch(struct ref_filter_and_format_cbdata *ref_cbdata)
 {
-	struct ref_filter_and_format_cbdata *ref_cbdata = cb_data;
-	struct ref_array_item *ref;
+	struct ref_array *batch = &ref_cbdata->internal.batch;
 	struct strbuf output = STRBUF_INIT, err = STRBUF_INIT;
 
-	ref = apply_ref_filter(refname, referent, oid, flag, ref_cbdata->filter);
-	if (!ref)
-		return 0;
+	if (batch->nr > 1)
+		prefetch_ref_objects(batch->items, batch->nr);
 
-	if (format_ref_array_item(ref, ref_cbdata->format, &output, &err))
-		die("%s", err.buf);
+	for (int i = 0; i < batch->nr; i++) {
+		struct ref_array_item *ref = batch->items[i];
+
+		if (format_ref_array_item(ref, ref_cbdata->format, &output, &err))
+			die("%s", err.buf);
 
-	if (output.len || !ref_cbdata->format->array_opts.omit_empty) {
-		fwrite(output.buf, 1, output.len, stdout);
-		putchar('\n');
+		if (output.len || !ref_cbdata->format->array_opts.omit_empty) {
+			fwrite(output.buf, 1, output.len, stdout);
+			putchar('\n');
+		}
+
+		strbuf_reset(&output);
+		free_array_item(ref);
 	}
+	batch->nr = 0;
 
 	strbuf_release(&output);
 	strbuf_release(&err);
-	free_array_item(ref);
+}
+
+static int filter_and_format_one(const char *refname, const char *referent, const struct object_id *oid, int flag, void *cb_data)
+{
+	struct ref_filter_and_format_cbdata *ref_cbdata = cb_data;
+	struct ref_array *batch = &ref_cbdata->internal.batch;
+	struct ref_array_item *ref;
+
+	ref = apply_ref_filter(refname, referent, oid, flag, ref_cbdata->filter);
+	if (!ref)
+		return 0;
+
+	ALLOC_GROW(batch->items, batch->nr + 1, batch->alloc);
+	batch->items[batch->nr++] = ref;
+	if (batch->nr >= ref_cbdata->internal.batch_size)
+		format_ref_batch(ref_cbdata);
 
 	/*
 	 * Increment the running count of refs that match the filter. If
@@ -3319,7 +3498,11 @@ void filter_and_format_refs(struct ref_filter *filter, unsigned int type,
 		save_commit_buffer_orig = save_commit_buffer;
 		save_commit_buffer = 0;
 
+		ref_cbdata.internal.batch_size =
+			prefetch_threads() > 1 ? PREFETCH_BATCH : 1;
 		do_filter_refs(filter, type, filter_and_format_one, &ref_cbdata);
+		format_ref_batch(&ref_cbdata);
+		free(ref_cbdata.internal.batch.items);
 
 		save_commit_buffer = save_commit_buffer_orig;
 	} else {
@@ -3444,8 +3627,36 @@ void ref_sorting_set_sort_flags_all(struct ref_sorting *sorting,
 
 void ref_array_sort(struct ref_sorting *sorting, struct ref_array *array)
 {
-	if (sorting)
-		QSORT_S(array->items, array->nr, compare_refs, sorting);
+	if (!sorting)
+		return;
+
+	/*
+	 * Comparing the refs needs the values of all of them anyway, so
+	 * fill them in batches whose objects are read ahead in parallel.
+	 * A single ref is never compared, so leave it alone: its objects
+	 * may not even exist, as with "ls-remote --sort".
+	 */
+	if (array->nr > 1 && prefetch_threads() > 1) {
+		struct strbuf err = STRBUF_INIT;
+
+		for (int i = 0; i < array->nr; i += PREFETCH_BATCH) {
+			int nr = array->nr - i;
+
+			if (nr > PREFETCH_BATCH)
+				nr = PREFETCH_BATCH;
+			prefetch_ref_objects(array->items + i, nr);
+			for (int j = i; j < i + nr; j++) {
+				struct atom_value *v;
+
+				if (get_ref_atom_value(array->items[j],
+						       sorting->atom, &v, &err))
+					die("%s", err.buf);
+			}
+		}
+		strbuf_release(&err);
+	}
+
+	QSORT_S(array->items, array->nr, compare_refs, sorting);
 }
 
 static void append_literal(const char *cp, const char *ep, struct ref_formatting_state *state)
@@ -3525,6 +3736,10 @@ void print_formatted_ref_array(struct ref_array *array, struct ref_format *forma
 	if (!total || array->nr < total)
 		total = array->nr;
 	for (int i = 0; i < total; i++) {
+		if (!(i % PREFETCH_BATCH) && total - i > 1)
+			prefetch_ref_objects(array->items + i,
+					     total - i < PREFETCH_BATCH ?
+					     total - i : PREFETCH_BATCH);
 		strbuf_reset(&err);
 		strbuf_reset(&output);
 		if (format_ref_array_item(array->items[i], format, &output, &err))
@@ -30,6 +30,7 @@
 struct atom_value;
 struct ref_sorting;
 struct ahead_behind_count;
+struct ref_prefetch;
 struct option;
 
 enum ref_sorting_order {
@@ -49,6 +50,7 @@ struct ref_array_item {
 	struct atom_value *value;
 	struct ahead_behind_count **counts;
 	char **is_base;
+	struct ref_prefetch *prefetch;
 
 	char refname[FLEX_ARRAY];
 };
@@ -1936,11 +1936,15 @@ int refs_for_each_fullref_in_prefixes(struct ref_store *ref_store,
 {
 	struct strvec namespaced_exclude_patterns = STRVEC_INIT;
 	struct string_list prefixes = STRING_LIST_INIT_DUP;
+	struct strvec full_prefixes = STRVEC_INIT;
 	struct string_list_item *prefix;
 	struct strbuf buf = STRBUF_INIT;
+	struct ref_iterator *iter;
 	int ret = 0, namespace_len;
 
 	find_longest_prefixes(&prefixes, patterns);
+	if (!ref_store || !prefixes.nr)
+		goto out;
 
 	if (namespace)
 		strbuf_addstr(&buf, namespace);
@@ -1952,14 +1956,22 @@ int refs_for_each_fullref_in_prefixes(struct ref_store *ref_store,
 
 	for_each_string_list_item(prefix, &prefixes) {
 		strbuf_addstr(&buf, prefix->string);
-		ret = refs_for_each_fullref_in(ref_store, buf.buf,
-					       exclude_patterns, fn, cb_data);
-		if (ret)
-			break;
+		strvec_push(&full_prefixes, buf.buf);
 		strbuf_setlen(&buf, namespace_len);
 	}
 
+	/*
+	 * Rather than starting over for every prefix, use a single
+	 * iterator and seek it from one prefix to the next.
+	 */
+	iter = refs_ref_iterator_begin(ref_store, full_prefixes.v[0],
+				       exclude_patterns, 0, 0);
+	iter = prefixes_ref_iterator_begin(iter, full_prefixes.v);
+	ret = do_for_each_ref_iterator(iter, fn, cb_data);
+
+out:
 	strvec_clear(&namespaced_exclude_patterns);
+	strvec_clear(&full_prefixes);
 	string_list_clear(&prefixes, 0);
 	strbuf_release(&buf);
 	return ret;
@@ -993,7 +993,8 @@ static struct ref_iterator *files_ref_iterator_begin(
 	 */
 
 	loose_iter = cache_ref_iterator_begin(get_loose_ref_cache(refs, flags),
-					      prefix, ref_store->repo, 1);
+					      prefix, exclude_patterns,
+					      ref_store->repo, 1);
 
 	/*
 	 * The packed-refs file might contain broken references, for
@@ -1380,7 +1381,7 @@ static int should_pack_refs(struct files_ref_store *refs,
 	if (limit < 16)
 		limit = 16;
 
-	iter = cache_ref_iterator_begin(get_loose_ref_cache(refs, 0), NULL,
+	iter = cache_ref_iterator_begin(get_loose_ref_cache(refs, 0), NULL, NULL,
 					refs->base.repo, 0);
 	while ((ret = ref_iterator_advance(iter)) == ITER_OK) {
 		if (should_pack_ref(refs, iter->refname, iter->oid,
@@ -1421,7 +1422,7 @@ static int files_pack_refs(struct ref_store *ref_store,
 
 	packed_refs_lock(refs->packed_ref_store, LOCK_DIE_ON_ERROR, &err);
 
-	iter = cache_ref_iterator_begin(get_loose_ref_cache(refs, 0), NULL,
+	iter = cache_ref_iterator_begin(get_loose_ref_cache(refs, 0), NULL, NULL,
 					refs->base.repo, 0);
 	while ((ok = ref_iterator_advance(iter)) == ITER_OK) {
 		/*
@@ -1531,6 +1532,7 @@ static enum ref_transaction_error write_ref_to_lockfile(struct files_ref_store *
 							struct ref_lock *lock,
 							const struct object_id *oid,
 							int skip_oid_verification,
+							unsigned *flush_pending,
 							struct strbuf *err);
 static int commit_ref_update(struct files_ref_store *refs,
 			     struct ref_lock *lock,
@@ -1678,7 +1680,7 @@ static int files_copy_or_rename_ref(struct ref_store *ref_store,
 	}
 	oidcpy(&lock->old_oid, &orig_oid);
 
-	if (write_ref_to_lockfile(refs, lock, &orig_oid, 0, &err) ||
+	if (write_ref_to_lockfile(refs, lock, &orig_oid, 0, NULL, &err) ||
 	    commit_ref_update(refs, lock, &orig_oid, logmsg, 0, &err)) {
 		error("unable to write current sha1 into %s: %s", newrefname, err.buf);
 		strbuf_release(&err);
@@ -1696,7 +1698,7 @@ static int files_copy_or_rename_ref(struct ref_store *ref_store,
 		goto rollbacklog;
 	}
 
-	if (write_ref_to_lockfile(refs, lock, &orig_oid, 0, &err) ||
+	if (write_ref_to_lockfile(refs, lock, &orig_oid, 0, NULL, &err) ||
 	    commit_ref_update(refs, lock, &orig_oid, NULL, REF_SKIP_CREATE_REFLOG, &err)) {
 		error("unable to write current sha1 into %s: %s", oldrefname, err.buf);
 		strbuf_release(&err);
@@ -1933,6 +1935,51 @@ static int files_log_ref_write(struct files_ref_store *refs,
 	return 0;
 }
 
+/*
+ * Sync the lockfile of a reference that is about to be committed. With
+ * "core.fsyncMethod=batch" and a non-NULL `flush_pending`, only have
+ * the data written out and set `*flush_pending`; the caller then has
+ * to call flush_batch_fsync_refs() before it renames the lockfile into
+ * place. This way, a transaction that updates many references waits
+ * for a single hardware flush instead of one per reference.
+ */
+static int fsync_ref_lockfile(struct ref_lock *lock, unsigned *flush_pending)
+{
+	int fd = get_lock_file_fd(&lock->lk);
+
+	if (flush_pending && batch_fsync_enabled(FSYNC_COMPONENT_REFERENCE) &&
+	    git_fsync(fd, FSYNC_WRITEOUT_ONLY) >= 0) {
+		*flush_pending = 1;
+		return 0;
+	}
+	return fsync_component(FSYNC_COMPONENT_REFERENCE, fd);
+}
+
+/*
+ * Issue the hardware flush that makes the lockfiles written out by
+ * fsync_ref_lockfile() durable, by syncing a temporary file next to
+ * them.
+ */
+static int flush_batch_fsync_refs(struct files_ref_store *refs,
+				  struct strbuf *err)
+{
+	struct strbuf path = STRBUF_INIT;
+	struct tempfile *temp;
+	int ret = 0;
+
+	strbuf_addf(&path, "%s/bulk_fsync_XXXXXX", refs->gitcommondir);
+	temp = mks_tempfile(path.buf);
+	if (!temp || fsync_component(FSYNC_COMPONENT_REFERENCE,
+				     get_tempfile_fd(temp)) < 0) {
+		strbuf_addf(err, "couldn't flush reference lockfiles: %s",
+			    strerror(errno));
+		ret = -1;
+	}
+	delete_tempfile(&temp);
+	strbuf_release(&path);
+	return ret;
+}
+
 /*
  * Write oid into the open lockfile, then close the lockfile. On
  * errors, rollback the lockfile, fill in *err and return -1.
@@ -1941,6 +1988,7 @@ static enum ref_transaction_error write_ref_to_lockfile(struct files_ref_store *
 							struct ref_lock *lock,
 							const struct object_id *oid,
 							int skip_oid_verification,
+							unsigned *flush_pending,
 							struct strbuf *err)
 {
 	static char term = '\n';
@@ -1969,7 +2017,7 @@ static enum ref_transaction_error write_ref_to_lockfile(struct files_ref_store *
 	fd = get_lock_file_fd(&lock->lk);
 	if (write_in_full(fd, oid_to_hex(oid), refs->base.repo->hash_algo->hexsz) < 0 ||
 	    write_in_full(fd, &term, 1) < 0 ||
-	    fsync_component(FSYNC_COMPONENT_REFERENCE, get_lock_file_fd(&lock->lk)) < 0 ||
+	    fsync_ref_lockfile(lock, flush_pending) < 0 ||
 	    close_ref_gently(lock) < 0) {
 		strbuf_addf(err,
 			    "couldn't write '%s'", get_lock_file_path(&lock->lk));
@@ -2536,6 +2584,12 @@ struct files_transaction_backend_data {
 	struct ref_transaction *packed_transaction;
 	int packed_refs_locked;
 	struct strmap ref_locks;
+
+	/*
+	 * Whether lockfiles were written out without a hardware flush,
+	 * see fsync_ref_lockfile().
+	 */
+	unsigned flush_pending;
 };
 
 /*
@@ -2704,7 +2758,7 @@ static enum ref_transaction_error lock_ref_for_update(struct files_ref_store *re
 			ret = write_ref_to_lockfile(
 				refs, lock, &update->new_oid,
 				update->flags & REF_SKIP_OID_VERIFICATION,
-				err);
+				&backend_data->flush_pending, err);
 			if (ret) {
 				char *write_err = strbuf_detach(err, NULL);
 
@@ -3162,6 +3216,12 @@ static int files_transaction_finish(struct ref_store *ref_store,
 	backend_data = transaction->backend_data;
 	packed_transaction = backend_data->packed_transaction;
 
+	if (backend_data->flush_pending &&
+	    flush_batch_fsync_refs(refs, err)) {
+		ret = REF_TRANSACTION_ERROR_GENERIC;
+		goto cleanup;
+	}
+
 	/* Perform updates first so live commits remain referenced */
 	for (i = 0; i < transaction->nr; i++) {
 		struct ref_update *update = transaction->updates[i];
@@ -9,6 +9,7 @@
 #include "refs.h"
 #include "refs/refs-internal.h"
 #include "iterator.h"
+#include "strvec.h"
 
 int ref_iterator_advance(struct ref_iterator *ref_iterator)
 {
@@ -462,6 +463,94 @@ struct ref_iterator *prefix_ref_iterator_begin(struct ref_iterator *iter0,
 	return ref_iterator;
 }
 
+struct prefixes_ref_iterator {
+	struct ref_iterator base;
+
+	struct ref_iterator *iter0;
+	struct strvec prefixes;
+	size_t current;
+};
+
+static int prefixes_ref_iterator_advance(struct ref_iterator *ref_iterator)
+{
+	struct prefixes_ref_iterator *iter =
+		(struct prefixes_ref_iterator *)ref_iterator;
+	int ok;
+
+	while ((ok = ref_iterator_advance(iter->iter0)) != ITER_OK) {
+		if (ok != ITER_DONE)
+			return ok;
+		if (++iter->current >= iter->prefixes.nr)
+			return ITER_DONE;
+		if (ref_iterator_seek(iter->iter0,
+				      iter->prefixes.v[iter->current]) < 0)
+			return ITER_ERROR;
+	}
+
+	iter->base.refname = iter->iter0->refname;
+	iter->base.referent = iter->iter0->referent;
+	iter->base.oid = iter->iter0->oid;
+	iter->base.flags = iter->iter0->flags;
+	return ITER_OK;
+}
+
+static int prefixes_ref_iterator_seek(struct ref_iterator *ref_iterator,
+				      const char *prefix)
+{
+	struct prefixes_ref_iterator *iter =
+		(struct prefixes_ref_iterator *)ref_iterator;
+
+	strvec_clear(&iter->prefixes);
+	strvec_push(&iter->prefixes, prefix ? prefix : "");
+	iter->current = 0;
+	return ref_iterator_seek(iter->iter0, prefix);
+}
+
+static int prefixes_ref_iterator_peel(struct ref_iterator *ref_iterator,
+				      struct object_id *peeled)
+{
+	struct prefixes_ref_iterator *iter =
+		(struct prefixes_ref_iterator *)ref_iterator;
+
+	return ref_iterator_peel(iter->iter0, peeled);
+}
+
+static void prefixes_ref_iterator_release(struct ref_iterator *ref_iterator)
+{
+	struct prefixes_ref_iterator *iter =
+		(struct prefixes_ref_iterator *)ref_iterator;
+	ref_iterator_free(iter->iter0);
+	strvec_clear(&iter->prefixes);
+}
+
+static struct ref_iterator_vtable prefixes_ref_iterator_vtable = {
+	.advance = prefixes_ref_iterator_advance,
+	.seek = prefixes_ref_iterator_seek,
+	.peel = prefixes_ref_iterator_peel,
+	.release = prefixes_ref_iterator_release,
+};
+
+struct ref_iterator *prefixes_ref_iterator_begin(struct ref_iterator *iter0,
+						 const char **prefixes)
+{
+	struct prefixes_ref_iterator *iter;
+	struct ref_iterator *ref_iterator;
+
+	if (!prefixes[0] || !prefixes[1])
+		return iter0; /* optimization: no need to wrap iterator */
+
+	CALLOC_ARRAY(iter, 1);
+	ref_iterator = &iter->base;
+
+	base_ref_iterator_init(ref_iterator, &prefixes_ref_iterator_vtable);
+
+	iter->iter0 = iter0;
+	strvec_init(&iter->prefixes);
+	strvec_pushv(&iter->prefixes, prefixes);
+
+	return ref_iterator;
+}
+
 struct ref_iterator *current_ref_iter = NULL;
 
 int do_for_each_ref_iterator(struct ref_iterator *iter,
@@ -2,7 +2,9 @@
 #define DISABLE_SIGN_COMPARE_WARNINGS
 
 #include "../git-compat-util.h"
+#include "../chunk-format.h"
 #include "../config.h"
+#include "../csum-file.h"
 #include "../dir.h"
 #include "../fsck.h"
 #include "../gettext.h"
@@ -19,6 +21,7 @@
 #include "../wrapper.h"
 #include "../write-or-die.h"
 #include "../trace2.h"
+#include "../varint.h"
 
 enum mmap_strategy {
 	/*
@@ -51,6 +54,40 @@ static enum mmap_strategy mmap_strategy = MMAP_OK;
 
 struct packed_ref_store;
 
+/*
+ * With "extensions.packedRefsV2", the `packed-refs` file is written in a
+ * binary format instead of the text one. It is in the chunk format (see
+ * chunk-format.h), after an 8-byte header made of the signature, the
+ * version, the hash version, the number of chunks and a reserved byte.
+ * The references are sorted by refname, and the chunks are:
+ *
+ *   PROI: the object name of each reference, with a fixed width
+ *   PRNM: the refnames, each made of a varint of the number of bytes it
+ *         shares with the previous refname, a varint of the length of the
+ *         rest times two (plus one if the reference has a peeled value),
+ *         and the rest of the refname
+ *   PRRS: the restart points, which are the refnames of every
+ *         PACKED_REFS_V2_RESTART_INTERVAL-th reference, starting with the
+ *         first one. They share nothing with the previous refname. For
+ *         each, the 32-bit offset of the refname in PRNM and the 32-bit
+ *         number of peeled values of the references before it
+ *   PRPL: the peeled values of the references that have one, in order
+ *
+ * All references are fully peeled, and all integers are in network byte
+ * order.
+ */
+#define PACKED_REFS_V2_SIGNATURE 0x50524546 /* "PREF" */
+#define PACKED_REFS_V2_VERSION 2
+#define PACKED_REFS_V2_HEADER_SIZE 8
+
+#define PACKED_REFS_V2_CHUNKID_OIDS 0x50524f49 /* "PROI" */
+#define PACKED_REFS_V2_CHUNKID_NAMES 0x50524e4d /* "PRNM" */
+#define PACKED_REFS_V2_CHUNKID_RESTARTS 0x50525253 /* "PRRS" */
+#define PACKED_REFS_V2_CHUNKID_PEELED 0x5052504c /* "PRPL" */
+
+#define PACKED_REFS_V2_RESTART_INTERVAL 16
+#define PACKED_REFS_V2_RESTART_WIDTH 8
+
 /*
  * A `snapshot` represents one snapshot of a `packed-refs` file.
  *
@@ -95,9 +132,28 @@ struct snapshot {
 	 * heap-allocated memory containing the contents, sorted. If
 	 * there were no contents (e.g., because the file didn't
 	 * exist), `buf`, `start`, and `eof` are all NULL.
+	 *
+	 * For a file in the binary format, `start` and `eof` delimit the
+	 * object names of the references instead, so that the position of
+	 * a reference in the buffer still tells its place in the sort
+	 * order; see `binary` below for the other parts of the file.
 	 */
 	char *buf, *start, *eof;
 
+	/* The length of the memory at `buf`. */
+	size_t len;
+
+	/* The chunks of a file in the binary format, if it is one. */
+	struct {
+		unsigned enabled : 1;
+		size_t nr;
+		const unsigned char *names;
+		size_t names_len;
+		const unsigned char *restarts;
+		const unsigned char *peeled;
+		size_t nr_peeled;
+	} binary;
+
 	/*
 	 * What is the peeled state of the `packed-refs` file that
 	 * this snapshot represents? (This is usually determined from
@@ -180,7 +236,7 @@ static void acquire_snapshot(struct snapshot *snapshot)
 static void clear_snapshot_buffer(struct snapshot *snapshot)
 {
 	if (snapshot->mmapped) {
-		if (munmap(snapshot->buf, snapshot->eof - snapshot->buf))
+		if (munmap(snapshot->buf, snapshot->len))
 			die_errno("error ummapping packed-refs file %s",
 				  snapshot->refs->path);
 		snapshot->mmapped = 0;
@@ -188,6 +244,7 @@ static void clear_snapshot_buffer(struct snapshot *snapshot)
 		free(snapshot->buf);
 	}
 	snapshot->buf = snapshot->start = snapshot->eof = NULL;
+	snapshot->len = 0;
 }
 
 /*
@@ -438,6 +495,7 @@ static void sort_snapshot(struct snapshot *snapshot)
 	clear_snapshot_buffer(snapshot);
 	snapshot->buf = snapshot->start = new_buffer;
 	snapshot->eof = new_buffer + len;
+	snapshot->len = len;
 
 cleanup:
 	free(records);
@@ -539,6 +597,7 @@ static int allocate_snapshot_buffer(struct snapshot *snapshot, int fd, struct st
 
 	snapshot->start = snapshot->buf;
 	snapshot->eof = snapshot->buf + size;
+	snapshot->len = size;
 
 	return 1;
 }
@@ -582,9 +641,276 @@ static int load_contents(struct snapshot *snapshot)
 	return ret;
 }
 
-static const char *find_reference_location_1(struct snapshot *snapshot,
-					     const char *refname, int mustexist,
-					     int start)
+/*
+ * Parse the chunks of a snapshot whose buffer holds a `packed-refs`
+ * file in the binary format and set up `snapshot->binary`. The restart
+ * points are checked here, so that their offsets can be trusted later
+ * on; the refnames are only checked as they are decoded. Return 0 on
+ * success, or -1 after describing the problem in `err`.
+ */
+static int parse_binary_snapshot(struct snapshot *snapshot, struct strbuf *err)
+{
+	const struct git_hash_algo *algo = snapshot->refs->base.repo->hash_algo;
+	const unsigned char *data = (const unsigned char *)snapshot->buf;
+	const unsigned char *oids, *peeled;
+	size_t oids_len, restarts_len, peeled_len, nr_restarts, i;
+	size_t last_offset = 0, last_peeled = 0;
+	struct chunkfile *cf = NULL;
+	int ret = -1;
+
+	if (snapshot->len < PACKED_REFS_V2_HEADER_SIZE + algo->rawsz ||
+	    snapshot->len < PACKED_REFS_V2_HEADER_SIZE + algo->rawsz +
+			    (data[6] + 1) * CHUNK_TOC_ENTRY_SIZE) {
+		strbuf_addf(err, "packed-refs file %s is too small",
+			    snapshot->refs->path);
+		goto out;
+	}
+	if (data[4] != PACKED_REFS_V2_VERSION) {
+		strbuf_addf(err, "packed-refs file %s has unsupported version %d",
+			    snapshot->refs->path, data[4]);
+		goto out;
+	}
+	if (data[5] != oid_version(algo)) {
+		strbuf_addf(err, "packed-refs file %s has hash version %d, not %d",
+			    snapshot->refs->path, data[5], oid_version(algo));
+		goto out;
+	}
+
+	cf = init_chunkfile(NULL);
+	if (read_table_of_contents(cf, data, snapshot->len,
+				   PACKED_REFS_V2_HEADER_SIZE, data[6], 1) ||
+	    pair_chunk(cf, PACKED_REFS_V2_CHUNKID_OIDS, &oids, &oids_len) ||
+	    oids_len % algo->rawsz ||
+	    pair_chunk(cf, PACKED_REFS_V2_CHUNKID_NAMES,
+		       &snapshot->binary.names, &snapshot->binary.names_len) ||
+	    pair_chunk(cf, PACKED_REFS_V2_CHUNKID_RESTARTS,
+		       &snapshot->binary.restarts, &restarts_len) ||
+	    pair_chunk(cf, PACKED_REFS_V2_CHUNKID_PEELED, &peeled, &peeled_len) ||
+	    peeled_len % algo->rawsz)
+		goto corrupt;
+
+	snapshot->binary.nr = oids_len / algo->rawsz;
+	snapshot->binary.peeled = peeled;
+	snapshot->binary.nr_peeled = peeled_len / algo->rawsz;
+
+	nr_restarts = DIV_ROUND_UP(snapshot->binary.nr,
+				   PACKED_REFS_V2_RESTART_INTERVAL);
+	if (restarts_len != st_mult(nr_restarts, PACKED_REFS_V2_RESTART_WIDTH))
+		goto corrupt;
+	for (i = 0; i < nr_restarts; i++) {
+		const unsigned char *r = snapshot->binary.restarts +
+			i * PACKED_REFS_V2_RESTART_WIDTH;
+		size_t offset = get_be32(r);
+		size_t nr_peeled = get_be32(r + 4);
+
+		if (offset < last_offset ||
+		    offset >= snapshot->binary.names_len ||
+		    nr_peeled < last_peeled ||
+		    nr_peeled > snapshot->binary.nr_peeled)
+			goto corrupt;
+		last_offset = offset;
+		last_peeled = nr_peeled;
+	}
+
+	snapshot->binary.enabled = 1;
+	snapshot->start = (char *)oids;
+	snapshot->eof = (char *)oids + oids_len;
+	snapshot->peeled = PEELED_FULLY;
+	ret = 0;
+	goto out;
+
+corrupt:
+	strbuf_addf(err, "packed-refs file %s is corrupt", snapshot->refs->path);
+out:
+	free_chunkfile(cf);
+	return ret;
+}
+
+/*
+ * A position in the refnames of a snapshot in the binary format, which
+ * can only be decoded in order from the restart point preceding them.
+ */
+struct binary_cursor {
+	/* The index of the reference whose refname is at `next`. */
+	size_t nr;
+	const unsigned char *next;
+	/* The number of peeled values of the references before it. */
+	size_t nr_peeled;
+};
+
+static int decode_varint_bounded(const unsigned char **bufp,
+				 const unsigned char *end, uintmax_t *ret)
+{
+	const unsigned char *buf = *bufp;
+	unsigned char c;
+	uintmax_t val;
+
+	if (buf >= end)
+		return -1;
+	c = *buf++;
+	val = c & 127;
+	while (c & 128) {
+		if (buf >= end)
+			return -1;
+		val += 1;
+		if (!val || (val >> (bitsizeof(val) - 7)))
+			return -1; /* overflow */
+		c = *buf++;
+		val = (val << 7) + (c & 127);
+	}
+	*bufp = buf;
+	*ret = val;
+	return 0;
+}
+
+/*
+ * Decode the refname at the cursor into `refname`, which must hold the
+ * previous refname unless the cursor is at a restart point, and move
+ * the cursor to the next one. Set `peeled` to the peeled value of the
+ * reference, or to NULL if it has none. Return -1 if the data is
+ * corrupt.
+ */
+static int binary_cursor_next(const struct snapshot *snapshot,
+			      struct binary_cursor *cur,
+			      struct strbuf *refname,
+			      const unsigned char **peeled)
+{
+	const unsigned char *end =
+		snapshot->binary.names + snapshot->binary.names_len;
+	size_t rawsz = snapshot->refs->base.repo->hash_algo->rawsz;
+	uintmax_t prefix_len, suffix;
+
+	if (cur->nr >= snapshot->binary.nr ||
+	    decode_varint_bounded(&cur->next, end, &prefix_len) ||
+	    decode_varint_bounded(&cur->next, end, &suffix) ||
+	    prefix_len > refname->len ||
+	    (suffix >> 1) > end - cur->next)
+		return -1;
+
+	strbuf_setlen(refname, prefix_len);
+	strbuf_add(refname, cur->next, suffix >> 1);
+	cur->next += suffix >> 1;
+	cur->nr++;
+
+	if (suffix & 1) {
+		if (cur->nr_peeled >= snapshot->binary.nr_peeled)
+			return -1;
+		*peeled = snapshot->binary.peeled + cur->nr_peeled++ * rawsz;
+	} else {
+		*peeled = NULL;
+	}
+	return 0;
+}
+
+static void binary_cursor_next_or_die(const struct snapshot *snapshot,
+				      struct binary_cursor *cur,
+				      struct strbuf *refname,
+				      const unsigned char **peeled)
+{
+	if (binary_cursor_next(snapshot, cur, refname, peeled))
+		die("packed-refs file %s is corrupt near reference %"PRIuMAX,
+		    snapshot->refs->path, (uintmax_t)cur->nr);
+}
+
+/*
+ * Move the cursor to the reference with index `nr`, leaving the refname
+ * preceding it in `refname`.
+ */
+static void binary_cursor_seek(const struct snapshot *snapshot,
+			       struct binary_cursor *cur, size_t nr,
+			       struct strbuf *refname)
+{
+	size_t restart = nr / PACKED_REFS_V2_RESTART_INTERVAL;
+	const unsigned char *r = snapshot->binary.restarts +
+		restart * PACKED_REFS_V2_RESTART_WIDTH;
+	const unsigned char *peeled;
+
+	cur->nr = restart * PACKED_REFS_V2_RESTART_INTERVAL;
+	cur->next = snapshot->binary.names + get_be32(r);
+	cur->nr_peeled = get_be32(r + 4);
+	strbuf_reset(refname);
+
+	while (cur->nr < nr)
+		binary_cursor_next_or_die(snapshot, cur, refname, &peeled);
+}
+
+/*
+ * Like `cmp_record_to_refname()`, but for the refname `name` of length
+ * `len`.
+ */
+static int cmp_name_to_refname(const char *name, size_t len,
+			       const char *refname, int start)
+{
+	const char *r1 = name, *end = name + len;
+	const char *r2 = refname;
+
+	while (1) {
+		if (r1 == end)
+			return *r2 ? -1 : 0;
+		if (!*r2)
+			return start ? 1 : -1;
+		if (*r1 != *r2)
+			return (unsigned char)*r1 < (unsigned char)*r2 ? -1 : +1;
+		r1++;
+		r2++;
+	}
+}
+
+static const char *find_binary_reference_location(struct snapshot *snapshot,
+						  const char *refname,
+						  int mustexist, int start)
+{
+	size_t rawsz = snapshot->refs->base.repo->hash_algo->rawsz;
+	size_t lo = 0, hi = DIV_ROUND_UP(snapshot->binary.nr,
+					 PACKED_REFS_V2_RESTART_INTERVAL);
+	struct strbuf name = STRBUF_INIT;
+	const unsigned char *peeled;
+	struct binary_cursor cur;
+	const char *ret = mustexist ? NULL : snapshot->eof;
+
+	if (!snapshot->binary.nr)
+		return ret;
+
+	/*
+	 * Look for the first restart point whose refname comes after
+	 * `refname`; the reference is in the block before it, if at all.
+	 */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		binary_cursor_seek(snapshot, &cur,
+				   mid * PACKED_REFS_V2_RESTART_INTERVAL, &name);
+		binary_cursor_next_or_die(snapshot, &cur, &name, &peeled);
+		if (cmp_name_to_refname(name.buf, name.len, refname, start) > 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	binary_cursor_seek(snapshot, &cur,
+			   lo ? (lo - 1) * PACKED_REFS_V2_RESTART_INTERVAL : 0,
+			   &name);
+	while (cur.nr < snapshot->binary.nr) {
+		const char *rec = snapshot->start + cur.nr * rawsz;
+		int cmp;
+
+		binary_cursor_next_or_die(snapshot, &cur, &name, &peeled);
+		cmp = cmp_name_to_refname(name.buf, name.len, refname, start);
+		if (!cmp || (cmp > 0 && !mustexist)) {
+			ret = rec;
+			break;
+		} else if (cmp > 0) {
+			break;
+		}
+	}
+
+	strbuf_release(&name);
+	return ret;
+}
+
+static const char *find_text_reference_location(struct snapshot *snapshot,
+						const char *refname,
+						int mustexist, int start)
 {
 	/*
 	 * This is not *quite* a garden-variety binary search, because
@@ -630,6 +956,17 @@ static const char *find_reference_location_1(struct snapshot *snapshot,
 		return lo;
 }
 
+static const char *find_reference_location_1(struct snapshot *snapshot,
+					     const char *refname, int mustexist,
+					     int start)
+{
+	if (snapshot->binary.enabled)
+		return find_binary_reference_location(snapshot, refname,
+						      mustexist, start);
+	return find_text_reference_location(snapshot, refname, mustexist,
+					    start);
+}
+
 /*
  * Find the place in `snapshot->buf` where the start of the record for
  * `refname` starts. If `mustexist` is true and the reference doesn't
@@ -665,6 +1002,22 @@ static const char *find_reference_location_end(struct snapshot *snapshot,
 	return find_reference_location_1(snapshot, refname, mustexist, 0);
 }
 
+/*
+ * Replace the (mmapped) buffer of the snapshot with a copy of the part
+ * of it between `start` and `eof`.
+ */
+static void copy_snapshot_buffer(struct snapshot *snapshot)
+{
+	size_t size = snapshot->eof - snapshot->start;
+	char *buf_copy = xmalloc(size);
+
+	memcpy(buf_copy, snapshot->start, size);
+	clear_snapshot_buffer(snapshot);
+	snapshot->buf = snapshot->start = buf_copy;
+	snapshot->eof = buf_copy + size;
+	snapshot->len = size;
+}
+
 /*
  * Create a newly-allocated `snapshot` of the `packed-refs` file in
  * its current state and return it. The return value will already have
@@ -710,6 +1063,17 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 	if (!load_contents(snapshot))
 		return snapshot;
 
+	if (snapshot->len >= PACKED_REFS_V2_HEADER_SIZE &&
+	    get_be32(snapshot->buf) == PACKED_REFS_V2_SIGNATURE) {
+		struct strbuf err = STRBUF_INIT;
+
+		if (mmap_strategy != MMAP_OK && snapshot->mmapped)
+			copy_snapshot_buffer(snapshot);
+		if (parse_binary_snapshot(snapshot, &err))
+			die("%s", err.buf);
+		return snapshot;
+	}
+
 	/* If the file has a header line, process it: */
 	if (snapshot->buf < snapshot->eof && *snapshot->buf == '#') {
 		char *tmp, *p, *eol;
@@ -765,13 +1129,7 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 		 * We don't want to leave the file mmapped, so we are
 		 * forced to make a copy now:
 		 */
-		size_t size = snapshot->eof - snapshot->start;
-		char *buf_copy = xmalloc(size);
-
-		memcpy(buf_copy, snapshot->start, size);
-		clear_snapshot_buffer(snapshot);
-		snapshot->buf = snapshot->start = buf_copy;
-		snapshot->eof = buf_copy + size;
+		copy_snapshot_buffer(snapshot);
 	}
 
 	return snapshot;
@@ -827,7 +1185,9 @@ static int packed_read_raw_ref(struct ref_store *ref_store, const char *refname,
 		return -1;
 	}
 
-	if (get_oid_hex_algop(rec, oid, ref_store->repo->hash_algo))
+	if (snapshot->binary.enabled)
+		oidread(oid, (const unsigned char *)rec, ref_store->repo->hash_algo);
+	else if (get_oid_hex_algop(rec, oid, ref_store->repo->hash_algo))
 		die_invalid_line(refs->path, rec, snapshot->eof - rec);
 
 	*type = REF_ISPACKED;
@@ -865,6 +1225,13 @@ struct packed_ref_iterator {
 	size_t jump_nr, jump_alloc;
 	size_t jump_cur;
 
+	/*
+	 * For a snapshot in the binary format, where decoding the
+	 * refnames left off; `refname_buf` holds the refname preceding
+	 * `cursor.next`, if the latter is set.
+	 */
+	struct binary_cursor cursor;
+
 	/* Scratch space for current values: */
 	struct object_id oid, peeled;
 	struct strbuf refname_buf;
@@ -878,12 +1245,52 @@ struct packed_ref_iterator {
  * `iter` and return `ITER_OK` or `ITER_DONE`. This function does not free the
  * iterator in the case of `ITER_DONE`.
  */
+static int next_binary_record(struct packed_ref_iterator *iter)
+{
+	struct snapshot *snapshot = iter->snapshot;
+	const struct git_hash_algo *algo = iter->repo->hash_algo;
+	size_t nr = (iter->pos - snapshot->start) / algo->rawsz;
+	const unsigned char *peeled;
+
+	if (!iter->cursor.next || iter->cursor.nr != nr)
+		binary_cursor_seek(snapshot, &iter->cursor, nr,
+				   &iter->refname_buf);
+	binary_cursor_next_or_die(snapshot, &iter->cursor, &iter->refname_buf,
+				  &peeled);
+
+	/* All references are peeled in this format. */
+	iter->base.flags = REF_ISPACKED | REF_KNOWS_PEELED;
+	iter->base.refname = iter->refname_buf.buf;
+	oidread(&iter->oid, (const unsigned char *)iter->pos, algo);
+
+	if (refname_contains_nul(&iter->refname_buf))
+		die("packed refname contains embedded NULL: %s", iter->base.refname);
+
+	if (check_refname_format(iter->base.refname, REFNAME_ALLOW_ONELEVEL)) {
+		if (!refname_is_safe(iter->base.refname))
+			die("packed refname is dangerous: %s",
+			    iter->base.refname);
+		oidclr(&iter->oid, algo);
+		iter->base.flags |= REF_BAD_NAME | REF_ISBROKEN;
+	}
+
+	if (!peeled) {
+		oidclr(&iter->peeled, algo);
+	} else if ((iter->base.flags & REF_ISBROKEN)) {
+		oidclr(&iter->peeled, algo);
+		iter->base.flags &= ~REF_KNOWS_PEELED;
+	} else {
+		oidread(&iter->peeled, peeled, algo);
+	}
+
+	iter->pos += algo->rawsz;
+	return ITER_OK;
+}
+
 static int next_record(struct packed_ref_iterator *iter)
 {
 	const char *p, *eol;
 
-	strbuf_reset(&iter->refname_buf);
-
 	/*
 	 * If iter->pos is contained within a skipped region, jump past
 	 * it.
@@ -908,6 +1315,10 @@ static int next_record(struct packed_ref_iterator *iter)
 	if (iter->pos == iter->eof)
 		return ITER_DONE;
 
+	if (iter->snapshot->binary.enabled)
+		return next_binary_record(iter);
+
+	strbuf_reset(&iter->refname_buf);
 	iter->base.flags = REF_ISPACKED;
 	p = iter->pos;
 
@@ -1019,6 +1430,7 @@ static int packed_ref_iterator_seek(struct ref_iterator *ref_iterator,
 	iter->prefix = xstrdup_or_null(prefix);
 	iter->pos = start;
 	iter->eof = iter->snapshot->eof;
+	iter->jump_cur = 0;
 
 	return 0;
 }
@@ -1203,15 +1615,164 @@ static struct ref_iterator *packed_ref_iterator_begin(
 }
 
 /*
- * Write an entry to the packed-refs file for the specified refname.
- * If peeled is non-NULL, write it as the entry's peeled value. On
- * error, return a nonzero value and leave errno set at the value left
- * by the failing call to `fprintf()`.
+ * The contents of a `packed-refs` file in the binary format, as they
+ * are being collected to be written out.
+ *
+ * Unlike the text format, which is streamed to the tempfile one line
+ * at a time, the whole file is held in memory until all references
+ * have been seen: the table of contents at the start of a chunk file
+ * records the offset of every chunk, and these are only known once the
+ * last reference has been added. The memory used is about the size of
+ * the resulting file, i.e. the raw object name of every reference and
+ * of every peeled tag plus the prefix-compressed refnames; for a few
+ * million references this amounts to some hundred megabytes.
  */
-static int write_packed_entry(FILE *fh, const char *refname,
+struct binary_packed_refs {
+	const struct git_hash_algo *algo;
+	struct strbuf oids, names, restarts, peeled;
+	struct strbuf last_refname;
+	size_t nr, nr_peeled;
+};
+
+#define BINARY_PACKED_REFS_INIT { \
+	.oids = STRBUF_INIT, \
+	.names = STRBUF_INIT, \
+	.restarts = STRBUF_INIT, \
+	.peeled = STRBUF_INIT, \
+	.last_refname = STRBUF_INIT, \
+}
+
+static void binary_packed_refs_release(struct binary_packed_refs *binary)
+{
+	strbuf_release(&binary->oids);
+	strbuf_release(&binary->names);
+	strbuf_release(&binary->restarts);
+	strbuf_release(&binary->peeled);
+	strbuf_release(&binary->last_refname);
+}
+
+static int add_binary_packed_entry(struct binary_packed_refs *binary,
+				   const char *refname,
+				   const struct object_id *oid,
+				   const struct object_id *peeled)
+{
+	unsigned char buf[16];
+	size_t len = strlen(refname), prefix_len = 0;
+
+	if (!(binary->nr % PACKED_REFS_V2_RESTART_INTERVAL)) {
+		if (binary->names.len > UINT32_MAX ||
+		    binary->nr_peeled > UINT32_MAX) {
+			errno = EFBIG;
+			return -1;
+		}
+		put_be32(buf, binary->names.len);
+		put_be32(buf + 4, binary->nr_peeled);
+		strbuf_add(&binary->restarts, buf, PACKED_REFS_V2_RESTART_WIDTH);
+	} else {
+		while (prefix_len < len && prefix_len < binary->last_refname.len &&
+		       refname[prefix_len] == binary->last_refname.buf[prefix_len])
+			prefix_len++;
+	}
+
+	strbuf_add(&binary->names, buf, encode_varint(prefix_len, buf));
+	strbuf_add(&binary->names, buf,
+		   encode_varint(((uintmax_t)(len - prefix_len) << 1) | !!peeled,
+				 buf));
+	strbuf_add(&binary->names, refname + prefix_len, len - prefix_len);
+	strbuf_add(&binary->oids, oid->hash, binary->algo->rawsz);
+	if (peeled) {
+		strbuf_add(&binary->peeled, peeled->hash, binary->algo->rawsz);
+		binary->nr_peeled++;
+	}
+
+	strbuf_reset(&binary->last_refname);
+	strbuf_add(&binary->last_refname, refname, len);
+	binary->nr++;
+	return 0;
+}
+
+/*
+ * Hash `len` bytes of `buf` into `ctx` and write them to `fd`. Return -1
+ * with errno set on error.
+ */
+static int write_binary_hashed(int fd, struct git_hash_ctx *ctx,
+			       const void *buf, size_t len)
+{
+	git_hash_update(ctx, buf, len);
+	return write_in_full(fd, buf, len) < 0 ? -1 : 0;
+}
+
+/*
+ * Write the collected references to `fd` as a `packed-refs` file in the
+ * binary format, laid out as write_chunkfile() would. It is written with
+ * write_in_full() rather than through a hashfile, which dies on errors:
+ * like write_packed_entry(), return -1 with errno set and leave reporting
+ * the error to the caller. Syncing the file is left to the caller, too.
+ */
+static int write_binary_packed_refs(struct binary_packed_refs *binary, int fd)
+{
+	const struct {
+		uint32_t id;
+		const struct strbuf *data;
+	} chunks[] = {
+		{ PACKED_REFS_V2_CHUNKID_OIDS, &binary->oids },
+		{ PACKED_REFS_V2_CHUNKID_NAMES, &binary->names },
+		{ PACKED_REFS_V2_CHUNKID_RESTARTS, &binary->restarts },
+		{ PACKED_REFS_V2_CHUNKID_PEELED, &binary->peeled },
+	};
+	unsigned char buf[CHUNK_TOC_ENTRY_SIZE];
+	unsigned char hash[GIT_MAX_RAWSZ];
+	struct git_hash_ctx ctx;
+	uint64_t offset = PACKED_REFS_V2_HEADER_SIZE +
+			  (ARRAY_SIZE(chunks) + 1) * CHUNK_TOC_ENTRY_SIZE;
+	size_t i;
+
+	binary->algo->init_fn(&ctx);
+
+	put_be32(buf, PACKED_REFS_V2_SIGNATURE);
+	buf[4] = PACKED_REFS_V2_VERSION;
+	buf[5] = oid_version(binary->algo);
+	buf[6] = ARRAY_SIZE(chunks);
+	buf[7] = 0; /* reserved */
+	if (write_binary_hashed(fd, &ctx, buf, PACKED_REFS_V2_HEADER_SIZE))
+		return -1;
+
+	for (i = 0; i <= ARRAY_SIZE(chunks); i++) {
+		/* The trailing entry marks the end of the chunks. */
+		put_be32(buf, i < ARRAY_SIZE(chunks) ? chunks[i].id : 0);
+		put_be64(buf + 4, offset);
+		if (write_binary_hashed(fd, &ctx, buf, CHUNK_TOC_ENTRY_SIZE))
+			return -1;
+		if (i < ARRAY_SIZE(chunks))
+			offset += chunks[i].data->len;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++)
+		if (write_binary_hashed(fd, &ctx, chunks[i].data->buf,
+					chunks[i].data->len))
+			return -1;
+
+	git_hash_final(hash, &ctx);
+	if (write_in_full(fd, hash, binary->algo->rawsz) < 0)
+		return -1;
+	return 0;
+}
+
+/*
+ * Write an entry to the packed-refs file for the specified refname,
+ * or add it to `binary` if the file is in the binary format. If peeled
+ * is non-NULL, write it as the entry's peeled value. On error, return a
+ * nonzero value and leave errno set at the value left by the failing
+ * call to `fprintf()`.
+ */
+static int write_packed_entry(FILE *fh, struct binary_packed_refs *binary,
+			      const char *refname,
 			      const struct object_id *oid,
 			      const struct object_id *peeled)
 {
+	if (binary)
+		return add_binary_packed_entry(binary, refname, oid, peeled);
+
 	if (fprintf(fh, "%s %s\n", oid_to_hex(oid), refname) < 0 ||
 	    (peeled && fprintf(fh, "^%s\n", oid_to_hex(peeled)) < 0))
 		return -1;
@@ -1371,11 +1932,18 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 	int ok;
 	FILE *out;
 	struct strbuf sb = STRBUF_INIT;
+	struct binary_packed_refs binary_refs = BINARY_PACKED_REFS_INIT;
+	struct binary_packed_refs *binary = NULL;
 	char *packed_refs_path;
 
 	if (!is_lock_file_locked(&refs->lock))
 		BUG("write_with_updates() called while unlocked");
 
+	if (refs->base.repo->repository_format_packed_refs_v2) {
+		binary_refs.algo = refs->base.repo->hash_algo;
+		binary = &binary_refs;
+	}
+
 	/*
 	 * If packed-refs is a symlink, we want to overwrite the
 	 * symlinked-to file, not the symlink itself. Also, put the
@@ -1400,7 +1968,7 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 		goto error;
 	}
 
-	if (fprintf(out, "%s", PACKED_REFS_HEADER) < 0)
+	if (!binary && fprintf(out, "%s", PACKED_REFS_HEADER) < 0)
 		goto write_error;
 
 	/*
@@ -1522,7 +2090,7 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 			struct object_id peeled;
 			int peel_error = ref_iterator_peel(iter, &peeled);
 
-			if (write_packed_entry(out, iter->refname,
+			if (write_packed_entry(out, binary, iter->refname,
 					       iter->oid,
 					       peel_error ? NULL : &peeled))
 				goto write_error;
@@ -1546,7 +2114,7 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 						     &update->new_oid,
 						     &peeled);
 
-			if (write_packed_entry(out, update->refname,
+			if (write_packed_entry(out, binary, update->refname,
 					       &update->new_oid,
 					       peel_error ? NULL : &peeled))
 				goto write_error;
@@ -1561,6 +2129,11 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 		goto error;
 	}
 
+	if (binary &&
+	    write_binary_packed_refs(binary, get_tempfile_fd(refs->tempfile)))
+		goto write_error;
+	binary_packed_refs_release(&binary_refs);
+
 	if (fflush(out) ||
 	    fsync_component(FSYNC_COMPONENT_REFERENCE, get_tempfile_fd(refs->tempfile)) ||
 	    close_tempfile_gently(refs->tempfile)) {
@@ -1581,6 +2154,7 @@ write_error:
 
 error:
 	ref_iterator_free(iter);
+	binary_packed_refs_release(&binary_refs);
 	delete_tempfile(&refs->tempfile);
 	return ret;
 }
@@ -2062,6 +2636,102 @@ static int packed_fsck_ref_content(struct fsck_options *o,
 	return ret;
 }
 
+static int packed_fsck_binary(struct fsck_options *o,
+			      struct snapshot *snapshot)
+{
+	const struct git_hash_algo *algo = snapshot->refs->base.repo->hash_algo;
+	struct strbuf packed_entry = STRBUF_INIT;
+	struct fsck_ref_report report = { 0 };
+	struct strbuf refname = STRBUF_INIT;
+	struct strbuf previous = STRBUF_INIT;
+	struct strbuf err = STRBUF_INIT;
+	struct binary_cursor cur = { 0 };
+	const unsigned char *peeled;
+	int ret = 0;
+
+	report.path = "packed-refs";
+	if (parse_binary_snapshot(snapshot, &err)) {
+		ret = fsck_report_ref(o, &report,
+				      FSCK_MSG_BAD_PACKED_REF_HEADER,
+				      "%s", err.buf);
+		goto cleanup;
+	}
+	if (!hashfile_checksum_valid(algo, (const unsigned char *)snapshot->buf,
+				     snapshot->len)) {
+		ret = fsck_report_ref(o, &report,
+				      FSCK_MSG_BAD_PACKED_REF_HEADER,
+				      "has an invalid checksum");
+		goto cleanup;
+	}
+
+	cur.next = snapshot->binary.names;
+	while (cur.nr < snapshot->binary.nr) {
+		strbuf_reset(&packed_entry);
+		strbuf_addf(&packed_entry, "packed-refs entry %"PRIuMAX,
+			    (uintmax_t)cur.nr);
+		report.path = packed_entry.buf;
+
+		if (!(cur.nr % PACKED_REFS_V2_RESTART_INTERVAL)) {
+			const unsigned char *r = snapshot->binary.restarts +
+				cur.nr / PACKED_REFS_V2_RESTART_INTERVAL *
+				PACKED_REFS_V2_RESTART_WIDTH;
+
+			if (get_be32(r) != cur.next - snapshot->binary.names ||
+			    get_be32(r + 4) != cur.nr_peeled) {
+				ret = fsck_report_ref(o, &report,
+						      FSCK_MSG_BAD_PACKED_REF_ENTRY,
+						      "does not match its restart point");
+				goto cleanup;
+			}
+			strbuf_reset(&refname);
+		}
+
+		if (binary_cursor_next(snapshot, &cur, &refname, &peeled)) {
+			ret = fsck_report_ref(o, &report,
+					      FSCK_MSG_BAD_PACKED_REF_ENTRY,
+					      "cannot be decoded");
+			goto cleanup;
+		}
+
+		if (refname_contains_nul(&refname))
+			ret |= fsck_report_ref(o, &report,
+					       FSCK_MSG_BAD_PACKED_REF_ENTRY,
+					       "refname '%s' contains NULL binaries",
+					       refname.buf);
+		if (check_refname_format(refname.buf, 0))
+			ret |= fsck_report_ref(o, &report,
+					       FSCK_MSG_BAD_REF_NAME,
+					       "has bad refname '%s'", refname.buf);
+
+		if (cur.nr > 1 &&
+		    cmp_name_to_refname(refname.buf, refname.len,
+					previous.buf, 1) <= 0) {
+			ret = fsck_report_ref(o, &report,
+					      FSCK_MSG_PACKED_REF_UNSORTED,
+					      "refname '%s' is less than previous refname '%s'",
+					      refname.buf, previous.buf);
+			goto cleanup;
+		}
+		strbuf_reset(&previous);
+		strbuf_addbuf(&previous, &refname);
+	}
+
+	if (cur.next != snapshot->binary.names + snapshot->binary.names_len ||
+	    cur.nr_peeled != snapshot->binary.nr_peeled) {
+		report.path = "packed-refs";
+		ret = fsck_report_ref(o, &report,
+				      FSCK_MSG_BAD_PACKED_REF_ENTRY,
+				      "has data past its last reference");
+	}
+
+cleanup:
+	strbuf_release(&packed_entry);
+	strbuf_release(&refname);
+	strbuf_release(&previous);
+	strbuf_release(&err);
+	return ret;
+}
+
 static int packed_fsck(struct ref_store *ref_store,
 		       struct fsck_options *o,
 		       struct worktree *wt)
@@ -2121,6 +2791,13 @@ static int packed_fsck(struct ref_store *ref_store,
 		goto cleanup;
 	}
 
+	if (snapshot.len >= PACKED_REFS_V2_HEADER_SIZE &&
+	    get_be32(snapshot.buf) == PACKED_REFS_V2_SIGNATURE) {
+		snapshot.refs = refs;
+		ret = packed_fsck_binary(o, &snapshot);
+		goto cleanup;
+	}
+
 	ret = packed_fsck_ref_content(o, ref_store, &sorted, snapshot.start,
 				      snapshot.eof);
 	if (!ret && sorted)
@@ -2,9 +2,11 @@
 #include "../hash.h"
 #include "../refs.h"
 #include "../repository.h"
+#include "../strbuf.h"
 #include "refs-internal.h"
 #include "ref-cache.h"
 #include "../iterator.h"
+#include "../strvec.h"
 
 void add_entry_to_dir(struct ref_dir *dir, struct ref_entry *entry)
 {
@@ -290,12 +292,26 @@ static enum prefix_state overlaps_prefix(const char *dirname,
 		return PREFIX_EXCLUDES_DIR;
 }
 
+/*
+ * Return true if all references in the directory `dirname` match one
+ * of the NULL-terminated `exclude_patterns`.
+ */
+static int is_excluded_dir(const char *dirname, const char **exclude_patterns)
+{
+	for (; *exclude_patterns; exclude_patterns++)
+		if (starts_with(dirname, *exclude_patterns))
+			return 1;
+	return 0;
+}
+
 /*
  * Load all of the refs from `dir` (recursively) that could possibly
  * contain references matching `prefix` into our in-memory cache. If
- * `prefix` is NULL, prime unconditionally.
+ * `prefix` is NULL, prime unconditionally. Directories that are
+ * excluded as a whole by `exclude_patterns` are never loaded.
  */
-static void prime_ref_dir(struct ref_dir *dir, const char *prefix)
+static void prime_ref_dir(struct ref_dir *dir, const char *prefix,
+			  const char **exclude_patterns)
 {
 	/*
 	 * The hard work of loading loose refs is done by get_ref_dir(), so we
@@ -308,9 +324,11 @@ static void prime_ref_dir(struct ref_dir *dir, const char *prefix)
 		struct ref_entry *entry = dir->entries[i];
 		if (!(entry->flag & REF_DIR)) {
 			/* Not a directory; no need to recurse. */
+		} else if (is_excluded_dir(entry->name, exclude_patterns)) {
+			/* No need to prime this directory. */
 		} else if (!prefix) {
 			/* Recurse in any case: */
-			prime_ref_dir(get_ref_dir(entry), NULL);
+			prime_ref_dir(get_ref_dir(entry), NULL, exclude_patterns);
 		} else {
 			switch (overlaps_prefix(entry->name, prefix)) {
 			case PREFIX_CONTAINS_DIR:
@@ -319,10 +337,12 @@ static void prime_ref_dir(struct ref_dir *dir, const char *prefix)
 				 * don't have to check the prefix
 				 * anymore:
 				 */
-				prime_ref_dir(get_ref_dir(entry), NULL);
+				prime_ref_dir(get_ref_dir(entry), NULL,
+					      exclude_patterns);
 				break;
 			case PREFIX_WITHIN_DIR:
-				prime_ref_dir(get_ref_dir(entry), prefix);
+				prime_ref_dir(get_ref_dir(entry), prefix,
+					      exclude_patterns);
 				break;
 			case PREFIX_EXCLUDES_DIR:
 				/* No need to prime this directory. */
@@ -376,6 +396,14 @@ struct cache_ref_iterator {
 	 */
 	char *prefix;
 
+	/*
+	 * Skip the directories whose references all match one of these
+	 * patterns. Patterns with glob characters are left out; the
+	 * caller has to filter references anyway, so this is only an
+	 * optimization.
+	 */
+	struct strvec exclude_patterns;
+
 	/*
 	 * A stack of levels. levels[0] is the uppermost level that is
 	 * being iterated over in this iteration. (This is not
@@ -430,6 +458,9 @@ static int cache_ref_iterator_advance(struct ref_iterator *ref_iterator)
 		}
 
 		if (entry->flag & REF_DIR) {
+			if (is_excluded_dir(entry->name, iter->exclude_patterns.v))
+				continue;
+
 			/* push down a level */
 			ALLOC_GROW(iter->levels, iter->levels_nr + 1,
 				   iter->levels_alloc);
@@ -465,7 +496,7 @@ static int cache_ref_iterator_seek(struct ref_iterator *ref_iterator,
 	}
 
 	if (iter->prime_dir)
-		prime_ref_dir(dir, prefix);
+		prime_ref_dir(dir, prefix, iter->exclude_patterns.v);
 	iter->levels_nr = 1;
 	level = &iter->levels[0];
 	level->index = -1;
@@ -497,6 +528,7 @@ static void cache_ref_iterator_release(struct ref_iterator *ref_iterator)
 		(struct cache_ref_iterator *)ref_iterator;
 	free(iter->prefix);
 	free(iter->levels);
+	strvec_clear(&iter->exclude_patterns);
 }
 
 static struct ref_iterator_vtable cache_ref_iterator_vtable = {
@@ -508,6 +540,7 @@ static struct ref_iterator_vtable cache_ref_iterator_vtable = {
 
 struct ref_iterator *cache_ref_iterator_begin(struct ref_cache *cache,
 					      const char *prefix,
+					      const char **exclude_patterns,
 					      struct repository *repo,
 					      int prime_dir)
 {
@@ -519,6 +552,11 @@ struct ref_iterator *cache_ref_iterator_begin(struct ref_cache *cache,
 	base_ref_iterator_init(ref_iterator, &cache_ref_iterator_vtable);
 	ALLOC_GROW(iter->levels, 10, iter->levels_alloc);
 
+	strvec_init(&iter->exclude_patterns);
+	for (; exclude_patterns && *exclude_patterns; exclude_patterns++)
+		if (!has_glob_specials(*exclude_patterns))
+			strvec_push(&iter->exclude_patterns, *exclude_patterns);
+
 	iter->repo = repo;
 	iter->cache = cache;
 	iter->prime_dir = prime_dir;
@@ -211,12 +211,15 @@ struct ref_entry *find_ref_entry(struct ref_dir *dir, const char *refname);
 /*
  * Start iterating over references in `cache`. If `prefix` is
  * specified, only include references whose names start with that
- * prefix. If `prime_dir` is true, then fill any incomplete
- * directories before beginning the iteration. The output is ordered
- * by refname.
+ * prefix. Directories whose references all match one of the
+ * `exclude_patterns` (if any) are skipped without being loaded, but
+ * the caller still has to filter out other excluded references. If
+ * `prime_dir` is true, then fill any incomplete directories before
+ * beginning the iteration. The output is ordered by refname.
  */
 struct ref_iterator *cache_ref_iterator_begin(struct ref_cache *cache,
 					      const char *prefix,
+					      const char **exclude_patterns,
 					      struct repository *repo,
 					      int prime_dir);
 
@@ -460,6 +460,23 @@ struct ref_iterator *prefix_ref_iterator_begin(struct ref_iterator *iter0,
 					       const char *prefix,
 					       int trim);
 
+/*
+ * Wrap iter0, which must already be positioned at `prefixes[0]`, and
+ * yield the references whose names start with any of the NULL-terminated
+ * `prefixes`. Whenever iter0 runs out of references for one prefix, it
+ * is seeked to the next one, so that references between the prefixes
+ * are never looked at. The prefixes must be sorted, and none of them
+ * may be a prefix of another, for the references to come out sorted.
+ * The new iterator takes over ownership of iter0 and makes its own
+ * copy of the prefixes. Seeking it to a prefix replaces the prefixes
+ * with that one.
+ *
+ * As a convenience to callers, if there is a single prefix, this
+ * function returns iter0 directly, without wrapping it.
+ */
+struct ref_iterator *prefixes_ref_iterator_begin(struct ref_iterator *iter0,
+						 const char **prefixes);
+
 /* Internal implementation of reference iteration: */
 
 /*
@@ -21,6 +21,7 @@
 #include "../reftable/reftable-error.h"
 #include "../reftable/reftable-iterator.h"
 #include "../repo-settings.h"
+#include "../run-command.h"
 #include "../setup.h"
 #include "../strmap.h"
 #include "../trace2.h"
@@ -37,6 +38,10 @@
 struct reftable_backend {
 	struct reftable_stack *stack;
 	struct reftable_iterator it;
+	/* The repository of the ref store and the directory hosting the stack. */
+	struct repository *repo;
+	char *gitdir;
+	unsigned compaction_spawned : 1;
 };
 
 static void reftable_backend_on_reload(void *payload)
@@ -45,14 +50,61 @@ static void reftable_backend_on_reload(void *payload)
 	reftable_iterator_destroy(&be->it);
 }
 
+/*
+ * The stack has outgrown "reftable.detachCompactionThreshold", so instead of
+ * making the writer wait for the compaction we let a detached maintenance
+ * process take care of it, honoring "maintenance.autoDetach" like
+ * run_auto_maintenance() does. It is fine for the compaction to not happen at
+ * all, e.g. because another maintenance process holds the lock: the next
+ * write will ask again.
+ */
+static void reftable_backend_on_compaction_deferred(void *payload)
+{
+	struct reftable_backend *be = payload;
+	struct child_process cmd = CHILD_PROCESS_INIT;
+	int detach;
+
+	if (be->compaction_spawned)
+		return;
+	be->compaction_spawned = 1;
+
+	if (repo_config_get_bool(be->repo, "maintenance.autodetach", &detach) &&
+	    repo_config_get_bool(be->repo, "gc.autodetach", &detach))
+		detach = 1;
+
+	cmd.git_cmd = 1;
+	cmd.no_stdin = 1;
+	cmd.no_stdout = 1;
+	strvec_pushf(&cmd.env, "%s=%s", GIT_DIR_ENVIRONMENT, be->gitdir);
+	strvec_pushl(&cmd.args, "maintenance", "run", "--auto", "--quiet",
+		     detach ? "--detach" : "--no-detach", "--task=pack-refs", NULL);
+	if (run_command(&cmd))
+		warning(_("unable to compact references in the background"));
+}
+
 static int reftable_backend_init(struct reftable_backend *be,
+				 struct repository *repo,
 				 const char *path,
 				 const struct reftable_write_options *_opts)
 {
 	struct reftable_write_options opts = *_opts;
+	size_t len;
+	int ret;
+
+	if (!strip_suffix(path, "/reftable", &len))
+		BUG("reftable stack outside of a repository: %s", path);
+	be->repo = repo;
+	be->gitdir = xstrndup(path, len);
+
 	opts.on_reload = reftable_backend_on_reload;
 	opts.on_reload_payload = be;
-	return reftable_new_stack(&be->stack, path, &opts);
+	opts.on_compaction_deferred = reftable_backend_on_compaction_deferred;
+	opts.on_compaction_deferred_payload = be;
+
+	ret = reftable_new_stack(&be->stack, path, &opts);
+	if (ret)
+		FREE_AND_NULL(be->gitdir);
+	return ret;
 }
 
 static void reftable_backend_release(struct reftable_backend *be)
@@ -60,6 +112,7 @@ static void reftable_backend_release(struct reftable_backend *be)
 	reftable_stack_destroy(be->stack);
 	be->stack = NULL;
 	reftable_iterator_destroy(&be->it);
+	FREE_AND_NULL(be->gitdir);
 }
 
 static int reftable_backend_read_ref(struct reftable_backend *be,
@@ -228,7 +281,8 @@ static int backend_for(struct reftable_backend **out,
 				    store->base.repo->commondir, wtname_buf.buf);
 
 			CALLOC_ARRAY(be, 1);
-			store->err = reftable_backend_init(be, wt_dir.buf,
+			store->err = reftable_backend_init(be, store->base.repo,
+							   wt_dir.buf,
 							   &store->write_options);
 			assert(store->err != REFTABLE_API_ERROR);
 
@@ -336,6 +390,8 @@ static int reftable_be_config(const char *var, const char *value,
 		if (factor > UINT8_MAX)
 			die("reftable geometric factor cannot exceed %u", (unsigned)UINT8_MAX);
 		opts->auto_compaction_factor = factor;
+	} else if (!strcmp(var, "reftable.detachcompactionthreshold")) {
+		opts->auto_compaction_max_bytes = git_config_ulong(var, value, ctx->kvi);
 	} else if (!strcmp(var, "reftable.locktimeout")) {
 		int64_t lock_timeout = git_config_int64(var, value, ctx->kvi);
 		if (lock_timeout > LONG_MAX)
@@ -411,7 +467,7 @@ static struct ref_store *reftable_be_init(struct repository *repo,
 		strbuf_realpath(&path, gitdir, 0);
 	}
 	strbuf_addstr(&path, "/reftable");
-	refs->err = reftable_backend_init(&refs->main_backend, path.buf,
+	refs->err = reftable_backend_init(&refs->main_backend, repo, path.buf,
 					  &refs->write_options);
 	if (refs->err)
 		goto done;
@@ -428,8 +484,8 @@ static struct ref_store *reftable_be_init(struct repository *repo,
 		strbuf_reset(&path);
 		strbuf_addf(&path, "%s/reftable", gitdir);
 
-		refs->err = reftable_backend_init(&refs->worktree_backend, path.buf,
-						  &refs->write_options);
+		refs->err = reftable_backend_init(&refs->worktree_backend, repo,
+						  path.buf, &refs->write_options);
 		if (refs->err)
 			goto done;
 	}
@@ -727,6 +783,8 @@ static int reftable_ref_iterator_seek(struct ref_iterator *ref_iterator,
 	free(iter->prefix);
 	iter->prefix = xstrdup_or_null(prefix);
 	iter->prefix_len = prefix ? strlen(prefix) : 0;
+	iter->exclude_patterns_index = 0;
+	iter->exclude_patterns_strlen = 0;
 	iter->err = reftable_iterator_seek_ref(&iter->iter, prefix);
 
 	return iter->err;
@@ -349,6 +349,166 @@ done:
 	return err;
 }
 
+/* Upper bound for the inflated data a block cache holds on to. */
+#define BLOCK_CACHE_MAX_BYTES (1024 * 1024)
+
+struct block_cache_entry {
+	uint64_t off;
+	unsigned char *data;
+	uint32_t len;
+	uint32_t full_block_size;
+	uint32_t restart_off;
+	uint16_t restart_count;
+	uint64_t last_used;
+	/* One reference for the cache and one for each block using it. */
+	size_t refcount;
+};
+
+struct block_cache {
+	struct block_cache_entry **entries;
+	size_t nr, alloc;
+	size_t bytes;
+	uint64_t tick;
+};
+
+static void block_cache_entry_put(struct block_cache_entry *e)
+{
+	if (--e->refcount)
+		return;
+	reftable_free(e->data);
+	reftable_free(e);
+}
+
+static void block_cache_release_data(void *arg,
+				     struct reftable_block_data *dest REFTABLE_UNUSED)
+{
+	block_cache_entry_put(arg);
+}
+
+/*
+ * Blocks served from the cache point their data at this source so that
+ * releasing them drops their reference to the cache entry.
+ */
+static struct reftable_block_source_vtable block_cache_vtable = {
+	.release_data = &block_cache_release_data,
+};
+
+static void block_cache_use(struct block_cache *cache,
+			    struct block_cache_entry *e,
+			    struct reftable_block *block)
+{
+	e->refcount++;
+	e->last_used = ++cache->tick;
+	block->block_data.data = e->data;
+	block->block_data.len = e->len;
+	block->block_data.source.ops = &block_cache_vtable;
+	block->block_data.source.arg = e;
+}
+
+static void block_cache_evict(struct block_cache *cache, size_t want)
+{
+	while (cache->nr && cache->bytes + want > BLOCK_CACHE_MAX_BYTES) {
+		size_t lru = 0;
+
+		for (size_t i = 1; i < cache->nr; i++)
+			if (cache->entries[i]->last_used < cache->entries[lru]->last_used)
+				lru = i;
+
+		cache->bytes -= cache->entries[lru]->len;
+		block_cache_entry_put(cache->entries[lru]);
+		cache->entries[lru] = cache->entries[--cache->nr];
+	}
+}
+
+/*
+ * Hand the inflated data of the freshly initialized log block over to the
+ * cache. Failing to do so is not an error, the block simply stays uncached.
+ */
+static void block_cache_add(struct block_cache **cachep, uint64_t off,
+			    struct reftable_block *block)
+{
+	struct block_cache *cache = *cachep;
+	struct block_cache_entry *e;
+
+	if (block->block_data.len > BLOCK_CACHE_MAX_BYTES / 4)
+		return;
+
+	if (!cache) {
+		REFTABLE_CALLOC_ARRAY(cache, 1);
+		if (!cache)
+			return;
+		*cachep = cache;
+	}
+
+	block_cache_evict(cache, block->block_data.len);
+	if (REFTABLE_ALLOC_GROW(cache->entries, cache->nr + 1, cache->alloc))
+		return;
+	REFTABLE_CALLOC_ARRAY(e, 1);
+	if (!e)
+		return;
+
+	e->off = off;
+	e->data = block->uncompressed_data;
+	e->len = block->block_data.len;
+	e->full_block_size = block->full_block_size;
+	e->restart_off = block->restart_off;
+	e->restart_count = block->restart_count;
+	e->refcount = 1;
+	cache->entries[cache->nr++] = e;
+	cache->bytes += e->len;
+
+	/* The cache owns the buffer now, the block merely refers to it. */
+	block->uncompressed_data = NULL;
+	block->uncompressed_cap = 0;
+	block_cache_use(cache, e, block);
+}
+
+int block_init_cached(struct reftable_block *block, struct block_cache **cachep,
+		      struct reftable_block_source *source,
+		      uint32_t offset, uint32_t header_size,
+		      uint32_t table_block_size, uint32_t hash_size,
+		      uint8_t want_type)
+{
+	struct block_cache *cache = *cachep;
+	int err;
+
+	if (cache && (want_type == REFTABLE_BLOCK_TYPE_LOG ||
+		      want_type == REFTABLE_BLOCK_TYPE_ANY)) {
+		for (size_t i = 0; i < cache->nr; i++) {
+			struct block_cache_entry *e = cache->entries[i];
+
+			if (e->off != offset)
+				continue;
+
+			block_source_release_data(&block->block_data);
+			block_cache_use(cache, e, block);
+			block->block_type = REFTABLE_BLOCK_TYPE_LOG;
+			block->hash_size = hash_size;
+			block->header_off = header_size;
+			block->restart_off = e->restart_off;
+			block->restart_count = e->restart_count;
+			block->full_block_size = e->full_block_size;
+			return 0;
+		}
+	}
+
+	err = reftable_block_init(block, source, offset, header_size,
+				  table_block_size, hash_size, want_type);
+	if (!err && block->block_type == REFTABLE_BLOCK_TYPE_LOG)
+		block_cache_add(cachep, offset, block);
+	return err;
+}
+
+void block_cache_free(struct block_cache *cache)
+{
+	if (!cache)
+		return;
+	for (size_t i = 0; i < cache->nr; i++)
+		block_cache_entry_put(cache->entries[i]);
+	reftable_free(cache->entries);
+	reftable_free(cache);
+}
+
 void reftable_block_release(struct reftable_block *block)
 {
 	inflateEnd(block->zstream);
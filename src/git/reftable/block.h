@@ -63,6 +63,29 @@ int block_writer_finish(struct block_writer *w);
 /* clears out internally allocated block_writer members. */
 void block_writer_release(struct block_writer *bw);
 
+/*
+ * A cache of inflated log blocks, keyed by their offset in the table. Log
+ * blocks are stored deflated, so without it every iterator that passes a log
+ * block inflates it again.
+ */
+struct block_cache;
+
+/*
+ * Like reftable_block_init(), but take log blocks from `*cachep` when they are
+ * in there and add them to it otherwise. The cache is allocated on first use.
+ */
+int block_init_cached(struct reftable_block *block, struct block_cache **cachep,
+		      struct reftable_block_source *source,
+		      uint32_t offset, uint32_t header_size,
+		      uint32_t table_block_size, uint32_t hash_size,
+		      uint8_t want_type);
+
+/*
+ * Free the cache. Blocks that still use cached data keep it alive until they
+ * are released.
+ */
+void block_cache_free(struct block_cache *cache);
+
 /* Iterator for records contained in a single block. */
 struct block_iter {
 	/* offset within the block of the next entry to read. */
@@ -130,6 +130,26 @@ static struct reftable_block_source_vtable file_vtable = {
 	.close = &file_close,
 };
 
+void block_source_will_need(struct reftable_block_source *source REFTABLE_UNUSED,
+			    uint64_t off REFTABLE_UNUSED,
+			    uint64_t len REFTABLE_UNUSED)
+{
+#ifdef MADV_WILLNEED
+	struct file_block_source *b = source->arg;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	uint64_t start;
+
+	if (source->ops != &file_vtable || pagesize <= 0 || off >= b->size)
+		return;
+	if (len > b->size - off)
+		len = b->size - off;
+
+	/* The mapping is page-aligned, the range has to be as well. */
+	start = off - off % pagesize;
+	madvise(b->data + start, len + off - start, MADV_WILLNEED);
+#endif
+}
+
 int reftable_block_source_from_file(struct reftable_block_source *bs,
 				    const char *name)
 {
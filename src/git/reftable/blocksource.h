@@ -39,6 +39,13 @@ uint64_t block_source_size(struct reftable_block_source *source);
  */
 void block_source_release_data(struct reftable_block_data *data);
 
+/*
+ * Hint that the range of the source will be read soon. This is a no-op unless
+ * the source maps a file and the platform knows about madvise(2).
+ */
+void block_source_will_need(struct reftable_block_source *source,
+			    uint64_t off, uint64_t len);
+
 /* Create an in-memory block source for reading reftables. */
 void block_source_from_buf(struct reftable_block_source *bs,
 			   struct reftable_buf *buf);
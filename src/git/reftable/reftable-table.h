@@ -28,6 +28,8 @@ struct reftable_table_offsets {
 	uint64_t index_offset;
 };
 
+struct block_cache;
+
 /* The table struct is a handle to an open reftable file. */
 struct reftable_table {
 	/* for convenience, associate a name with the instance. */
@@ -51,6 +53,9 @@ struct reftable_table {
 	struct reftable_table_offsets obj_offsets;
 	struct reftable_table_offsets log_offsets;
 
+	/* Inflated log blocks, see block.h. */
+	struct block_cache *log_cache;
+
 	uint64_t refcount;
 };
 
@@ -52,6 +52,18 @@ struct reftable_write_options {
 	 */
 	uint8_t auto_compaction_factor;
 
+	/*
+	 * The maximum number of bytes that auto-compaction merges when
+	 * committing an addition. When restoring the geometric sequence would
+	 * require merging more than that, the compaction is skipped and
+	 * `on_compaction_deferred` is invoked instead so that the caller can
+	 * arrange for reftable_stack_auto_compact() to run elsewhere, e.g. in
+	 * a background process. Defaults to no limit if unset.
+	 */
+	uint64_t auto_compaction_max_bytes;
+	void (*on_compaction_deferred)(void *payload);
+	void *on_compaction_deferred_payload;
+
 	/*
 	 * The number of milliseconds to wait when trying to lock "tables.list".
 	 * Note that this does not apply to locking individual tables, as these
@@ -25,6 +25,7 @@ static int stack_write_compact(struct reftable_stack *st,
 			       struct reftable_writer *wr,
 			       size_t first, size_t last,
 			       struct reftable_log_expiry_config *config);
+static int stack_auto_compact(struct reftable_stack *st, uint64_t max_bytes);
 static void reftable_addition_close(struct reftable_addition *add);
 static int reftable_stack_reload_maybe_reuse(struct reftable_stack *st,
 					     int reuse_open);
@@ -843,7 +844,8 @@ int reftable_addition_commit(struct reftable_addition *add)
 		 * `REFTABLE_LOCK_ERROR` because parts of the stack are locked
 		 * already. This is a benign error though, so we ignore it.
 		 */
-		err = reftable_stack_auto_compact(add->stack);
+		err = stack_auto_compact(add->stack,
+					 add->stack->opts.auto_compaction_max_bytes);
 		if (err < 0 && err != REFTABLE_LOCK_ERROR)
 			goto done;
 		err = 0;
@@ -1660,7 +1662,12 @@ static uint64_t *stack_table_sizes_for_compaction(struct reftable_stack *st)
 	return sizes;
 }
 
-int reftable_stack_auto_compact(struct reftable_stack *st)
+/*
+ * Restore the geometric sequence of the stack. If that requires merging more
+ * than `max_bytes` (unless 0), then leave the stack alone and tell the caller
+ * via the `on_compaction_deferred` callback.
+ */
+static int stack_auto_compact(struct reftable_stack *st, uint64_t max_bytes)
 {
 	struct segment seg;
 	uint64_t *sizes;
@@ -1676,11 +1683,22 @@ int reftable_stack_auto_compact(struct reftable_stack *st)
 					 st->opts.auto_compaction_factor);
 	reftable_free(sizes);
 
-	if (segment_size(&seg) > 0)
-		return stack_compact_range(st, seg.start, seg.end - 1,
-					   NULL, STACK_COMPACT_RANGE_BEST_EFFORT);
+	if (!segment_size(&seg))
+		return 0;
 
-	return 0;
+	if (max_bytes && seg.bytes > max_bytes) {
+		if (st->opts.on_compaction_deferred)
+			st->opts.on_compaction_deferred(st->opts.on_compaction_deferred_payload);
+		return 0;
+	}
+
+	return stack_compact_range(st, seg.start, seg.end - 1,
+				   NULL, STACK_COMPACT_RANGE_BEST_EFFORT);
+}
+
+int reftable_stack_auto_compact(struct reftable_stack *st)
+{
+	return stack_auto_compact(st, 0);
 }
 
 struct reftable_compaction_stats *
@@ -172,8 +172,9 @@ int table_init_block(struct reftable_table *t, struct reftable_block *block,
 	if (next_off >= t->size)
 		return 1;
 
-	err = reftable_block_init(block, &t->source, next_off, header_off,
-				  t->block_size, hash_size(t->hash_id), want_typ);
+	err = block_init_cached(block, &t->log_cache, &t->source, next_off,
+				header_off, t->block_size, hash_size(t->hash_id),
+				want_typ);
 	if (err)
 		reftable_block_release(block);
 	return err;
@@ -581,6 +582,19 @@ int reftable_table_new(struct reftable_table **out,
 	if (err)
 		goto done;
 
+	/*
+	 * Every indexed seek for a ref starts out in the ref index, so have it
+	 * paged in while we are busy with other things.
+	 */
+	if (t->ref_offsets.index_offset) {
+		uint64_t end = t->obj_offsets.is_present ? t->obj_offsets.offset :
+			       t->log_offsets.is_present ? t->log_offsets.offset :
+			       t->size;
+		if (end > t->ref_offsets.index_offset)
+			block_source_will_need(source, t->ref_offsets.index_offset,
+					       end - t->ref_offsets.index_offset);
+	}
+
 	*out = t;
 
 done:
@@ -606,6 +620,7 @@ void reftable_table_decref(struct reftable_table *t)
 		return;
 	if (--t->refcount)
 		return;
+	block_cache_free(t->log_cache);
 	block_source_close(&t->source);
 	REFTABLE_FREE_AND_NULL(t->name);
 	reftable_free(t);
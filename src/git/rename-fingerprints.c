@@ -0,0 +1,482 @@
+#include "git-compat-util.h"
+#include "rename-fingerprints.h"
+#include "chunk-format.h"
+#include "config.h"
+#include "csum-file.h"
+#include "diffcore.h"
+#include "gettext.h"
+#include "hash-lookup.h"
+#include "lockfile.h"
+#include "object-file.h"
+#include "object-store.h"
+#include "oid-array.h"
+#include "packfile.h"
+#include "path.h"
+#include "progress.h"
+#include "repository.h"
+#include "trace2.h"
+#include "xdiff-interface.h"
+
+/*
+ * The file is a chunk file with the header that map_chunk_file() in
+ * chunk-format.h reads.  The chunks are:
+ *
+ *   OIDF: the usual 256-entry fanout of the sorted blob names
+ *   OIDL: the sorted blob names
+ *   FPEN: for each blob, 32-bit flags, the 32-bit number of its spans
+ *         and the 64-bit position of its first span in FPSP
+ *   FPSP: the spans of all the fingerprints, each a 32-bit hash value
+ *         followed by a 32-bit count, sorted by hash value per blob
+ *
+ * All integers are in network byte order.
+ */
+#define RFP_SIGNATURE 0x52465054 /* "RFPT" */
+#define RFP_VERSION 1
+
+#define RFP_CHUNKID_OIDFANOUT 0x4f494446 /* "OIDF" */
+#define RFP_CHUNKID_OIDLOOKUP 0x4f49444c /* "OIDL" */
+#define RFP_CHUNKID_ENTRIES 0x4650454e /* "FPEN" */
+#define RFP_CHUNKID_SPANS 0x46505350 /* "FPSP" */
+
+#define RFP_ENTRY_WIDTH 16
+#define RFP_SPAN_WIDTH 8
+
+/* buffer_is_binary() said the contents are binary */
+#define RFP_FLAG_BINARY (1u << 0)
+
+/*
+ * Small blobs are cheap to read and hash again, and there are many of
+ * them; only remember the larger ones so that the cache stays small.
+ */
+#define RFP_MIN_BLOB_SIZE 4096
+
+struct rename_fingerprints {
+	const unsigned char *data;
+	size_t data_len;
+	unsigned hash_len;
+
+	uint32_t num_blobs;
+	uint64_t num_spans;
+	const uint32_t *chunk_oid_fanout;
+	const unsigned char *chunk_oid_lookup;
+	const unsigned char *chunk_entries;
+	const unsigned char *chunk_spans;
+};
+
+static char *rename_fingerprints_filename(struct repository *r)
+{
+	return xstrfmt("%s/info/rename-fingerprints", r->objects->odb->path);
+}
+
+static void free_rename_fingerprints(struct rename_fingerprints *rf)
+{
+	if (!rf)
+		return;
+	munmap((void *)rf->data, rf->data_len);
+	free(rf);
+}
+
+static struct rename_fingerprints *load_rename_fingerprints(struct repository *r,
+							    const char *path)
+{
+	struct rename_fingerprints *rf;
+	struct chunkfile *cf;
+	const unsigned char *data;
+	size_t data_len, chunk_size;
+
+	cf = map_chunk_file(r, path, "rename-fingerprints", RFP_SIGNATURE,
+			    RFP_VERSION, &data, &data_len);
+	if (!cf)
+		return NULL;
+
+	CALLOC_ARRAY(rf, 1);
+	rf->data = data;
+	rf->data_len = data_len;
+	rf->hash_len = r->hash_algo->rawsz;
+
+	if (pair_oid_fanout_chunk(cf, RFP_CHUNKID_OIDFANOUT,
+				  "rename-fingerprints",
+				  &rf->chunk_oid_fanout, &rf->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, RFP_CHUNKID_OIDLOOKUP, &rf->chunk_oid_lookup,
+		       &chunk_size) ||
+	    chunk_size != st_mult(rf->hash_len, rf->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, RFP_CHUNKID_ENTRIES, &rf->chunk_entries,
+		       &chunk_size) ||
+	    chunk_size != st_mult(RFP_ENTRY_WIDTH, rf->num_blobs))
+		goto corrupt;
+	if (pair_chunk(cf, RFP_CHUNKID_SPANS, &rf->chunk_spans, &chunk_size) ||
+	    chunk_size % RFP_SPAN_WIDTH)
+		goto corrupt;
+	rf->num_spans = chunk_size / RFP_SPAN_WIDTH;
+
+	free_chunkfile(cf);
+	return rf;
+
+corrupt:
+	error(_("rename-fingerprints file %s is corrupt"), path);
+	free_chunkfile(cf);
+	free_rename_fingerprints(rf);
+	return NULL;
+}
+
+static struct rename_fingerprints *prepare_rename_fingerprints(struct repository *r)
+{
+	struct raw_object_store *o = r->objects;
+	int enabled = 1;
+	char *path;
+
+	if (o->rename_fingerprints_attempted)
+		return o->rename_fingerprints;
+	o->rename_fingerprints_attempted = 1;
+
+	repo_config_get_bool(r, "diff.renamefingerprints", &enabled);
+	if (!enabled)
+		return NULL;
+
+	path = rename_fingerprints_filename(r);
+	o->rename_fingerprints = load_rename_fingerprints(r, path);
+	free(path);
+	if (o->rename_fingerprints)
+		trace2_data_intmax("diff", r, "rename_fingerprints/blobs",
+				   o->rename_fingerprints->num_blobs);
+	return o->rename_fingerprints;
+}
+
+void close_rename_fingerprints(struct raw_object_store *o)
+{
+	free_rename_fingerprints(o->rename_fingerprints);
+	o->rename_fingerprints = NULL;
+	o->rename_fingerprints_attempted = 0;
+}
+
+/*
+ * Find the entry for 'oid', returning its flags and the location and
+ * number of its spans, or -1 if there is none.
+ */
+static int find_fingerprint(struct rename_fingerprints *rf,
+			    const struct object_id *oid, uint32_t *flags,
+			    const unsigned char **spans, uint32_t *nr)
+{
+	const unsigned char *entry;
+	uint64_t offset;
+	uint32_t pos;
+
+	if (!bsearch_hash(oid->hash, rf->chunk_oid_fanout,
+			  rf->chunk_oid_lookup, rf->hash_len, &pos))
+		return -1;
+
+	entry = rf->chunk_entries + st_mult(RFP_ENTRY_WIDTH, pos);
+	*flags = get_be32(entry);
+	*nr = get_be32(entry + 4);
+	offset = get_be64(entry + 8);
+	if (offset > rf->num_spans || *nr > rf->num_spans - offset)
+		return -1;
+	*spans = rf->chunk_spans + st_mult(RFP_SPAN_WIDTH, offset);
+	return 0;
+}
+
+void *lookup_rename_fingerprint(struct repository *r,
+				struct diff_filespec *one)
+{
+	struct rename_fingerprints *rf;
+	struct spanhash_top *top;
+	const unsigned char *spans;
+	uint32_t flags, nr, i;
+	int binary;
+
+	if (!one->oid_valid || !S_ISREG(one->mode))
+		return NULL;
+	rf = prepare_rename_fingerprints(r);
+	if (!rf || find_fingerprint(rf, &one->oid, &flags, &spans, &nr))
+		return NULL;
+
+	/*
+	 * The fingerprint ignores CRs in CRLF only when the contents
+	 * are hashed as text; attributes may say otherwise for this
+	 * path, and then we have to hash it ourselves.
+	 */
+	binary = !!(flags & RFP_FLAG_BINARY);
+	if (diff_filespec_is_binary_hint(r, one, binary) != binary)
+		return NULL;
+
+	top = xmalloc(st_add(sizeof(*top),
+			     st_mult(sizeof(struct spanhash), st_add(nr, 1))));
+	top->alloc_log2 = 0;
+	top->free = 0;
+	for (i = 0; i < nr; i++) {
+		top->data[i].hashval = get_be32(spans);
+		top->data[i].cnt = get_be32(spans + 4);
+		spans += RFP_SPAN_WIDTH;
+	}
+	top->data[nr].hashval = 0;
+	top->data[nr].cnt = 0;
+	return top;
+}
+
+struct write_rename_fingerprints_context {
+	struct repository *r;
+	struct rename_fingerprints *old;
+	/*
+	 * When the old file was written; objects in packs and loose files
+	 * older than that have been looked at already
+	 */
+	time_t since;
+	struct oid_array candidates;
+
+	/* the blobs that made it into the new cache, in order */
+	struct oid_array blobs;
+	struct rfp_entry {
+		uint32_t flags;
+		uint32_t nr;
+		uint64_t offset;
+	} *entries;
+	size_t entries_alloc;
+
+	/* spans of all the fingerprints, already in network byte order */
+	struct strbuf spans;
+	uint64_t total_spans;
+
+	struct progress *progress;
+};
+
+static int add_loose_candidate(const struct object_id *oid,
+			       const char *path, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+	struct stat st;
+
+	if (ctx->since && !lstat(path, &st) && st.st_mtime < ctx->since)
+		return 0;
+	oid_array_append(&ctx->candidates, oid);
+	return 0;
+}
+
+static int add_packed_candidate(const struct object_id *oid,
+				struct packed_git *pack UNUSED,
+				uint32_t pos UNUSED, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+	oid_array_append(&ctx->candidates, oid);
+	return 0;
+}
+
+/*
+ * Collect the objects that have to be looked at: those the old file
+ * knows that still exist, and the local ones that may have appeared
+ * since it was written.  Looking up the type and size of every other
+ * object again on each run would make the task as slow as the number
+ * of objects, instead of the number of new ones.
+ */
+static void collect_candidates(struct write_rename_fingerprints_context *ctx)
+{
+	struct packed_git *p;
+	uint32_t i;
+
+	if (ctx->old) {
+		for (i = 0; i < ctx->old->num_blobs; i++) {
+			struct object_id oid;
+
+			oidread(&oid, ctx->old->chunk_oid_lookup +
+				      st_mult(ctx->old->hash_len, i),
+				ctx->r->hash_algo);
+			if (has_object(ctx->r, &oid, 0))
+				oid_array_append(&ctx->candidates, &oid);
+		}
+	}
+
+	for_each_loose_object(add_loose_candidate, ctx,
+			      FOR_EACH_OBJECT_LOCAL_ONLY);
+	for (p = get_all_packs(ctx->r); p; p = p->next) {
+		if (!p->pack_local || (ctx->since && p->mtime < ctx->since))
+			continue;
+		if (open_pack_index(p))
+			continue;
+		for_each_object_in_pack(p, add_packed_candidate, ctx, 0);
+	}
+	oid_array_sort(&ctx->candidates);
+}
+
+static void add_span(struct write_rename_fingerprints_context *ctx,
+		     uint32_t hashval, uint32_t cnt)
+{
+	unsigned char buf[RFP_SPAN_WIDTH];
+
+	put_be32(buf, hashval);
+	put_be32(buf + 4, cnt);
+	strbuf_add(&ctx->spans, buf, sizeof(buf));
+}
+
+static void add_fingerprint(struct write_rename_fingerprints_context *ctx,
+			    const struct object_id *oid)
+{
+	const unsigned char *old_spans;
+	struct rfp_entry *e;
+	uint32_t flags, nr;
+	enum object_type type;
+	unsigned long size;
+
+	if (ctx->old &&
+	    !find_fingerprint(ctx->old, oid, &flags, &old_spans, &nr)) {
+		strbuf_add(&ctx->spans, old_spans,
+			   st_mult(RFP_SPAN_WIDTH, nr));
+	} else {
+		struct spanhash_top *top;
+		void *buf;
+
+		type = oid_object_info(ctx->r, oid, &size);
+		if (type != OBJ_BLOB || size < RFP_MIN_BLOB_SIZE ||
+		    size > repo_settings_get_big_file_threshold(ctx->r))
+			return;
+		buf = repo_read_object_file(ctx->r, oid, &type, &size);
+		if (!buf)
+			return;
+
+		flags = buffer_is_binary(buf, size) ? RFP_FLAG_BINARY : 0;
+		top = diffcore_fingerprint_buffer(buf, size,
+						  !(flags & RFP_FLAG_BINARY));
+		for (nr = 0; top->data[nr].cnt; nr++)
+			add_span(ctx, top->data[nr].hashval, top->data[nr].cnt);
+		free(top);
+		free(buf);
+	}
+
+	ALLOC_GROW(ctx->entries, ctx->blobs.nr + 1, ctx->entries_alloc);
+	e = &ctx->entries[ctx->blobs.nr];
+	e->flags = flags;
+	e->nr = nr;
+	e->offset = ctx->total_spans;
+	ctx->total_spans += nr;
+	oid_array_append(&ctx->blobs, oid);
+}
+
+static int write_rfp_chunk_oid_fanout(struct hashfile *f, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+
+	write_oid_fanout_chunk(f, &ctx->blobs);
+	return 0;
+}
+
+static int write_rfp_chunk_oid_lookup(struct hashfile *f, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->blobs.nr; i++)
+		hashwrite(f, ctx->blobs.oid[i].hash, ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_rfp_chunk_entries(struct hashfile *f, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+	size_t i;
+
+	for (i = 0; i < ctx->blobs.nr; i++) {
+		hashwrite_be32(f, ctx->entries[i].flags);
+		hashwrite_be32(f, ctx->entries[i].nr);
+		hashwrite_be64(f, ctx->entries[i].offset);
+	}
+	return 0;
+}
+
+static int write_rfp_chunk_spans(struct hashfile *f, void *data)
+{
+	struct write_rename_fingerprints_context *ctx = data;
+
+	hashwrite(f, ctx->spans.buf, ctx->spans.len);
+	return 0;
+}
+
+int write_rename_fingerprints(struct repository *r, unsigned flags)
+{
+	struct write_rename_fingerprints_context ctx = {
+		.r = r,
+		.candidates = OID_ARRAY_INIT,
+		.blobs = OID_ARRAY_INIT,
+		.spans = STRBUF_INIT,
+	};
+	struct lock_file lk = LOCK_INIT;
+	struct chunkfile *cf;
+	struct hashfile *f;
+	char *path = rename_fingerprints_filename(r);
+	time_t start = time(NULL);
+	struct stat st;
+	size_t i;
+	int ret = 0;
+
+	if (safe_create_leading_directories(r, path)) {
+		ret = error(_("unable to create leading directories of %s"),
+			    path);
+		goto out;
+	}
+	ctx.old = load_rename_fingerprints(r, path);
+	if (ctx.old && !stat(path, &st))
+		ctx.since = st.st_mtime;
+
+	collect_candidates(&ctx);
+	trace2_data_intmax("maintenance", r, "rename_fingerprints/candidates",
+			   ctx.candidates.nr);
+
+	if (flags & RENAME_FINGERPRINTS_PROGRESS)
+		ctx.progress = start_delayed_progress(r,
+					_("Computing rename fingerprints"),
+					ctx.candidates.nr);
+	for (i = 0; i < ctx.candidates.nr; i++) {
+		display_progress(ctx.progress, i + 1);
+		if (i && oideq(&ctx.candidates.oid[i - 1],
+			       &ctx.candidates.oid[i]))
+			continue;
+		add_fingerprint(&ctx, &ctx.candidates.oid[i]);
+	}
+	stop_progress(&ctx.progress);
+
+	f = hold_chunk_file(r, &lk, path);
+
+	cf = init_chunkfile(f);
+	add_chunk(cf, RFP_CHUNKID_OIDFANOUT, CHUNK_OID_FANOUT_SIZE,
+		  write_rfp_chunk_oid_fanout);
+	add_chunk(cf, RFP_CHUNKID_OIDLOOKUP,
+		  st_mult(r->hash_algo->rawsz, ctx.blobs.nr),
+		  write_rfp_chunk_oid_lookup);
+	add_chunk(cf, RFP_CHUNKID_ENTRIES,
+		  st_mult(RFP_ENTRY_WIDTH, ctx.blobs.nr),
+		  write_rfp_chunk_entries);
+	add_chunk(cf, RFP_CHUNKID_SPANS, ctx.spans.len,
+		  write_rfp_chunk_spans);
+
+	write_chunk_file(cf, RFP_SIGNATURE, RFP_VERSION, r->hash_algo, &ctx);
+	free_chunkfile(cf);
+
+	/* let go of the old file before it is replaced */
+	free_rename_fingerprints(ctx.old);
+	ctx.old = NULL;
+	close_rename_fingerprints(r->objects);
+
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	if (commit_lock_file(&lk)) {
+		ret = error_errno(_("unable to write %s"), path);
+	} else {
+		/*
+		 * Date the file back to when we started listing objects,
+		 * so that the next run also looks at the objects that
+		 * appeared while we were at it.
+		 */
+		struct utimbuf t = { .actime = start, .modtime = start };
+
+		if (utime(path, &t))
+			warning_errno(_("unable to set the time of %s"), path);
+	}
+
+out:
+	free_rename_fingerprints(ctx.old);
+	oid_array_clear(&ctx.candidates);
+	oid_array_clear(&ctx.blobs);
+	free(ctx.entries);
+	strbuf_release(&ctx.spans);
+	free(path);
+	return ret;
+}
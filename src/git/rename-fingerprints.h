@@ -0,0 +1,37 @@
+#ifndef RENAME_FINGERPRINTS_H
+#define RENAME_FINGERPRINTS_H
+
+struct repository;
+struct raw_object_store;
+struct diff_filespec;
+
+/*
+ * The rename fingerprint cache remembers, for the larger blobs of the
+ * repository, the fingerprint diffcore_count_changes() compares when
+ * looking for inexact renames and copies, so that rename detection
+ * does not have to read and hash those blobs again.  It lives in
+ * "$GIT_DIR/objects/info/rename-fingerprints" and is written by the
+ * "rename-fingerprints" task of git-maintenance(1).
+ */
+
+#define RENAME_FINGERPRINTS_PROGRESS (1 << 0)
+
+/*
+ * Write the cache for every local blob that is worth remembering,
+ * reusing what the existing cache already knows.  Returns 0 on
+ * success and a negative value after reporting an error.
+ */
+int write_rename_fingerprints(struct repository *r, unsigned flags);
+
+/*
+ * Return the cached fingerprint of 'one', in a newly allocated buffer
+ * suitable for one->cnt_data, or NULL if the cache does not know it
+ * (or knows it for contents of a different binary-ness than 'one' is
+ * treated as).  The size of 'one' must already be populated.
+ */
+void *lookup_rename_fingerprint(struct repository *r,
+				struct diff_filespec *one);
+
+void close_rename_fingerprints(struct raw_object_store *o);
+
+#endif /* RENAME_FINGERPRINTS_H */
@@ -31,6 +31,7 @@ struct repo_settings {
 	int commit_graph_changed_paths_version;
 	int gc_write_commit_graph;
 	int fetch_write_commit_graph;
+	int commit_graph_file_history;
 	int command_requires_full_index;
 	int sparse_index;
 	int pack_read_reverse_index;
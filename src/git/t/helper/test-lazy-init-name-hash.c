@@ -16,6 +16,7 @@ static int dump;
 static int perf;
 static int analyze;
 static int analyze_step;
+static int lookup;
 
 /*
  * Dump the contents of the "dir" and "name" hash tables to stdout.
@@ -25,7 +26,7 @@ static int analyze_step;
 static void dump_run(void)
 {
 	struct hashmap_iter iter_dir;
-	struct hashmap_iter iter_cache;
+	unsigned int i;
 
 	/* Stolen from name-hash.c */
 	struct dir_entry {
@@ -52,9 +53,11 @@ static void dump_run(void)
 				ent /* member name */)
 		printf("dir %08x %7d %s\n", dir->ent.hash, dir->nr, dir->name);
 
-	hashmap_for_each_entry(&the_repository->index->name_hash, &iter_cache, ce,
-				ent /* member name */)
-		printf("name %08x %s\n", ce->ent.hash, ce->name);
+	for (i = 0; i < the_repository->index->cache_nr; i++) {
+		ce = the_repository->index->cache[i];
+		if ((ce->ce_flags & CE_HASHED) && !S_ISSPARSEDIR(ce->ce_mode))
+			printf("name %08x %s\n", ce->ent.hash, ce->name);
+	}
 
 	discard_index(the_repository->index);
 }
@@ -108,6 +111,54 @@ static uint64_t time_runs(int try_threaded)
 	return avg;
 }
 
+/*
+ * Look up the name of every index entry, and a name next to it that
+ * is not in the index, case-insensitively "count" times and report on
+ * the time taken.
+ */
+static void lookup_run(void)
+{
+	struct index_state *istate = the_repository->index;
+	struct strbuf miss = STRBUF_INIT;
+	uint64_t t0, t1;
+	uint64_t sum = 0;
+	unsigned int k;
+	int i, found;
+
+	repo_read_index(the_repository);
+	test_lazy_init_name_hash(istate, 0);
+
+	for (i = 0; i < count; i++) {
+		found = 0;
+		t0 = getnanotime();
+		for (k = 0; k < istate->cache_nr; k++) {
+			const struct cache_entry *ce = istate->cache[k];
+
+			strbuf_reset(&miss);
+			strbuf_add(&miss, ce->name, ce_namelen(ce));
+			strbuf_addstr(&miss, ".orig");
+			if (index_file_exists(istate, ce->name, ce_namelen(ce), 1))
+				found++;
+			if (index_file_exists(istate, miss.buf, miss.len, 1))
+				found++;
+		}
+		t1 = getnanotime();
+		sum += (t1 - t0);
+
+		printf("%f %d %d lookup\n",
+			   ((double)(t1 - t0))/1000000000,
+			   istate->cache_nr, found);
+		fflush(stdout);
+	}
+
+	if (count > 1)
+		printf("avg %f lookup\n",
+			   (double)(sum / count)/1000000000);
+
+	strbuf_release(&miss);
+	discard_index(istate);
+}
+
 /*
  * Try a series of runs varying the "istate->cache_nr" and
  * try to find a good value for the multi-threaded criteria.
@@ -196,6 +247,7 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 		"test-tool lazy-init-name-hash -a a [--step s] [-c c]",
 		"test-tool lazy-init-name-hash (-s | -m) [-c c]",
 		"test-tool lazy-init-name-hash -s -m [-c c]",
+		"test-tool lazy-init-name-hash -l [-c c]",
 		NULL
 	};
 	struct option options[] = {
@@ -206,6 +258,7 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 		OPT_BOOL('p', "perf", &perf, "compare single vs multi"),
 		OPT_INTEGER('a', "analyze", &analyze, "analyze different multi sizes"),
 		OPT_INTEGER(0, "step", &analyze_step, "analyze step factor"),
+		OPT_BOOL('l', "lookup", &lookup, "time lookups"),
 		OPT_END(),
 	};
 	const char *prefix;
@@ -245,6 +298,13 @@ int cmd__lazy_init_name_hash(int argc, const char **argv)
 		return 0;
 	}
 
+	if (lookup) {
+		if (dump || perf || analyze > 0 || single || multi)
+			die("cannot combine lookup with other modes");
+		lookup_run();
+		return 0;
+	}
+
 	if (analyze) {
 		if (analyze < 500)
 			die("analyze must be at least 500");
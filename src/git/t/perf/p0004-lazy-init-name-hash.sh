@@ -53,4 +53,8 @@ test_perf "multi-threaded, $desc" --prereq REPO_BIG_ENOUGH_FOR_MULTI "
 	test-tool lazy-init-name-hash --multi --count=$count
 "
 
+test_perf "lookups, $desc" "
+	test-tool lazy-init-name-hash --lookup --count=$count
+"
+
 test_done
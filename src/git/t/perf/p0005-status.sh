@@ -46,4 +46,9 @@ test_perf "read-tree status br_ballast ($nr_files)" '
 	git status
 '
 
+test_perf "read-tree status br_ballast, 64 preload threads ($nr_files)" '
+	git read-tree HEAD &&
+	git -c core.preloadIndexThreads=64 status
+'
+
 test_done
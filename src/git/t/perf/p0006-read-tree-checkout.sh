@@ -62,6 +62,15 @@ test_perf "switch between br_base br_ballast ($nr_files)" '
 	git checkout -q br_ballast
 '
 
+test_perf "read-tree br_base br_ballast, prefetching trees ($nr_files)" '
+	git -c core.treePrefetchThreads=0 read-tree -n -m br_base br_ballast
+'
+
+test_perf "switch between br_base br_ballast, prefetching trees ($nr_files)" '
+	git -c core.treePrefetchThreads=0 checkout -q br_base &&
+	git -c core.treePrefetchThreads=0 checkout -q br_ballast
+'
+
 test_perf "switch between br_ballast br_ballast_plus_1 ($nr_files)" '
 	git checkout -q br_ballast_plus_1 &&
 	git checkout -q br_ballast
@@ -30,4 +30,25 @@ test_perf "update-ref --stdin" '
 	git update-ref --stdin <instructions >/dev/null
 '
 
+# A stack of two similarly sized tables, which the next write has to merge.
+test_expect_success "setup unbalanced stack" '
+	test_seq 1 1000000 |
+	sed "s|.*|create refs/heads/many/& PRE|" >many-refs &&
+	git clone --ref-format=reftable . unbalanced &&
+	GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+	git -C unbalanced update-ref --stdin <many-refs &&
+	sed "s|many|more|" many-refs |
+	GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+	git -C unbalanced update-ref --stdin
+'
+
+for threshold in 0 1m
+do
+	test_perf "update-ref with reftable.detachCompactionThreshold=$threshold" \
+		--setup "rm -rf repo && cp -R unbalanced repo" "
+		git -C repo -c reftable.detachCompactionThreshold=$threshold \
+			-c maintenance.autoDetach=true update-ref refs/heads/push PRE
+	"
+done
+
 test_done
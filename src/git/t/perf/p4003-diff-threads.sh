@@ -0,0 +1,31 @@
+#!/bin/sh
+
+test_description='Tests diff.threads and diff.renameThreads'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+for threads in 1 4 0
+do
+	test_perf "log -p -n500 (diff.threads=$threads)" "
+		git -c diff.threads=$threads log -p -n500 >/dev/null
+	"
+done
+
+test_perf 'diff-tree -r -p across 500 commits (diff.threads=1)' '
+	git -c diff.threads=1 diff-tree -r -p HEAD~500 HEAD >/dev/null
+'
+
+test_perf 'diff-tree -r -p across 500 commits (diff.threads=0)' '
+	git -c diff.threads=0 diff-tree -r -p HEAD~500 HEAD >/dev/null
+'
+
+for threads in 1 0
+do
+	test_perf "diff-tree -M -l0 across 500 commits (diff.renameThreads=$threads)" "
+		git -c diff.renameThreads=$threads diff-tree -r -M -l0 \
+			HEAD~500 HEAD >/dev/null
+	"
+done
+
+test_done
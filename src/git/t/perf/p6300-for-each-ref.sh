@@ -68,6 +68,11 @@ run_tests () {
 	test_for_each_ref "$1, tags, no sort" --no-sort refs/tags/
 	test_for_each_ref "$1, tags, dereferenced" '--format="%(refname) %(objectname) %(*objectname)"' refs/tags/
 	test_for_each_ref "$1, tags, dereferenced, no sort" --no-sort '--format="%(refname) %(objectname) %(*objectname)"' refs/tags/
+	test_for_each_ref "$1, objectsize" '--format="%(refname) %(objectsize)"'
+	test_for_each_ref "$1, objectsize, no sort" --no-sort '--format="%(refname) %(objectsize)"'
+	test_for_each_ref "$1, subject" '--format="%(refname) %(contents:subject)"'
+	test_for_each_ref "$1, subject, no sort" --no-sort '--format="%(refname) %(contents:subject)"'
+	test_for_each_ref "$1, sort by committerdate" --sort=committerdate '--format="%(refname) %(contents:subject)"'
 
 	test_perf "for-each-ref ($1, tags) + cat-file --batch-check (dereferenced)" "
 		for i in \$(test_seq $test_iteration_count); do
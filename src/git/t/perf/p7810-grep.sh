@@ -20,4 +20,29 @@ test_perf 'grep --cached, expensive regex' '
 	git grep --cached "^.* *some_nonexistent_string$" || :
 '
 
+
+# Count down from the number of CPUs, halving each time, so that the
+# last run uses them all even if their number is not a power of 2.
+test_expect_success 'set up thread-counting tests' '
+	t=$(test-tool online-cpus) &&
+	threads= &&
+	while test $t -gt 0
+	do
+		threads="$t $threads" &&
+		t=$((t / 2)) || return 1
+	done
+'
+
+for t in $threads
+do
+	THREADS=$t
+	export THREADS
+	test_perf "grep HEAD, cheap regex, $t threads" '
+		git grep --threads=$THREADS some_nonexistent_string HEAD || :
+	'
+	test_perf "grep HEAD, many matches, $t threads" '
+		git grep --threads=$THREADS -c -e a HEAD >/dev/null || :
+	'
+done
+
 test_done
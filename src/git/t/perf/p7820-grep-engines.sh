@@ -32,6 +32,7 @@ for pattern in \
 	'^how to' \
 	'[how] to' \
 	'\(e.t[^ ]*\|v.ry\) rare' \
+	'return.*\(ENOMEM\|ENOSPC\)' \
 	'm\(ú\|u\)lt.b\(æ\|y\)te'
 do
 	for engine in basic extended perl
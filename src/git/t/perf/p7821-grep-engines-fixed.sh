@@ -21,7 +21,8 @@ then
 	test_set_prereq PERF_GREP_ENGINES_THREADS
 fi
 
-for pattern in 'int' 'uncommon' 'æ'
+for pattern in 'int' 'uncommon' 'æ' '-e uncommon -e rarely' \
+	'-e uncommon --and -e int'
 do
 	for engine in fixed basic extended perl
 	do
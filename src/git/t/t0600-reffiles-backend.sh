@@ -499,4 +499,31 @@ test_expect_success 'symref transaction supports false symlink config' '
 	test_cmp expect actual
 '
 
+test_expect_success 'ref transaction: core.fsyncMethod=batch flushes once' '
+	test_when_finished "rm -rf repo trace2.txt" &&
+	git init repo &&
+	test_commit -C repo initial &&
+	test_seq 10 | sed "s,.*,create refs/heads/batch-& HEAD," >stdin &&
+
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" \
+	GIT_TEST_FSYNC=true \
+		git -C repo -c core.fsync=reference \
+		-c core.fsyncMethod=batch update-ref --stdin <stdin &&
+	sed -n \
+		-e "/^{\"event\":\"counter\",.*\"category\":\"fsync\",/ {
+			s/.*\"category\":\"fsync\",//;
+			s/}$//;
+			p;
+		}" \
+		<trace2.txt >actual &&
+	cat >expect <<-\EOF &&
+	"name":"writeout-only","count":10
+	"name":"hardware-flush","count":1
+	EOF
+	test_cmp expect actual &&
+	git -C repo for-each-ref --format="%(refname)" "refs/heads/batch-*" >refs &&
+	test_line_count = 10 refs &&
+	test_path_is_missing repo/.git/bulk_fsync_*
+'
+
 test_done
@@ -355,6 +355,36 @@ test_expect_success 'ref transaction: env var disables compaction' '
 	test_line_count -lt $expected repo/.git/reftable/tables.list
 '
 
+test_expect_success 'ref transaction: large compactions are left to maintenance' '
+	test_when_finished "rm -rf repo" &&
+
+	git init repo &&
+	test_commit -C repo A &&
+	for i in $(test_seq 5)
+	do
+		GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+		git -C repo update-ref branch-$i HEAD || return 1
+	done &&
+	git -C repo config maintenance.autoDetach false &&
+
+	git -C repo config reftable.detachCompactionThreshold 1m &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-inline" git -C repo update-ref foo HEAD &&
+	test_subcommand ! git maintenance run --auto --quiet --no-detach --task=pack-refs <trace-inline &&
+	test_line_count = 1 repo/.git/reftable/tables.list &&
+
+	for i in $(test_seq 5)
+	do
+		GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+		git -C repo update-ref refs/heads/new-$i HEAD || return 1
+	done &&
+	start=$(wc -l <repo/.git/reftable/tables.list) &&
+
+	git -C repo config reftable.detachCompactionThreshold 1 &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-detached" git -C repo update-ref bar HEAD &&
+	test_subcommand git maintenance run --auto --quiet --no-detach --task=pack-refs <trace-detached &&
+	test_line_count -lt $start repo/.git/reftable/tables.list
+'
+
 test_expect_success 'ref transaction: alternating table sizes are compacted' '
 	test_when_finished "rm -rf repo" &&
 
@@ -416,4 +416,30 @@ test_expect_success '-m references the correct modified tree' '
 	test_cmp expect actual
 '
 
+test_expect_success 'read-tree -m -u with tree prefetching' '
+	git reset --hard initial-mod &&
+	mkdir -p dir1/sub dir2 dir3 &&
+	for d in dir1 dir1/sub dir2 dir3
+	do
+		echo "$d one" >$d/file || return 1
+	done &&
+	git add dir1 dir2 dir3 &&
+	git commit -m "prefetch base" &&
+	git branch prefetch-base &&
+	for d in dir1/sub dir2 dir3
+	do
+		echo "$d two" >$d/file || return 1
+	done &&
+	git commit -a -m "prefetch side" &&
+	git branch prefetch-side &&
+	git ls-files --stage >expect &&
+	git checkout -q prefetch-base &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c core.treePrefetchThreads=2 read-tree -m -u HEAD prefetch-side &&
+	git ls-files --stage >actual &&
+	test_cmp expect actual &&
+	git diff --exit-code prefetch-side &&
+	grep "\"prefetch_trees/nr\",\"value\":\"8\"" trace.event
+'
+
 test_done
@@ -57,4 +57,69 @@ test_expect_success 'list packed refs with unicode characters' '
 	)
 '
 
+test_expect_success 'packed-refs in the binary format' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=files repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		test_seq 100 | sed "s,.*,create refs/heads/branch-& HEAD," |
+		git update-ref --stdin &&
+		git tag -m tag annotated &&
+		git tag lightweight &&
+		git pack-refs --all &&
+		git for-each-ref >expect-all &&
+		git show-ref -d >expect-show &&
+		git for-each-ref refs/heads/branch-4 refs/tags/ >expect-prefix &&
+		git for-each-ref --exclude=refs/heads/branch-5 \
+			--exclude=refs/tags/ >expect-exclude &&
+
+		git config core.repositoryformatversion 1 &&
+		git config extensions.packedRefsV2 true &&
+		git pack-refs --all &&
+		printf PREF >expect &&
+		test_copy_bytes 4 <.git/packed-refs >actual &&
+		test_cmp expect actual &&
+
+		git for-each-ref >actual &&
+		test_cmp expect-all actual &&
+		git show-ref -d >actual &&
+		test_cmp expect-show actual &&
+		git for-each-ref refs/heads/branch-4 refs/tags/ >actual &&
+		test_cmp expect-prefix actual &&
+		git for-each-ref --exclude=refs/heads/branch-5 \
+			--exclude=refs/tags/ >actual &&
+		test_cmp expect-exclude actual &&
+		git rev-parse annotated^{} >expect &&
+		git rev-parse branch-99 >actual &&
+		test_cmp expect actual &&
+		git refs verify &&
+
+		git update-ref -d refs/heads/branch-50 &&
+		git update-ref refs/heads/branch-50/new HEAD &&
+		git pack-refs --all &&
+		test_must_fail git rev-parse --verify branch-50 &&
+		git rev-parse --verify branch-50/new &&
+		git for-each-ref refs/heads/ >actual &&
+		test_line_count = 101 actual &&
+		git refs verify
+	)
+'
+
+test_expect_success 'corrupt packed-refs in the binary format' '
+	test_when_finished "rm -rf repo" &&
+	git init --ref-format=files repo &&
+	(
+		cd repo &&
+		git config core.repositoryformatversion 1 &&
+		git config extensions.packedRefsV2 true &&
+		test_commit --no-tag A &&
+		git pack-refs --all &&
+		git refs verify &&
+		printf X | dd of=.git/packed-refs bs=1 seek=80 conv=notrunc &&
+		test_must_fail git refs verify 2>err &&
+		test_grep "badPackedRefHeader: has an invalid checksum" err
+	)
+'
+
 test_done
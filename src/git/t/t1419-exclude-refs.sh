@@ -167,6 +167,32 @@ test_expect_success 'meta-characters are discarded' '
 	assert_no_jumps perf
 '
 
+test_expect_success 'excludes with several prefixes' '
+	for_each_ref --exclude=refs/heads/bar/4 \
+		refs/heads/quux refs/heads/bar refs/heads/foo/2 >actual &&
+	cat >expect <<-\EOF &&
+	refs/heads/bar/1
+	refs/heads/bar/2
+	refs/heads/bar/3
+	refs/heads/foo/2
+	refs/heads/quux/1
+	refs/heads/quux/2
+	refs/heads/quux/3
+	EOF
+	test_cmp expect actual
+'
+
+test_expect_success REFFILES 'excluded loose directories are skipped' '
+	test_when_finished "git update-ref -d refs/heads/loose-dir/1 &&
+		git update-ref -d refs/heads/loose-dir/2" &&
+	git update-ref refs/heads/loose-dir/1 $base &&
+	git update-ref refs/heads/loose-dir/2 $base &&
+
+	for_each_ref__exclude refs/heads refs/heads/loose-dir >actual &&
+	for_each_ref --exclude=refs/heads/loose-dir refs/heads >expect &&
+	test_cmp expect actual
+'
+
 test_expect_success 'empty string exclude pattern is ignored' '
 	git update-ref refs/heads/loose $(git rev-parse refs/heads/foo/1) &&
 
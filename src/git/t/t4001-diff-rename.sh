@@ -309,4 +309,30 @@ test_expect_success 'last line matters too' '
 	test_cmp expected actual.munged
 '
 
+test_expect_success PTHREADS 'diff.renameThreads does not change the result' '
+	test_when_finished "rm -rf threads" &&
+	git init threads &&
+	(
+		cd threads &&
+		for i in 1 2 3 4 5 6 7 8 9
+		do
+			test_write_lines $i 1 2 3 4 5 6 7 8 9 >file$i || return 1
+		done &&
+		test_write_lines 0 1 2 3 4 5 6 7 8 9 >small &&
+		git add . &&
+		git commit -m original &&
+		for i in 1 2 3 4 5 6 7 8 9
+		do
+			git mv file$i moved$i &&
+			echo edit >>moved$i || return 1
+		done &&
+		git commit -a -m "move and edit" &&
+		git diff-tree -r -C -C HEAD^ HEAD >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git -c diff.renameThreads=4 diff-tree -r -C -C HEAD^ HEAD >actual &&
+		test_cmp expect actual &&
+		grep "\"inexact_renames/threads\"" trace.event
+	)
+'
+
 test_done
@@ -130,4 +130,51 @@ test_expect_success 'diff --stat with binary files and big change count' '
 	test_cmp expect actual
 '
 
+test_expect_success 'setup big text files' '
+	test_seq 20000 >big &&
+	git add big &&
+	git commit -m "big file" &&
+	{
+		test_seq 999 &&
+		echo one thousand &&
+		test_seq 1001 4999 &&
+		test_seq 5100 15000 &&
+		echo added &&
+		test_seq 15001 20000
+	} >big &&
+	git commit -a -m "big file changed"
+'
+
+test_expect_success 'big files are binary without diff.streamLargeFiles' '
+	git -c core.bigFileThreshold=1k diff HEAD^ HEAD >actual &&
+	grep "^Binary files a/big and b/big differ" actual
+'
+
+test_expect_success 'diff.streamLargeFiles shows the patch of big files' '
+	git diff HEAD^ HEAD >expect &&
+	git -c core.bigFileThreshold=1k -c diff.streamLargeFiles=true \
+		diff HEAD^ HEAD >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'diff.streamLargeFiles with small windows' '
+	GIT_TEST_DIFF_STREAM_WINDOW=1000 \
+		git -c core.bigFileThreshold=1k -c diff.streamLargeFiles=true \
+		diff HEAD^ HEAD >patch &&
+	git show HEAD:big >expect &&
+	git show HEAD^:big >big &&
+	git apply patch &&
+	test_cmp expect big
+'
+
+test_expect_success 'diff.streamLargeFiles leaves binary files alone' '
+	printf "\01\00%4096d" 1 >binfile &&
+	git add binfile &&
+	git commit -m binary &&
+	echo more >>binfile &&
+	git -c core.bigFileThreshold=1k -c diff.streamLargeFiles=true \
+		diff binfile >actual &&
+	grep "^Binary files a/binfile and b/binfile differ" actual
+'
+
 test_done
@@ -704,6 +704,18 @@ test_expect_success 'diff.{src,dst}Prefix ignored with --default-prefix' '
 	check_prefix actual a/file0 b/file0
 '
 
+test_expect_success PTHREADS 'diff.threads does not change the output' '
+	git log -p --stat --root --binary master >expect &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c diff.threads=4 log -p --stat --root --binary master >actual &&
+	test_cmp expect actual &&
+	grep "\"patch/threads\"" trace.event &&
+
+	git format-patch --stdout --root master >expect &&
+	git -c diff.threads=3 format-patch --stdout --root master >actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'diff --no-renames cannot be abbreviated' '
 	test_expect_code 129 git diff --no-rename >actual 2>error &&
 	test_must_be_empty actual &&
@@ -347,6 +347,17 @@ test_expect_success 'ls-remote --sort fails gracefully outside repository' '
 	test_grep "^fatal: not a git repository, but the field '\''authordate'\'' requires access to object data" err
 '
 
+test_expect_success 'ls-remote --sort on object data with a single ref' '
+	# The object of the only ref is missing locally; as it is never
+	# compared, sorting must not try to read it.
+	git init single &&
+	test_commit -C single --no-tag one &&
+	git -C single rev-parse HEAD >expect &&
+	git ls-remote --sort=objectsize --heads single >actual &&
+	cut -f1 actual >oids &&
+	test_cmp expect oids
+'
+
 test_expect_success 'ls-remote patterns work with all protocol versions' '
 	git for-each-ref --format="%(objectname)	%(refname)" \
 		refs/heads/main refs/remotes/origin/main >expect &&
@@ -2152,4 +2152,28 @@ test_expect_success GPG 'show lack of signature with custom format' '
 	test_cmp expect actual
 '
 
+test_expect_success 'object atoms of many refs' '
+	test_when_finished "rm -rf many" &&
+	git init many &&
+	test_commit_bulk -C many 1500 &&
+	git -C many rev-list HEAD >revs &&
+	sed "s,.*,create refs/many/& &," revs |
+	git -C many update-ref --stdin &&
+	sort revs >sorted &&
+	git -C many cat-file --batch-check="%(objectname) %(objectsize)" \
+		<sorted >sizes &&
+	git -C many log --no-walk=unsorted --stdin --format=%s \
+		<sorted >subjects &&
+	paste -d " " sizes subjects >expect &&
+	format="%(objectname) %(objectsize) %(contents:subject)" &&
+	git -C many for-each-ref --format="$format" refs/many >actual &&
+	test_cmp expect actual &&
+	git -C many for-each-ref --no-sort --format="$format" \
+		refs/many >actual &&
+	test_cmp expect actual &&
+	git -C many for-each-ref --sort=objectname --format="$format" \
+		refs/many >actual &&
+	test_cmp expect actual
+'
+
 test_done
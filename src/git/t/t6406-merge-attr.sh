@@ -303,4 +303,84 @@ test_expect_success !WINDOWS 'custom merge driver that is killed with a signal o
 	test_must_be_empty output
 '
 
+
+test_expect_success 'merge.threads does not change the result' '
+	test_create_repo threads &&
+	(
+		cd threads &&
+		for f in 1 2 3 4 5 6 binary union custom
+		do
+			test_seq 20 >$f || return 1
+		done &&
+		printf "\\0" >>binary &&
+		cat >.gitattributes <<-\EOF &&
+		binary -merge
+		union merge=union
+		custom merge=custom
+		EOF
+		git config merge.custom.driver "cat %B >%A" &&
+		git add . &&
+		git commit -m base &&
+		git checkout -b side &&
+		for f in 1 2 3 4 5 6 binary union custom
+		do
+			sed -e "s/^2$/side/" $f >$f.new &&
+			mv $f.new $f || return 1
+		done &&
+		sed -e "s/^10$/side/" 3 >3.new &&
+		mv 3.new 3 &&
+		git commit -a -m side &&
+		git checkout main &&
+		for f in 1 2 3 4 5 6 binary union custom
+		do
+			sed -e "s/^19$/main/" $f >$f.new &&
+			mv $f.new $f || return 1
+		done &&
+		sed -e "s/^10$/main/" 3 >3.new &&
+		mv 3.new 3 &&
+		git commit -a -m main &&
+
+		test_expect_code 1 git -c merge.threads=1 \
+			merge-tree --write-tree main side >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		GIT_TRACE2_EVENT_NESTING=10 \
+		test_expect_code 1 git -c merge.threads=4 \
+			merge-tree --write-tree main side >actual &&
+		test_cmp expect actual &&
+		test_trace2_data merge premerge/merges 8 <trace.event
+	)
+'
+
+test_expect_success 'merge.threads keeps the messages in path order' '
+	test_create_repo threads-output &&
+	(
+		cd threads-output &&
+		for f in a b c d e f g h
+		do
+			test_seq 20 >$f &&
+			printf "\\0" >>$f || return 1
+		done &&
+		git add . &&
+		git commit -m base &&
+		git checkout -b side &&
+		for f in a b c d e f g h
+		do
+			echo side >>$f || return 1
+		done &&
+		git commit -a -m side &&
+		git checkout main &&
+		for f in a b c d e f g h
+		do
+			echo main >>$f || return 1
+		done &&
+		git commit -a -m main &&
+
+		test_must_fail git -c merge.threads=1 merge side >expect 2>&1 &&
+		git reset --hard &&
+		test_must_fail git -c merge.threads=4 merge side >actual 2>&1 &&
+		test_cmp expect actual &&
+		grep "Cannot merge binary files: a" expect
+	)
+'
+
 test_done
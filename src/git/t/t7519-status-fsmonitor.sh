@@ -271,6 +271,14 @@ test_expect_success 'refresh_index() invalidates fsmonitor cache' '
 	test_cmp expect actual
 '
 
+test_expect_success 'core.preloadIndexThreads caps preload threads' '
+	test_when_finished "rm -f trace.event" &&
+	GIT_TEST_PRELOAD_INDEX=true GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c core.preloadIndex=true -c core.preloadIndexThreads=1 \
+		    -c core.fsmonitor= status &&
+	grep "\"preload/threads\",\"value\":\"1\"" trace.event
+'
+
 # test fsmonitor with and without preloadIndex
 preload_values="false true"
 for preload_val in $preload_values
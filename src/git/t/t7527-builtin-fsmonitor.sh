@@ -1311,4 +1311,38 @@ test_expect_success CASE_INSENSITIVE_FS 'fsmonitor file case wrong on disk' '
 	grep -q " M dir1/dir2/dir4/FILE-4-A" "$PWD/file_case_wrong-try3.out"
 '
 
+test_expect_success 'fsmonitor.statCache lets the daemon vouch for unchanged files' '
+	test_when_finished "stop_daemon_delete_repo test_stat_cache" &&
+
+	git init test_stat_cache &&
+	(
+		cd test_stat_cache &&
+		test_commit one &&
+		test_commit two &&
+		test_commit three &&
+		test-tool chmtime =-60 one.t two.t three.t &&
+		git update-index --refresh &&
+		git config core.fsmonitor true &&
+		git config fsmonitor.statCache true
+	) &&
+	start_daemon -C test_stat_cache &&
+
+	GIT_TRACE2_EVENT="$PWD/stat-cache-1.event" \
+		git -C test_stat_cache status --porcelain >actual &&
+	test_must_be_empty actual &&
+	grep "\"key\":\"preload/fsmonitor_stat\",\"value\":\"3\"" \
+		stat-cache-1.event &&
+
+	# Drop the fsmonitor token, so that all entries are asked about
+	# again; the daemon must not vouch for the one that changed.
+	echo more >>test_stat_cache/two.t &&
+	git -C test_stat_cache update-index --no-fsmonitor 2>/dev/null &&
+	GIT_TRACE2_EVENT="$PWD/stat-cache-2.event" \
+		git -C test_stat_cache status --porcelain >actual &&
+	echo " M two.t" >expect &&
+	test_cmp expect actual &&
+	grep "\"key\":\"preload/fsmonitor_stat\",\"value\":\"2\"" \
+		stat-cache-2.event
+'
+
 test_done
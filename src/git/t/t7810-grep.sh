@@ -1929,4 +1929,50 @@ test_expect_success 'grep does not report i-t-a and assume unchanged with -L' '
 	test_cmp expected actual
 '
 
+test_expect_success 'grep skips files without the required literals' '
+	test_when_finished "rm -rf literals" &&
+	mkdir literals &&
+	echo "static int kelvin;" >literals/one &&
+	echo "static void keep(void);" >literals/two &&
+	echo "nothing to see" >literals/three &&
+	cat >expected <<-\EOF &&
+	literals/one:static int kelvin;
+	literals/two:static void keep(void);
+	EOF
+	git grep --no-index -E "static (int|void) ke" literals >actual &&
+	test_cmp expected actual &&
+	git grep --no-index -e int --or -e keep literals >actual &&
+	test_cmp expected actual &&
+	git grep --no-index -e static --and --not -e nothing literals >actual &&
+	test_cmp expected actual &&
+	git grep --no-index -i "STATIC .* KE" literals >actual &&
+	test_cmp expected actual &&
+	echo literals/three >expected &&
+	git grep --no-index -L "static" literals >actual &&
+	test_cmp expected actual &&
+	git grep --no-index -l -v "static" literals >actual &&
+	test_cmp expected actual
+'
+
+test_expect_success 'grep jumps between the hits of several patterns' '
+	test_when_finished "rm -f interleaved" &&
+	test_write_lines one two three one two three four >interleaved &&
+	cat >expected <<-\EOF &&
+	interleaved:1:one
+	interleaved:3:three
+	interleaved:4:one
+	interleaved:6:three
+	EOF
+	git grep --no-index -n -e one -e three -e five interleaved >actual &&
+	test_cmp expected actual &&
+	git grep --no-index -n -e one --or -e three interleaved >actual &&
+	test_cmp expected actual &&
+	cat >expected <<-\EOF &&
+	interleaved:3:three
+	interleaved:6:three
+	EOF
+	git grep --no-index -n -e thr --and -e ee interleaved >actual &&
+	test_cmp expected actual
+'
+
 test_done
@@ -608,6 +608,95 @@ test_expect_success 'rerere-gc task with --auto honors maintenance.rerere-gc.aut
 	test_expect_rerere_gc ! git -c maintenance.rerere-gc.auto=0 maintenance run --auto --task=rerere-gc
 '
 
+test_expect_success 'rename-fingerprints task feeds rename detection' '
+	test_when_finished "rm -rf fingerprints" &&
+	git init fingerprints &&
+	(
+		cd fingerprints &&
+		test_seq 1 2000 >one &&
+		test_seq 2 2000 >two &&
+		git add one two &&
+		git commit -m base &&
+		git mv one uno &&
+		git mv two dos &&
+		echo more >>uno &&
+		echo more >>dos &&
+		git commit -a -m rename &&
+		git diff -M --name-status HEAD^ HEAD >expect &&
+
+		git maintenance run --task=rename-fingerprints &&
+		test_path_is_file .git/objects/info/rename-fingerprints &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git diff -M --name-status HEAD^ HEAD >actual &&
+		grep "\"rename_fingerprints/blobs\",\"value\":\"4\"" trace.event &&
+		test_cmp expect actual &&
+
+		# a second run keeps what the cache already knows, and only
+		# looks at the objects that are newer than the cache
+		test-tool chmtime =-600 .git/objects/??/* &&
+		rm trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git maintenance run --task=rename-fingerprints &&
+		grep "\"rename_fingerprints/candidates\",\"value\":\"4\"" trace.event &&
+		git diff -M --name-status HEAD^ HEAD >actual &&
+		test_cmp expect actual &&
+
+		test_seq 3 2000 >tres &&
+		git add tres &&
+		git commit -m tres &&
+		rm trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git maintenance run --task=rename-fingerprints &&
+		grep "\"rename_fingerprints/candidates\",\"value\":\"7\"" trace.event &&
+		rm trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git diff -M --name-status HEAD~2 HEAD >actual &&
+		grep "\"rename_fingerprints/blobs\",\"value\":\"5\"" trace.event
+	)
+'
+
+test_expect_success 'grep-trigrams task lets grep skip blobs' '
+	test_when_finished "rm -rf trigrams" &&
+	git init trigrams &&
+	(
+		cd trigrams &&
+		for i in $(test_seq 1 20)
+		do
+			echo "line $i" >file$i || return 1
+		done &&
+		echo "a Needle here" >needle &&
+		git add . &&
+		git commit -m base &&
+		git grep -i -e needle -e "line 1[5-9]" HEAD >expect &&
+
+		git maintenance run --task=grep-trigrams &&
+		test_path_is_file .git/objects/info/grep-trigrams &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git grep -i -e needle -e "line 1[5-9]" HEAD >actual &&
+		test_cmp expect actual &&
+		test_trace2_data grep trigrams/blobs 21 <trace.event &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git grep -e "Needle h" HEAD >actual &&
+		echo "HEAD:needle:a Needle here" >expect &&
+		test_cmp expect actual &&
+		test_trace2_data grep trigrams/skipped 20 <trace.event &&
+
+		# blobs the index does not know yet are still searched
+		echo "another Needle" >new &&
+		git add new &&
+		git commit -m new &&
+		git grep -c Needle HEAD >actual &&
+		cat >expect <<-\EOF &&
+		HEAD:needle:1
+		HEAD:new:1
+		EOF
+		test_cmp expect actual &&
+		git -c grep.trigramIndex=false grep -c Needle HEAD >actual &&
+		test_cmp expect actual
+	)
+'
+
 test_expect_success '--auto and --schedule incompatible' '
 	test_must_fail git maintenance run --auto --schedule=daily 2>err &&
 	test_grep "at most one" err
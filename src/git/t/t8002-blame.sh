@@ -173,4 +173,144 @@ test_expect_success 'blame with uncommitted edits in partial clone does not cras
 	git -C client blame file.txt
 '
 
+test_expect_success 'blame.cache gives the same result' '
+	git blame --porcelain -- one >expect &&
+	git -c blame.cache=true blame --porcelain HEAD^ -- one >/dev/null &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c blame.cache=true blame --porcelain -- one >actual &&
+	test_cmp expect actual &&
+	test_trace2_data blame cache/hits 1 <trace &&
+	rm trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c blame.cache=true blame --porcelain -- one >actual &&
+	test_cmp expect actual &&
+	test_trace2_data blame cache/hits 1 <trace &&
+	test_path_is_dir .git/blame-cache
+'
+
+test_expect_success 'blame.cache is not used with a textconv driver' '
+	rm -f trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c blame.cache=true -c diff.conv.textconv=cat \
+		blame --porcelain -- one >actual &&
+	test_cmp expect actual &&
+	! grep cache/hits trace &&
+	rm trace &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -c blame.cache=true -c diff.conv.textconv=cat \
+		blame --no-textconv --porcelain -- one >actual &&
+	test_cmp expect actual &&
+	test_trace2_data blame cache/hits 1 <trace
+'
+
+test_expect_success 'gc prunes the blame cache' '
+	git gc &&
+	test_path_is_dir .git/blame-cache &&
+	git -c gc.blameCacheExpire=now gc &&
+	test_path_is_missing .git/blame-cache/?? &&
+	git -c blame.cache=true blame --porcelain -- one >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'blame.cache keeps --no-follow apart' '
+	test_seq 1 5 >before-rename &&
+	git add before-rename &&
+	git commit -m "before rename" &&
+	git mv before-rename after-rename &&
+	git commit -m "rename" &&
+	git blame --porcelain HEAD -- after-rename >expect-follow &&
+	git blame --no-follow --porcelain HEAD -- after-rename >expect-no-follow &&
+	! test_cmp expect-follow expect-no-follow &&
+
+	rm -rf .git/blame-cache &&
+	git -c blame.cache=true blame --porcelain HEAD -- after-rename >actual &&
+	test_cmp expect-follow actual &&
+	git -c blame.cache=true blame --no-follow --porcelain \
+		HEAD -- after-rename >actual &&
+	test_cmp expect-no-follow actual &&
+
+	rm -rf .git/blame-cache &&
+	git -c blame.cache=true blame --no-follow --porcelain \
+		HEAD -- after-rename >actual &&
+	test_cmp expect-no-follow actual &&
+	git -c blame.cache=true blame --porcelain HEAD -- after-rename >actual &&
+	test_cmp expect-follow actual
+'
+
+test_expect_success PTHREADS 'blame.threads gives the same copy detection result' '
+	for i in 1 2 3 4 5 6
+	do
+		test_seq ${i}00 ${i}20 >copy-src-$i || return 1
+	done &&
+	git add copy-src-* &&
+	git commit -m "copy sources" &&
+	cat copy-src-2 copy-src-5 copy-src-1 >copy-dst &&
+	git add copy-dst &&
+	git commit -m "copy destination" &&
+	git blame -C -C -C --porcelain -- copy-dst >expect &&
+	git -c blame.threads=4 blame -C -C -C --porcelain -- copy-dst >actual &&
+	test_cmp expect actual &&
+	grep "^filename copy-src-5" actual
+'
+
+test_expect_success 'blame with the file history index gives the same result' '
+	git init file-history &&
+	(
+		cd file-history &&
+		test_seq 1 10 >file &&
+		git add file &&
+		git commit -m initial &&
+		for i in 1 2 3 4 5 6
+		do
+			echo $i >other &&
+			git add other &&
+			git commit -m "other $i" &&
+			echo $i >>other &&
+			git commit -a -m "more other $i" &&
+			sed -e "${i}s/\$/ changed/" file >file.new &&
+			mv file.new file &&
+			git commit -a -m "file $i" || return 1
+		done &&
+		git commit-graph write --reachable --file-history &&
+		test_path_is_file .git/objects/info/file-history &&
+		git -c blame.fileHistory=false blame --porcelain file >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" git blame --porcelain file >actual &&
+		test_cmp expect actual &&
+		test_trace2_data blame file_history/skips 6 <trace
+	)
+'
+
+test_expect_success 'blame skips to the last change from the start commit' '
+	(
+		cd file-history &&
+		echo 7 >other &&
+		git commit -a -m "other 7" &&
+		git commit-graph write --reachable --file-history &&
+		git -c blame.fileHistory=false blame --porcelain file >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace-start" \
+			git blame --porcelain file >actual &&
+		test_cmp expect actual &&
+		test_trace2_data blame file_history/skips 7 <trace-start &&
+
+		echo 8 >other &&
+		git commit -a -m "other 8" &&
+		git -c blame.fileHistory=false blame --porcelain file >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace-new" \
+			git blame --porcelain file >actual &&
+		test_cmp expect actual &&
+		test_trace2_data blame file_history/skips 7 <trace-new
+	)
+'
+
+test_expect_success 'gc writes the file history index with commitGraph.fileHistory' '
+	(
+		cd file-history &&
+		rm .git/objects/info/file-history &&
+		git gc &&
+		test_path_is_missing .git/objects/info/file-history &&
+		git -c commitGraph.fileHistory=true gc &&
+		test_path_is_file .git/objects/info/file-history
+	)
+'
+
 test_done
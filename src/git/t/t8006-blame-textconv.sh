@@ -155,4 +155,10 @@ EOF
 	test_cmp expected result
 '
 
+test_expect_success PTHREADS 'blame -C -C with blame.threads runs textconv' '
+	git -c blame.threads=4 blame -C -C three.bin >blame &&
+	find_blame <blame >result &&
+	test_cmp expected result
+'
+
 test_done
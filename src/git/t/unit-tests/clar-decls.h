@@ -0,0 +1,133 @@
+extern void test_ctype__isspace(void);
+extern void test_ctype__isdigit(void);
+extern void test_ctype__isalpha(void);
+extern void test_ctype__isalnum(void);
+extern void test_ctype__is_glob_special(void);
+extern void test_ctype__is_regex_special(void);
+extern void test_ctype__is_pathspec_magic(void);
+extern void test_ctype__isascii(void);
+extern void test_ctype__islower(void);
+extern void test_ctype__isupper(void);
+extern void test_ctype__iscntrl(void);
+extern void test_ctype__ispunct(void);
+extern void test_ctype__isxdigit(void);
+extern void test_ctype__isprint(void);
+extern void test_example_decorate__initialize(void);
+extern void test_example_decorate__cleanup(void);
+extern void test_example_decorate__add(void);
+extern void test_example_decorate__readd(void);
+extern void test_example_decorate__lookup(void);
+extern void test_example_decorate__loop(void);
+extern void test_hash__empty_string(void);
+extern void test_hash__single_character(void);
+extern void test_hash__multi_character(void);
+extern void test_hash__message_digest(void);
+extern void test_hash__alphabet(void);
+extern void test_hash__aaaaaaaaaa_100000(void);
+extern void test_hash__alphabet_100000(void);
+extern void test_hash__zero_blob_literal(void);
+extern void test_hash__three_blob_literal(void);
+extern void test_hash__zero_tree_literal(void);
+extern void test_hashmap__intern(void);
+extern void test_hashmap__replace_case_sensitive(void);
+extern void test_hashmap__replace_case_insensitive(void);
+extern void test_hashmap__get_case_sensitive(void);
+extern void test_hashmap__get_case_insensitive(void);
+extern void test_hashmap__add_case_sensitive(void);
+extern void test_hashmap__add_case_insensitive(void);
+extern void test_hashmap__remove_case_sensitive(void);
+extern void test_hashmap__remove_case_insensitive(void);
+extern void test_hashmap__iterate_case_sensitive(void);
+extern void test_hashmap__iterate_case_insensitive(void);
+extern void test_hashmap__alloc_case_sensitive(void);
+extern void test_hashmap__alloc_case_insensitive(void);
+extern void test_mem_pool__big_block(void);
+extern void test_mem_pool__tiny_block(void);
+extern void test_oid_array__initialize(void);
+extern void test_oid_array__enumerate_unique(void);
+extern void test_oid_array__enumerate_duplicate(void);
+extern void test_oid_array__lookup(void);
+extern void test_oid_array__lookup_non_existent(void);
+extern void test_oid_array__lookup_duplicates(void);
+extern void test_oid_array__lookup_non_existent_dup(void);
+extern void test_oid_array__lookup_almost_dup(void);
+extern void test_oid_array__lookup_single_dup(void);
+extern void test_oidmap__initialize(void);
+extern void test_oidmap__cleanup(void);
+extern void test_oidmap__replace(void);
+extern void test_oidmap__get(void);
+extern void test_oidmap__remove(void);
+extern void test_oidmap__iterate(void);
+extern void test_oidtree__initialize(void);
+extern void test_oidtree__cleanup(void);
+extern void test_oidtree__contains(void);
+extern void test_oidtree__each(void);
+extern void test_prio_queue__basic(void);
+extern void test_prio_queue__mixed(void);
+extern void test_prio_queue__empty(void);
+extern void test_prio_queue__stack(void);
+extern void test_prio_queue__reverse_stack(void);
+extern void test_reftable_tree__tree_search(void);
+extern void test_reftable_tree__infix_walk(void);
+extern void test_strbuf__static_init(void);
+extern void test_strbuf__dynamic_init(void);
+extern void test_strbuf__add_single_char(void);
+extern void test_strbuf__add_empty_char(void);
+extern void test_strbuf__add_append_char(void);
+extern void test_strbuf__add_single_str(void);
+extern void test_strbuf__add_append_str(void);
+extern void test_strcmp_offset__empty(void);
+extern void test_strcmp_offset__equal(void);
+extern void test_strcmp_offset__different(void);
+extern void test_strcmp_offset__mismatch(void);
+extern void test_strcmp_offset__different_length(void);
+extern void test_strvec__init(void);
+extern void test_strvec__dynamic_init(void);
+extern void test_strvec__clear(void);
+extern void test_strvec__push(void);
+extern void test_strvec__pushf(void);
+extern void test_strvec__pushl(void);
+extern void test_strvec__pushv(void);
+extern void test_strvec__splice_just_initialized_strvec(void);
+extern void test_strvec__splice_with_same_size_replacement(void);
+extern void test_strvec__splice_with_smaller_replacement(void);
+extern void test_strvec__splice_with_bigger_replacement(void);
+extern void test_strvec__splice_with_empty_replacement(void);
+extern void test_strvec__splice_with_empty_original(void);
+extern void test_strvec__splice_at_tail(void);
+extern void test_strvec__replace_at_head(void);
+extern void test_strvec__replace_at_tail(void);
+extern void test_strvec__replace_in_between(void);
+extern void test_strvec__replace_with_substring(void);
+extern void test_strvec__remove_at_head(void);
+extern void test_strvec__remove_at_tail(void);
+extern void test_strvec__remove_in_between(void);
+extern void test_strvec__pop_empty_array(void);
+extern void test_strvec__pop_non_empty_array(void);
+extern void test_strvec__split_empty_string(void);
+extern void test_strvec__split_single_item(void);
+extern void test_strvec__split_multiple_items(void);
+extern void test_strvec__split_whitespace_only(void);
+extern void test_strvec__split_multiple_consecutive_whitespaces(void);
+extern void test_strvec__detach(void);
+extern void test_trailer__empty_input(void);
+extern void test_trailer__no_newline_start(void);
+extern void test_trailer__newline_start(void);
+extern void test_trailer__no_body_text(void);
+extern void test_trailer__body_text_no_divider(void);
+extern void test_trailer__body_no_divider_2nd_block(void);
+extern void test_trailer__body_and_divider(void);
+extern void test_trailer__non_trailer_in_block(void);
+extern void test_trailer__too_many_non_trailers(void);
+extern void test_trailer__one_non_trailer_no_git_trailers(void);
+extern void test_urlmatch_normalization__scheme(void);
+extern void test_urlmatch_normalization__authority(void);
+extern void test_urlmatch_normalization__port(void);
+extern void test_urlmatch_normalization__port_normalization(void);
+extern void test_urlmatch_normalization__general_escape(void);
+extern void test_urlmatch_normalization__high_bit(void);
+extern void test_urlmatch_normalization__utf8_escape(void);
+extern void test_urlmatch_normalization__username_pass(void);
+extern void test_urlmatch_normalization__length(void);
+extern void test_urlmatch_normalization__dots(void);
+extern void test_urlmatch_normalization__equivalents(void);
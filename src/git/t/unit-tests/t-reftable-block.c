@@ -199,6 +199,71 @@ static void t_log_block_read_write(void)
 		reftable_record_release(&recs[i]);
 }
 
+static void t_log_block_cache(void)
+{
+	const int header_off = 21;
+	const size_t block_size = 2048;
+	struct reftable_block_source source = { 0 };
+	struct block_writer bw = {
+		.last_key = REFTABLE_BUF_INIT,
+	};
+	struct reftable_record rec = {
+		.type = REFTABLE_BLOCK_TYPE_LOG,
+		.u.log = {
+			.refname = (char *) "refs/heads/main",
+			.value_type = REFTABLE_LOG_UPDATE,
+		},
+	};
+	struct reftable_block first = { 0 }, second = { 0 };
+	struct reftable_buf block_data = REFTABLE_BUF_INIT;
+	struct reftable_buf key = REFTABLE_BUF_INIT;
+	struct block_cache *cache = NULL;
+	int ret;
+
+	REFTABLE_CALLOC_ARRAY(block_data.buf, block_size);
+	check(block_data.buf != NULL);
+	block_data.len = block_size;
+
+	ret = block_writer_init(&bw, REFTABLE_BLOCK_TYPE_LOG, (uint8_t *) block_data.buf, block_size,
+				header_off, hash_size(REFTABLE_HASH_SHA1));
+	check(!ret);
+	ret = block_writer_add(&bw, &rec);
+	check_int(ret, ==, 0);
+	ret = block_writer_finish(&bw);
+	check_int(ret, >, 0);
+	block_writer_release(&bw);
+
+	block_source_from_buf(&source, &block_data);
+	ret = block_init_cached(&first, &cache, &source, 0, header_off, block_size,
+				REFTABLE_HASH_SIZE_SHA1, REFTABLE_BLOCK_TYPE_LOG);
+	check_int(ret, ==, 0);
+	check(cache != NULL);
+
+	/* The second block is served from the cache and shares its data. */
+	ret = block_init_cached(&second, &cache, &source, 0, header_off, block_size,
+				REFTABLE_HASH_SIZE_SHA1, REFTABLE_BLOCK_TYPE_ANY);
+	check_int(ret, ==, 0);
+	check(first.block_data.data == second.block_data.data);
+	check_int(second.block_type, ==, REFTABLE_BLOCK_TYPE_LOG);
+	check_int(second.restart_count, ==, first.restart_count);
+	check_int(second.full_block_size, ==, first.full_block_size);
+
+	/* Log blocks never satisfy a lookup for another type. */
+	ret = block_init_cached(&second, &cache, &source, 0, header_off, block_size,
+				REFTABLE_HASH_SIZE_SHA1, REFTABLE_BLOCK_TYPE_REF);
+	check_int(ret, ==, 1);
+
+	/* Blocks keep the data alive after the cache is gone. */
+	block_cache_free(cache);
+	check(reftable_block_first_key(&first, &key) >= 0);
+	check_str(key.buf, "refs/heads/main");
+
+	reftable_block_release(&first);
+	reftable_block_release(&second);
+	reftable_buf_release(&block_data);
+	reftable_buf_release(&key);
+}
+
 static void t_obj_block_read_write(void)
 {
 	const int header_off = 21;
@@ -458,6 +523,7 @@ int cmd_main(int argc UNUSED, const char *argv[] UNUSED)
 {
 	TEST(t_index_block_read_write(), "read-write operations on index blocks work");
 	TEST(t_log_block_read_write(), "read-write operations on log blocks work");
+	TEST(t_log_block_cache(), "log blocks are shared via the block cache");
 	TEST(t_obj_block_read_write(), "read-write operations on obj blocks work");
 	TEST(t_ref_block_read_write(), "read-write operations on ref blocks work");
 	TEST(t_block_iterator(), "block iterator works");
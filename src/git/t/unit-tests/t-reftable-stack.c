@@ -1068,6 +1068,55 @@ static void t_reftable_stack_auto_compaction_factor(void)
 	clear_dir(dir);
 }
 
+static void count_deferred_compactions(void *payload)
+{
+	size_t *count = payload;
+	(*count)++;
+}
+
+static void t_reftable_stack_auto_compaction_max_bytes(void)
+{
+	size_t deferred = 0;
+	struct reftable_write_options opts = {
+		.auto_compaction_max_bytes = 1,
+		.on_compaction_deferred = count_deferred_compactions,
+		.on_compaction_deferred_payload = &deferred,
+	};
+	struct reftable_stack *st = NULL;
+	char *dir = get_tmp_dir(__LINE__);
+	int err;
+	size_t N = 5;
+
+	err = reftable_new_stack(&st, dir, &opts);
+	check(!err);
+
+	for (size_t i = 0; i < N; i++) {
+		char name[20];
+		struct reftable_ref_record ref = {
+			.refname = name,
+			.update_index = reftable_stack_next_update_index(st),
+			.value_type = REFTABLE_REF_VAL1,
+		};
+		xsnprintf(name, sizeof(name), "branch%04"PRIuMAX, (uintmax_t)i);
+
+		err = reftable_stack_add(st, &write_test_ref, &ref);
+		check(!err);
+	}
+
+	/* Every compaction is too large, so they all get deferred. */
+	check_int(st->merged->tables_len, ==, N);
+	check_int(deferred, ==, N - 1);
+
+	/* Compacting explicitly is not limited. */
+	err = reftable_stack_auto_compact(st);
+	check(!err);
+	check_int(st->merged->tables_len, ==, 1);
+	check_int(deferred, ==, N - 1);
+
+	reftable_stack_destroy(st);
+	clear_dir(dir);
+}
+
 static void t_reftable_stack_auto_compaction_with_locked_tables(void)
 {
 	struct reftable_write_options opts = {
@@ -1427,6 +1476,7 @@ int cmd_main(int argc UNUSED, const char *argv[] UNUSED)
 	TEST(t_reftable_stack_add_performs_auto_compaction(), "addition to stack triggers auto-compaction");
 	TEST(t_reftable_stack_auto_compaction(), "stack must form geometric sequence after compaction");
 	TEST(t_reftable_stack_auto_compaction_factor(), "auto-compaction with non-default geometric factor");
+	TEST(t_reftable_stack_auto_compaction_max_bytes(), "auto-compaction defers large compactions");
 	TEST(t_reftable_stack_auto_compaction_fails_gracefully(), "failure on auto-compaction");
 	TEST(t_reftable_stack_auto_compaction_with_locked_tables(), "auto compaction with locked tables");
 	TEST(t_reftable_stack_compaction_concurrent(), "compaction with concurrent stack");
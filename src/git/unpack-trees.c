@@ -3,6 +3,7 @@
 
 #include "git-compat-util.h"
 #include "advice.h"
+#include "config.h"
 #include "strvec.h"
 #include "repository.h"
 #include "parse.h"
@@ -10,6 +11,7 @@
 #include "environment.h"
 #include "gettext.h"
 #include "hex.h"
+#include "oidmap.h"
 #include "name-hash.h"
 #include "tree.h"
 #include "tree-walk.h"
@@ -24,6 +26,8 @@
 #include "submodule.h"
 #include "submodule-config.h"
 #include "symlinks.h"
+#include "string-list.h"
+#include "thread-utils.h"
 #include "trace2.h"
 #include "fsmonitor.h"
 #include "object-store.h"
@@ -863,6 +867,278 @@ static int traverse_by_cache_tree(int pos, int nr_entries, int nr_names,
 	return 0;
 }
 
+/*
+ * Tree prefetching: before a multi-tree merge is traversed, the
+ * subtrees that differ between the trees being merged are read from
+ * the object database by a pool of threads.  Only the object reads
+ * happen in parallel; the traversal itself, and therefore the order
+ * in which unpack_callback() and the merge functions see entries, is
+ * unchanged.  Inflating trees is done outside of the object read lock,
+ * so this pays off when a branch switch or "read-tree -m" has to
+ * descend into many changed directories.
+ */
+struct prefetched_tree {
+	struct oidmap_entry entry;
+	void *buf;
+	unsigned long size;
+};
+
+struct prefetch_entry {
+	struct object_id oid[MAX_UNPACK_TREES];
+	unsigned long mask;
+};
+
+struct tree_prefetch {
+	struct repository *repo;
+	int n;
+	struct oidmap *trees;
+	struct string_list todo;
+	int next;
+	pthread_mutex_t mutex;
+};
+
+static int get_tree_prefetch_threads(void)
+{
+	int nr_threads;
+
+	if (!HAVE_THREADS ||
+	    git_config_get_int("core.treeprefetchthreads", &nr_threads))
+		return 1;
+	if (nr_threads < 1)
+		nr_threads = online_cpus();
+	return nr_threads;
+}
+
+/*
+ * Collect the subdirectories of the 'n' trees in 't' whose tree object
+ * is not the same in all of them, as a sorted list of names whose util
+ * points to a "struct prefetch_entry".
+ */
+static void collect_differing_subtrees(int n, struct tree_desc *t,
+				       struct string_list *out)
+{
+	unsigned long all = (1ul << n) - 1;
+	size_t i, j;
+	int k;
+
+	for (k = 0; k < n; k++) {
+		struct name_entry entry;
+
+		while (tree_entry_gently(&t[k], &entry)) {
+			struct string_list_item *item;
+			struct prefetch_entry *pe;
+
+			if (!S_ISDIR(entry.mode))
+				continue;
+			item = string_list_insert(out, entry.path);
+			if (!item->util)
+				item->util = xcalloc(1, sizeof(*pe));
+			pe = item->util;
+			oidcpy(&pe->oid[k], &entry.oid);
+			pe->mask |= 1ul << k;
+		}
+	}
+
+	for (i = j = 0; i < out->nr; i++) {
+		struct prefetch_entry *pe = out->items[i].util;
+		int differs = pe->mask != all;
+
+		for (k = 1; !differs && k < n; k++)
+			differs = !oideq(&pe->oid[k], &pe->oid[0]);
+		if (!differs) {
+			free(pe);
+			free(out->items[i].string);
+			continue;
+		}
+		out->items[j++] = out->items[i];
+	}
+	out->nr = j;
+}
+
+static const struct prefetched_tree *prefetch_tree(struct tree_prefetch *tp,
+						   const struct object_id *oid)
+{
+	struct object_info oi = OBJECT_INFO_INIT;
+	struct prefetched_tree *pt, *old;
+	enum object_type type;
+	void *buf;
+	unsigned long size;
+
+	pthread_mutex_lock(&tp->mutex);
+	pt = oidmap_get(tp->trees, oid);
+	pthread_mutex_unlock(&tp->mutex);
+	if (pt)
+		return pt;
+
+	oi.typep = &type;
+	oi.sizep = &size;
+	oi.contentp = &buf;
+	if (oid_object_info_extended(tp->repo, oid, &oi,
+				     OBJECT_INFO_LOOKUP_REPLACE |
+				     OBJECT_INFO_SKIP_FETCH_OBJECT))
+		return NULL;
+	if (type != OBJ_TREE) {
+		/* let the traversal report this the usual way */
+		free(buf);
+		return NULL;
+	}
+
+	CALLOC_ARRAY(pt, 1);
+	oidcpy(&pt->entry.oid, oid);
+	pt->buf = buf;
+	pt->size = size;
+
+	pthread_mutex_lock(&tp->mutex);
+	old = oidmap_get(tp->trees, oid);
+	if (!old)
+		oidmap_put(tp->trees, pt);
+	pthread_mutex_unlock(&tp->mutex);
+	if (old) {
+		free(pt->buf);
+		free(pt);
+		pt = old;
+	}
+	return pt;
+}
+
+static void prefetch_subtrees(struct tree_prefetch *tp,
+			      const struct prefetch_entry *pe)
+{
+	struct tree_desc t[MAX_UNPACK_TREES];
+	struct string_list subdirs = STRING_LIST_INIT_DUP;
+	size_t i;
+	int k;
+
+	for (k = 0; k < tp->n; k++) {
+		const struct prefetched_tree *pt = NULL;
+
+		if (pe->mask & (1ul << k))
+			pt = prefetch_tree(tp, &pe->oid[k]);
+		if (!pt || init_tree_desc_gently(&t[k], &pe->oid[k],
+						 pt->buf, pt->size, 0))
+			init_tree_desc(&t[k], NULL, NULL, 0);
+	}
+
+	collect_differing_subtrees(tp->n, t, &subdirs);
+	for (i = 0; i < subdirs.nr; i++)
+		prefetch_subtrees(tp, subdirs.items[i].util);
+	string_list_clear(&subdirs, 1);
+}
+
+static void *tree_prefetch_thread(void *data)
+{
+	struct tree_prefetch *tp = data;
+
+	for (;;) {
+		struct prefetch_entry *pe = NULL;
+
+		pthread_mutex_lock(&tp->mutex);
+		if (tp->next < tp->todo.nr)
+			pe = tp->todo.items[tp->next++].util;
+		pthread_mutex_unlock(&tp->mutex);
+		if (!pe)
+			break;
+		prefetch_subtrees(tp, pe);
+	}
+	return NULL;
+}
+
+static void prefetch_trees(struct unpack_trees_options *o,
+			   int n, struct tree_desc *t)
+{
+	struct tree_prefetch tp = { .repo = the_repository, .n = n };
+	struct tree_desc root[MAX_UNPACK_TREES];
+	int nr_threads = get_tree_prefetch_threads();
+	int had_obj_read_lock = obj_read_use_lock;
+	pthread_t *threads;
+	int i;
+
+	if (nr_threads < 2 || n < 2 || !o->merge)
+		return;
+	/*
+	 * Pathspecs and sparse checkouts may keep the traversal from
+	 * descending into directories we would otherwise read in vain.
+	 */
+	if ((o->pathspec && o->pathspec->nr) || !o->skip_sparse_checkout)
+		return;
+
+	string_list_init_dup(&tp.todo);
+	COPY_ARRAY(root, t, n);
+	collect_differing_subtrees(n, root, &tp.todo);
+	if (tp.todo.nr < 2)
+		goto out;
+	if (nr_threads > tp.todo.nr)
+		nr_threads = tp.todo.nr;
+
+	trace2_region_enter("unpack_trees", "prefetch_trees", the_repository);
+	CALLOC_ARRAY(o->internal.prefetched_trees, 1);
+	oidmap_init(o->internal.prefetched_trees, 0);
+	tp.trees = o->internal.prefetched_trees;
+	pthread_mutex_init(&tp.mutex, NULL);
+	enable_obj_read_lock();
+
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL,
+					 tree_prefetch_thread, &tp);
+		if (err)
+			die(_("unable to create tree prefetch thread: %s"),
+			    strerror(err));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(threads[i], NULL))
+			die("unable to join tree prefetch thread");
+	free(threads);
+
+	if (!had_obj_read_lock)
+		disable_obj_read_lock();
+	pthread_mutex_destroy(&tp.mutex);
+	trace2_data_intmax("unpack_trees", the_repository,
+			   "prefetch_trees/threads", nr_threads);
+	trace2_data_intmax("unpack_trees", the_repository,
+			   "prefetch_trees/nr",
+			   oidmap_get_size(o->internal.prefetched_trees));
+	trace2_region_leave("unpack_trees", "prefetch_trees", the_repository);
+out:
+	string_list_clear(&tp.todo, 1);
+}
+
+static void clear_prefetched_trees(struct unpack_trees_options *o)
+{
+	struct oidmap_iter iter;
+	struct prefetched_tree *pt;
+
+	if (!o->internal.prefetched_trees)
+		return;
+	oidmap_iter_init(o->internal.prefetched_trees, &iter);
+	while ((pt = oidmap_iter_next(&iter)))
+		free(pt->buf);
+	oidmap_clear(o->internal.prefetched_trees, 1);
+	FREE_AND_NULL(o->internal.prefetched_trees);
+}
+
+/*
+ * Like fill_tree_descriptor(), but take the tree from those read by
+ * prefetch_trees() if it is there.  The caller owns the returned buffer.
+ */
+static void *fill_prefetched_tree_descriptor(struct unpack_trees_options *o,
+					     struct tree_desc *desc,
+					     const struct object_id *oid)
+{
+	struct prefetched_tree *pt = NULL;
+	void *buf;
+
+	if (oid && o->internal.prefetched_trees)
+		pt = oidmap_remove(o->internal.prefetched_trees, oid);
+	if (!pt)
+		return fill_tree_descriptor(the_repository, desc, oid);
+
+	buf = pt->buf;
+	init_tree_desc(desc, oid, buf, pt->size);
+	free(pt);
+	return buf;
+}
+
 static int traverse_trees_recursive(int n, unsigned long dirmask,
 				    unsigned long df_conflicts,
 				    struct name_entry *names,
@@ -937,7 +1213,7 @@ static int traverse_trees_recursive(int n, unsigned long dirmask,
 			const struct object_id *oid = NULL;
 			if (dirmask & 1)
 				oid = &names[i].oid;
-			buf[nr_buf++] = fill_tree_descriptor(the_repository, t + i, oid);
+			buf[nr_buf++] = fill_prefetched_tree_descriptor(o, t + i, oid);
 		}
 	}
 
@@ -2005,11 +2281,14 @@ int unpack_trees(unsigned len, struct tree_desc *t, struct unpack_trees_options
 			}
 		}
 
+		prefetch_trees(o, len, t);
+
 		trace_performance_enter();
 		trace2_region_enter("unpack_trees", "traverse_trees", the_repository);
 		ret = traverse_trees(o->src_index, len, t, &info);
 		trace2_region_leave("unpack_trees", "traverse_trees", the_repository);
 		trace_performance_leave("traverse_trees");
+		clear_prefetched_trees(o);
 		if (ret < 0)
 			goto return_failed;
 	}
@@ -2099,6 +2378,7 @@ int unpack_trees(unsigned len, struct tree_desc *t, struct unpack_trees_options
 	o->src_index = NULL;
 
 done:
+	clear_prefetched_trees(o);
 	if (free_pattern_list)
 		clear_pattern_list(&pl);
 	if (o->internal.dir) {
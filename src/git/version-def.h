@@ -0,0 +1,8 @@
+#ifndef VERSION_DEF_H
+#define VERSION_DEF_H
+
+#define GIT_VERSION "2.50.1"
+#define GIT_BUILT_FROM_COMMIT ""
+#define GIT_USER_AGENT "git/2.50.1"
+
+#endif /* VERSION_DEF_H */
@@ -155,6 +155,162 @@ int xdi_diff_outf(mmfile_t *mf1, mmfile_t *mf2,
 	return ret;
 }
 
+struct xdiff_stream_side {
+	xdiff_read_fn read;
+	void *data;
+	struct strbuf buf;
+	/* the length of the complete lines at the start of buf */
+	size_t complete;
+	/* the number of lines before buf */
+	long line;
+	int eof;
+};
+
+struct xdiff_stream_state {
+	struct xdiff_emit_state emit;
+	xdemitcb_t line_ecb;
+	long offset1, offset2;
+};
+
+#define XDIFF_STREAM_READ_SIZE (64 * 1024)
+
+/*
+ * Read until 'want' bytes or the end of the stream are in the buffer,
+ * and at least one line is complete.
+ */
+static int fill_stream_window(struct xdiff_stream_side *s, size_t want)
+{
+	while (!s->eof && (s->buf.len < want || !s->complete)) {
+		ssize_t n;
+		size_t i;
+
+		strbuf_grow(&s->buf, XDIFF_STREAM_READ_SIZE);
+		n = s->read(s->data, s->buf.buf + s->buf.len,
+			    XDIFF_STREAM_READ_SIZE);
+		if (n < 0)
+			return -1;
+		if (!n) {
+			s->eof = 1;
+			break;
+		}
+		for (i = s->buf.len + n; i > s->buf.len; i--)
+			if (s->buf.buf[i - 1] == '\n') {
+				s->complete = i;
+				break;
+			}
+		strbuf_setlen(&s->buf, s->buf.len + n);
+	}
+	if (s->eof)
+		s->complete = s->buf.len;
+	return 0;
+}
+
+static void consume_stream_lines(struct xdiff_stream_side *s, long nr)
+{
+	const char *p = s->buf.buf, *end = s->buf.buf + s->complete;
+	long i;
+
+	for (i = 0; i < nr && p < end; i++) {
+		const char *nl = memchr(p, '\n', end - p);
+		p = nl ? nl + 1 : end;
+	}
+	s->complete -= p - s->buf.buf;
+	strbuf_remove(&s->buf, 0, p - s->buf.buf);
+	s->line += nr;
+}
+
+static int xdiff_stream_hunk(void *priv_,
+			     long old_begin, long old_nr,
+			     long new_begin, long new_nr,
+			     const char *func, long funclen)
+{
+	struct xdiff_stream_state *priv = priv_;
+
+	old_begin += priv->offset1;
+	new_begin += priv->offset2;
+	return xdl_emit_hunk_hdr(old_nr ? old_begin : old_begin + 1, old_nr,
+				 new_nr ? new_begin : new_begin + 1, new_nr,
+				 func, funclen, &priv->line_ecb);
+}
+
+static int xdiff_stream_line(void *priv_, mmbuffer_t *mb, int nbuf)
+{
+	struct xdiff_stream_state *priv = priv_;
+
+	return xdiff_outf(&priv->emit, mb, nbuf);
+}
+
+int xdi_diff_stream(xdiff_read_fn read1, void *data1,
+		    xdiff_read_fn read2, void *data2, size_t window,
+		    xdiff_emit_line_fn line_fn, void *consume_callback_data,
+		    xpparam_t const *xpp, xdemitconf_t const *xecfg)
+{
+	struct xdiff_stream_side a = { .read = read1, .data = data1 };
+	struct xdiff_stream_side b = { .read = read2, .data = data2 };
+	struct xdiff_stream_state state;
+	xdemitcb_t ecb;
+	size_t want = window;
+	int ret = 0;
+
+	strbuf_init(&a.buf, 0);
+	strbuf_init(&b.buf, 0);
+	memset(&state, 0, sizeof(state));
+	state.emit.line_fn = line_fn;
+	state.emit.consume_callback_data = consume_callback_data;
+	strbuf_init(&state.emit.remainder, 0);
+	state.line_ecb.out_line = xdiff_outf;
+	state.line_ecb.priv = &state.emit;
+	memset(&ecb, 0, sizeof(ecb));
+	ecb.out_hunk = xdiff_stream_hunk;
+	ecb.out_line = xdiff_stream_line;
+	ecb.priv = &state;
+
+	for (;;) {
+		mmfile_t mf1, mf2;
+		unsigned flags = 0;
+		long done1, done2;
+
+		if (fill_stream_window(&a, want) < 0 ||
+		    fill_stream_window(&b, want) < 0 ||
+		    a.complete > MAX_XDIFF_SIZE || b.complete > MAX_XDIFF_SIZE) {
+			ret = -1;
+			break;
+		}
+		if (a.eof && b.eof)
+			flags |= XDL_WINDOW_LAST;
+		else if (want >= 4 * window)
+			flags |= XDL_WINDOW_FORCE;
+
+		mf1.ptr = a.buf.buf;
+		mf1.size = a.complete;
+		mf2.ptr = b.buf.buf;
+		mf2.size = b.complete;
+		state.offset1 = a.line;
+		state.offset2 = b.line;
+		if (xdl_diff_window(&mf1, &mf2, xpp, xecfg, &ecb, flags,
+				    &done1, &done2) < 0) {
+			ret = -1;
+			break;
+		}
+		if (flags & XDL_WINDOW_LAST)
+			break;
+
+		if (!done1 && !done2) {
+			/* no place to cut yet; look further */
+			want *= 2;
+			continue;
+		}
+		consume_stream_lines(&a, done1);
+		consume_stream_lines(&b, done2);
+		want = window;
+	}
+
+	strbuf_release(&a.buf);
+	strbuf_release(&b.buf);
+	strbuf_release(&state.emit.remainder);
+	return ret;
+}
+
 int read_mmfile(mmfile_t *ptr, const char *filename)
 {
 	struct stat st;
@@ -176,6 +332,15 @@ int read_mmfile(mmfile_t *ptr, const char *filename)
 	return 0;
 }
 
+xdlarena_t *xdiff_arena(void)
+{
+	static xdlarena_t *arena;
+
+	if (!arena)
+		arena = xdl_arena_new();
+	return arena;
+}
+
 void read_mmblob(mmfile_t *ptr, const struct object_id *oid)
 {
 	unsigned long size;
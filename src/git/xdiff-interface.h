@@ -45,6 +45,37 @@ int xdi_diff_outf(mmfile_t *mf1, mmfile_t *mf2,
 		  void *consume_callback_data,
 		  xpparam_t const *xpp, xdemitconf_t const *xecfg);
 int read_mmfile(mmfile_t *ptr, const char *filename);
+
+/*
+ * Read up to 'len' bytes of one side of a streamed diff into 'buf',
+ * returning the number of bytes read, 0 at the end or -1 on error.
+ */
+typedef ssize_t (*xdiff_read_fn)(void *data, char *buf, size_t len);
+
+/*
+ * Like xdi_diff_outf() without a hunk_fn, but read the two sides as
+ * the diff goes, so that only windows of about 'window' bytes of each
+ * (and at most four times that) are in memory at any time.  The diff
+ * is made of the diffs of windows cut where the sides are the same for
+ * long enough that no hunk spans the cut; it is correct, but may be
+ * less minimal than that of the whole files.  Where the sides have
+ * nothing in common for a whole window, a hunk gets cut in two at the
+ * end of the window, the halves having no context lines at the cut.
+ * Function context is not supported.
+ */
+int xdi_diff_stream(xdiff_read_fn read1, void *data1,
+		    xdiff_read_fn read2, void *data2, size_t window,
+		    xdiff_emit_line_fn line_fn, void *consume_callback_data,
+		    xpparam_t const *xpp, xdemitconf_t const *xecfg);
+
+/*
+ * An xdiff arena (see xdl_arena_new()) for callers that run many
+ * diffs one after another to put in their xpparam_t, so that the
+ * buffers of one diff are reused by the next.  The arena is shared
+ * by the whole process and must only be used from the main thread.
+ */
+xdlarena_t *xdiff_arena(void);
+
 void read_mmblob(mmfile_t *ptr, const struct object_id *oid);
 int buffer_is_binary(const char *ptr, unsigned long size);
 
@@ -78,6 +78,8 @@ typedef struct s_mmbuffer {
 	long size;
 } mmbuffer_t;
 
+typedef struct s_xdlarena xdlarena_t;
+
 typedef struct s_xpparam {
 	unsigned long flags;
 
@@ -88,6 +90,13 @@ typedef struct s_xpparam {
 	/* See Documentation/diff-options.adoc. */
 	char **anchors;
 	size_t anchors_nr;
+
+	/*
+	 * If set, the buffers needed to prepare the two files are taken
+	 * from (and given back to) this arena instead of being allocated
+	 * and freed for every diff.  See xdl_arena_new().
+	 */
+	xdlarena_t *arena;
 } xpparam_t;
 
 typedef struct s_xdemitcb {
@@ -130,6 +139,36 @@ long xdl_mmfile_size(mmfile_t *mmf);
 int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	     xdemitconf_t const *xecfg, xdemitcb_t *ecb);
 
+/* the windows reach the end of both inputs */
+#define XDL_WINDOW_LAST (1 << 0)
+/* rather cut a hunk in two than give up on this window */
+#define XDL_WINDOW_FORCE (1 << 1)
+
+/*
+ * Diff two windows of complete lines at the same place in two inputs
+ * too large to diff in one go.  Emit only the hunks before the last
+ * point where the windows stay the same for long enough that no hunk
+ * can reach across it, and store in 'done1' and 'done2' the number of
+ * lines before that point, with which the next windows must start.
+ * Both are 0 (and nothing is emitted) if there is no such point; with
+ * XDL_WINDOW_FORCE there always is one, even if that means a hunk cut
+ * short.  With XDL_WINDOW_LAST this is just xdl_diff().  The hunk
+ * headers count lines from the start of the windows.
+ */
+int xdl_diff_window(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
+		    xdemitconf_t const *xecfg, xdemitcb_t *ecb,
+		    unsigned flags, long *done1, long *done2);
+
+/*
+ * An arena keeps the record, hash and classifier buffers of the last
+ * diff it was used for, so that a caller running many diffs in a row
+ * does not have to allocate them again.  An arena serves one diff at
+ * a time (a diff started while it is busy simply allocates its own
+ * buffers) and must not be shared between threads.
+ */
+xdlarena_t *xdl_arena_new(void);
+void xdl_arena_free(xdlarena_t *arena);
+
 typedef struct s_xmparam {
 	xpparam_t xpp;
 	int marker_size;
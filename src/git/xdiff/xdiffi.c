@@ -1091,3 +1091,120 @@ int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 
 	return 0;
 }
+
+/*
+ * Find where to cut the windows in the common run of lines after the
+ * change 'last' (or before the first change if NULL), returning 0 if
+ * there is no good place to cut.  A cut 'ctxlen' lines before the next
+ * change leaves it the context it needs in the next windows, and one
+ * long enough after 'last' gives it its own.
+ */
+static int xdl_window_cut(xdfenv_t *xe, xdchange_t *xscr,
+			  xdemitconf_t const *xecfg, unsigned flags,
+			  long *cut1, long *cut2, xdchange_t **last)
+{
+	long ctxlen = xecfg->ctxlen;
+	long max_common = LONG_MAX;
+	long s1 = 0, s2 = 0, len;
+	xdchange_t *xch, *prev = NULL;
+	int found = 0, forced = 0;
+	long fcut1 = 0, fcut2 = 0;
+	xdchange_t *flast = NULL;
+
+	if (ctxlen < LONG_MAX / 4 && xecfg->interhunkctxlen < LONG_MAX / 4)
+		max_common = 2 * ctxlen + xecfg->interhunkctxlen;
+
+	for (xch = xscr;; prev = xch, xch = xch->next) {
+		long e1 = xch ? xch->i1 : xe->xdf1.nrec;
+		long e2 = xch ? xch->i2 : xe->xdf2.nrec;
+
+		len = e1 - s1;
+		if (len > (prev ? max_common : ctxlen)) {
+			*cut1 = e1 - ctxlen;
+			*cut2 = e2 - ctxlen;
+			*last = prev;
+			found = 1;
+		} else if (prev && len > 0) {
+			fcut1 = s1 + XDL_MIN(ctxlen, len);
+			fcut2 = s2 + XDL_MIN(ctxlen, len);
+			flast = prev;
+			forced = 1;
+		}
+		if (!xch)
+			break;
+		s1 = xch->i1 + xch->chg1;
+		s2 = xch->i2 + xch->chg2;
+	}
+
+	if (found)
+		return 1;
+	if (!(flags & XDL_WINDOW_FORCE))
+		return 0;
+	if (forced) {
+		*cut1 = fcut1;
+		*cut2 = fcut2;
+		*last = flast;
+	} else {
+		/* nothing in common at all; take the windows whole */
+		*cut1 = xe->xdf1.nrec;
+		*cut2 = xe->xdf2.nrec;
+		*last = prev;
+	}
+	return 1;
+}
+
+int xdl_diff_window(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
+		    xdemitconf_t const *xecfg, xdemitcb_t *ecb,
+		    unsigned flags, long *done1, long *done2) {
+	xdchange_t *xscr, *last = NULL, *rest;
+	xdfenv_t xe;
+	long nrec1, nrec2, cut1, cut2;
+	int ret = 0;
+
+	*done1 = *done2 = 0;
+	if (xecfg->hunk_func || (xecfg->flags & XDL_EMIT_FUNCCONTEXT))
+		return -1;
+	if (flags & XDL_WINDOW_LAST)
+		return xdl_diff(mf1, mf2, xpp, xecfg, ecb);
+
+	if (xdl_do_diff(mf1, mf2, xpp, &xe) < 0)
+		return -1;
+	if (xdl_change_compact(&xe.xdf1, &xe.xdf2, xpp->flags) < 0 ||
+	    xdl_change_compact(&xe.xdf2, &xe.xdf1, xpp->flags) < 0 ||
+	    xdl_build_script(&xe, &xscr) < 0) {
+		xdl_free_env(&xe);
+		return -1;
+	}
+	if (xscr) {
+		if (xpp->flags & XDF_IGNORE_BLANK_LINES)
+			xdl_mark_ignorable_lines(xscr, &xe, xpp->flags);
+		if (xpp->ignore_regex)
+			xdl_mark_ignorable_regex(xscr, &xe, xpp);
+	}
+
+	if (xdl_window_cut(&xe, xscr, xecfg, flags, &cut1, &cut2, &last) &&
+	    (cut1 || cut2)) {
+		if (last) {
+			/*
+			 * Emit the changes before the cut, and do not let
+			 * their context run past it.
+			 */
+			rest = last->next;
+			last->next = NULL;
+			nrec1 = xe.xdf1.nrec;
+			nrec2 = xe.xdf2.nrec;
+			xe.xdf1.nrec = cut1;
+			xe.xdf2.nrec = cut2;
+			ret = xdl_emit_diff(&xe, xscr, ecb, xecfg);
+			xe.xdf1.nrec = nrec1;
+			xe.xdf2.nrec = nrec2;
+			last->next = rest;
+		}
+		*done1 = cut1;
+		*done2 = cut2;
+	}
+
+	xdl_free_script(xscr);
+	xdl_free_env(&xe);
+	return ret < 0 ? -1 : 0;
+}
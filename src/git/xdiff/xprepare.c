@@ -39,6 +39,23 @@ typedef struct s_xdlclass {
 	long len1, len2;
 } xdlclass_t;
 
+typedef struct s_xdlbuf {
+	void *ptr;
+	size_t alloc;
+} xdlbuf_t;
+
+typedef struct s_xdlctxbuf {
+	chastore_t rcha;
+	xdlbuf_t recs, rhash, rchg, rindex, ha;
+} xdlctxbuf_t;
+
+struct s_xdlarena {
+	int busy;
+	chastore_t ncha;
+	xdlbuf_t rchash, rcrecs;
+	xdlctxbuf_t ctx[2];
+};
+
 typedef struct s_xdlclassifier {
 	unsigned int hbits;
 	long hsize;
@@ -48,18 +65,21 @@ typedef struct s_xdlclassifier {
 	long alloc;
 	long count;
 	long flags;
+	xdlarena_t *arena;
 } xdlclassifier_t;
 
 
 
 
-static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags);
+static void *xdl_buf_get(xdlbuf_t *buf, long nr, size_t size, int clear);
+static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags,
+			       xdlarena_t *arena);
 static void xdl_free_classifier(xdlclassifier_t *cf);
 static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t **rhash,
 			       unsigned int hbits, xrecord_t *rec);
 static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_t const *xpp,
-			   xdlclassifier_t *cf, xdfile_t *xdf);
-static void xdl_free_ctx(xdfile_t *xdf);
+			   xdlclassifier_t *cf, xdfile_t *xdf, xdlctxbuf_t *buf);
+static void xdl_free_ctx(xdfile_t *xdf, xdlctxbuf_t *buf);
 static int xdl_clean_mmatch(char const *dis, long i, long s, long e);
 static int xdl_cleanup_records(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xdf2);
 static int xdl_trim_ends(xdfile_t *xdf1, xdfile_t *xdf2);
@@ -68,12 +88,89 @@ static int xdl_optimize_ctxs(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xdf2
 
 
 
-static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags) {
+xdlarena_t *xdl_arena_new(void) {
+	xdlarena_t *arena;
+
+	return XDL_CALLOC_ARRAY(arena, 1);
+}
+
+
+static void xdl_free_ctxbuf(xdlctxbuf_t *buf) {
+
+	xdl_cha_free(&buf->rcha);
+	xdl_free(buf->recs.ptr);
+	xdl_free(buf->rhash.ptr);
+	xdl_free(buf->rchg.ptr);
+	xdl_free(buf->rindex.ptr);
+	xdl_free(buf->ha.ptr);
+}
+
+
+void xdl_arena_free(xdlarena_t *arena) {
+
+	if (!arena)
+		return;
+	xdl_cha_free(&arena->ncha);
+	xdl_free(arena->rchash.ptr);
+	xdl_free(arena->rcrecs.ptr);
+	xdl_free_ctxbuf(&arena->ctx[0]);
+	xdl_free_ctxbuf(&arena->ctx[1]);
+	xdl_free(arena);
+}
+
+
+/*
+ * Return the arena buffer 'buf' grown to hold at least 'nr' items of
+ * 'size' bytes, optionally zeroed out, or a freshly allocated array
+ * the caller owns if 'buf' is NULL.
+ */
+static void *xdl_buf_get(xdlbuf_t *buf, long nr, size_t size, int clear) {
+	size_t len;
+
+	if (SIZE_MAX / size < (size_t)nr)
+		return NULL;
+	len = nr * size;
+	if (!buf)
+		return clear ? xdl_calloc(nr, size) : xdl_malloc(len);
+
+	if (!buf->ptr || buf->alloc < len) {
+		xdl_free(buf->ptr);
+		if (!(buf->ptr = xdl_malloc(len))) {
+			buf->alloc = 0;
+			return NULL;
+		}
+		buf->alloc = len;
+	}
+	if (clear)
+		memset(buf->ptr, 0, len);
+	return buf->ptr;
+}
+
+
+static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags,
+			       xdlarena_t *arena) {
 	cf->flags = flags;
+	cf->arena = arena;
 
 	cf->hbits = xdl_hashbits((unsigned int) size);
 	cf->hsize = 1 << cf->hbits;
 
+	if (arena) {
+		xdl_cha_reset(&arena->ncha, sizeof(xdlclass_t), size / 4 + 1);
+		cf->ncha = arena->ncha;
+		cf->rchash = xdl_buf_get(&arena->rchash, cf->hsize,
+					 sizeof(*cf->rchash), 1);
+		cf->rcrecs = xdl_buf_get(&arena->rcrecs, size,
+					 sizeof(*cf->rcrecs), 0);
+		if (!cf->rchash || !cf->rcrecs) {
+			xdl_free_classifier(cf);
+			return -1;
+		}
+		cf->alloc = arena->rcrecs.alloc / sizeof(*cf->rcrecs);
+		cf->count = 0;
+		return 0;
+	}
+
 	if (xdl_cha_init(&cf->ncha, sizeof(xdlclass_t), size / 4 + 1) < 0) {
 
 		return -1;
@@ -100,6 +197,13 @@ static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags) {
 
 static void xdl_free_classifier(xdlclassifier_t *cf) {
 
+	if (cf->arena) {
+		/* classify_record() may have grown these */
+		cf->arena->ncha = cf->ncha;
+		cf->arena->rcrecs.ptr = cf->rcrecs;
+		cf->arena->rcrecs.alloc = cf->alloc * sizeof(*cf->rcrecs);
+		return;
+	}
 	xdl_free(cf->rcrecs);
 	xdl_free(cf->rchash);
 	xdl_cha_free(&cf->ncha);
@@ -150,7 +254,7 @@ static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t
 
 
 static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_t const *xpp,
-			   xdlclassifier_t *cf, xdfile_t *xdf) {
+			   xdlclassifier_t *cf, xdfile_t *xdf, xdlctxbuf_t *buf) {
 	unsigned int hbits;
 	long nrec, hsize, bsize;
 	unsigned long hav;
@@ -168,14 +272,20 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	rhash = NULL;
 	recs = NULL;
 
-	if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec / 4 + 1) < 0)
-		goto abort;
-	if (!XDL_ALLOC_ARRAY(recs, narec))
+	if (buf) {
+		xdl_cha_reset(&buf->rcha, sizeof(xrecord_t), narec / 4 + 1);
+		xdf->rcha = buf->rcha;
+	} else if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec / 4 + 1) < 0)
 		goto abort;
 
 	hbits = xdl_hashbits((unsigned int) narec);
 	hsize = 1 << hbits;
-	if (!XDL_CALLOC_ARRAY(rhash, hsize))
+
+	if (!(recs = xdl_buf_get(buf ? &buf->recs : NULL, narec, sizeof(*recs), 0)))
+		goto abort;
+	if (buf)
+		narec = buf->recs.alloc / sizeof(*recs);
+	if (!(rhash = xdl_buf_get(buf ? &buf->rhash : NULL, hsize, sizeof(*rhash), 1)))
 		goto abort;
 
 	nrec = 0;
@@ -196,14 +306,22 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 		}
 	}
 
-	if (!XDL_CALLOC_ARRAY(rchg, nrec + 2))
+	if (buf) {
+		/* XDL_ALLOC_GROW() may have moved it */
+		buf->recs.ptr = recs;
+		buf->recs.alloc = narec * sizeof(*recs);
+	}
+
+	if (!(rchg = xdl_buf_get(buf ? &buf->rchg : NULL, nrec + 2, sizeof(*rchg), 1)))
 		goto abort;
 
 	if ((XDF_DIFF_ALG(xpp->flags) != XDF_PATIENCE_DIFF) &&
 	    (XDF_DIFF_ALG(xpp->flags) != XDF_HISTOGRAM_DIFF)) {
-		if (!XDL_ALLOC_ARRAY(rindex, nrec + 1))
+		if (!(rindex = xdl_buf_get(buf ? &buf->rindex : NULL, nrec + 1,
+					   sizeof(*rindex), 0)))
 			goto abort;
-		if (!XDL_ALLOC_ARRAY(ha, nrec + 1))
+		if (!(ha = xdl_buf_get(buf ? &buf->ha : NULL, nrec + 1,
+				       sizeof(*ha), 0)))
 			goto abort;
 	}
 
@@ -221,6 +339,12 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	return 0;
 
 abort:
+	if (buf) {
+		buf->recs.ptr = recs;
+		buf->recs.alloc = recs ? narec * sizeof(*recs) : 0;
+		buf->rcha = xdf->rcha;
+		return -1;
+	}
 	xdl_free(ha);
 	xdl_free(rindex);
 	xdl_free(rchg);
@@ -231,7 +355,13 @@ abort:
 }
 
 
-static void xdl_free_ctx(xdfile_t *xdf) {
+static void xdl_free_ctx(xdfile_t *xdf, xdlctxbuf_t *buf) {
+
+	if (buf) {
+		/* the arrays stay in the arena; only the store may have grown */
+		buf->rcha = xdf->rcha;
+		return;
+	}
 
 	xdl_free(xdf->rhash);
 	xdl_free(xdf->rindex);
@@ -246,9 +376,21 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		    xdfenv_t *xe) {
 	long enl1, enl2, sample;
 	xdlclassifier_t cf;
+	xdlarena_t *arena = xpp->arena;
+	xdlctxbuf_t *buf1 = NULL, *buf2 = NULL;
 
 	memset(&cf, 0, sizeof(cf));
 
+	/* a nested or concurrent diff allocates its own buffers */
+	if (arena && arena->busy)
+		arena = NULL;
+	if (arena) {
+		arena->busy = 1;
+		buf1 = &arena->ctx[0];
+		buf2 = &arena->ctx[1];
+	}
+	xe->arena = arena;
+
 	/*
 	 * For histogram diff, we can afford a smaller sample size and
 	 * thus a poorer estimate of the number of lines, as the hash
@@ -262,41 +404,49 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	enl1 = xdl_guess_lines(mf1, sample) + 1;
 	enl2 = xdl_guess_lines(mf2, sample) + 1;
 
-	if (xdl_init_classifier(&cf, enl1 + enl2 + 1, xpp->flags) < 0)
-		return -1;
+	if (xdl_init_classifier(&cf, enl1 + enl2 + 1, xpp->flags, arena) < 0)
+		goto failed;
 
-	if (xdl_prepare_ctx(1, mf1, enl1, xpp, &cf, &xe->xdf1) < 0) {
+	if (xdl_prepare_ctx(1, mf1, enl1, xpp, &cf, &xe->xdf1, buf1) < 0) {
 
 		xdl_free_classifier(&cf);
-		return -1;
+		goto failed;
 	}
-	if (xdl_prepare_ctx(2, mf2, enl2, xpp, &cf, &xe->xdf2) < 0) {
+	if (xdl_prepare_ctx(2, mf2, enl2, xpp, &cf, &xe->xdf2, buf2) < 0) {
 
-		xdl_free_ctx(&xe->xdf1);
+		xdl_free_ctx(&xe->xdf1, buf1);
 		xdl_free_classifier(&cf);
-		return -1;
+		goto failed;
 	}
 
 	if ((XDF_DIFF_ALG(xpp->flags) != XDF_PATIENCE_DIFF) &&
 	    (XDF_DIFF_ALG(xpp->flags) != XDF_HISTOGRAM_DIFF) &&
 	    xdl_optimize_ctxs(&cf, &xe->xdf1, &xe->xdf2) < 0) {
 
-		xdl_free_ctx(&xe->xdf2);
-		xdl_free_ctx(&xe->xdf1);
+		xdl_free_ctx(&xe->xdf2, buf2);
+		xdl_free_ctx(&xe->xdf1, buf1);
 		xdl_free_classifier(&cf);
-		return -1;
+		goto failed;
 	}
 
 	xdl_free_classifier(&cf);
 
 	return 0;
+
+failed:
+	if (arena)
+		arena->busy = 0;
+	return -1;
 }
 
 
 void xdl_free_env(xdfenv_t *xe) {
+	xdlarena_t *arena = xe->arena;
 
-	xdl_free_ctx(&xe->xdf2);
-	xdl_free_ctx(&xe->xdf1);
+	xdl_free_ctx(&xe->xdf2, arena ? &arena->ctx[1] : NULL);
+	xdl_free_ctx(&xe->xdf1, arena ? &arena->ctx[0] : NULL);
+	if (arena)
+		arena->busy = 0;
 }
 
 
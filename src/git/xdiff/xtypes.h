@@ -60,6 +60,7 @@ typedef struct s_xdfile {
 
 typedef struct s_xdfenv {
 	xdfile_t xdf1, xdf2;
+	xdlarena_t *arena;
 } xdfenv_t;
 
 